@@ -1,14 +1,23 @@
 #include "linker.hpp"
 #include "image_util.hpp"
 #include <istream>
-#include <map>
 #include <string>
 #include <streambuf>
+#include <vector>
 
 #include <config.hpp>
 #include <stdutil.hpp>
 
+#ifdef _WIN32
 #include <Windows.h>
+#else
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <sys/mman.h>
+#include <unistd.h>
+#define _cdecl
+#endif
 
 class BBModule : public Module {
 	public:
@@ -25,27 +34,94 @@ class BBModule : public Module {
 	void emitw(int word);
 	void emitd(int dword);
 	void emitx(void* mem, int sz);
+	void beginData();
 	bool addSymbol(const char* sym, int pc);
 	bool addReloc(const char* dest_sym, int pc, bool pcrel);
 
 	bool findSymbol(const char* sym, int* pc);
 
+	void getStats(ModuleStats* st);
+
 	private:
 	char* data;
 	int   data_sz, pc;
+	int   data_pc; //where the code ends, -1 if there's no data
+	int   map_sz;  //bytes mapped once linked
 	bool  linked;
+	int   lookups;
+
+	struct Reloc {
+		int pc, sym;
+	};
+
+	//symbols are interned - a symbol id indexes sym_names and sym_pcs.
+	//sym_pcs is -1 for symbols that have only been referenced.
+	std::vector<std::string> sym_names;
+	std::vector<int>         sym_pcs;
+	std::vector<int>         sym_table; //open addressing, power of 2 size, -1=empty
+	std::vector<Reloc>       rel_relocs, abs_relocs;
+
+	static unsigned hash(const char* t)
+	{
+		unsigned h = 2166136261u;
+		while (*t)
+			h = (h ^ (unsigned char)*t++) * 16777619u;
+		return h;
+	}
+
+	int findId(const char* t)
+	{
+		++lookups;
+		if (!sym_table.size())
+			return -1;
+		unsigned mask = sym_table.size() - 1;
+		for (unsigned i = hash(t) & mask;; i = (i + 1) & mask) {
+			int id = sym_table[i];
+			if (id < 0 || sym_names[id] == t)
+				return id;
+		}
+	}
 
-	std::map<std::string, int> symbols;
-	std::map<int, std::string> rel_relocs, abs_relocs;
+	void insertId(int id)
+	{
+		unsigned mask = sym_table.size() - 1, i;
+		for (i = hash(sym_names[id].c_str()) & mask; sym_table[i] >= 0; i = (i + 1) & mask) {
+		}
+		sym_table[i] = id;
+	}
+
+	int symId(const char* t)
+	{
+		int id = findId(t);
+		if (id >= 0)
+			return id;
+		id = sym_names.size();
+		sym_names.push_back(t);
+		sym_pcs.push_back(-1);
+		if (sym_names.size() * 2 > sym_table.size()) {
+			sym_table.assign(sym_table.size() ? sym_table.size() * 2 : 256, -1);
+			for (int k = 0; k < sym_names.size(); ++k)
+				insertId(k);
+		} else {
+			insertId(id);
+		}
+		return id;
+	}
 
-	bool findSym(const std::string& t, Module* libs, int* n)
+	bool findSym(int id, Module* libs, int* n)
 	{
-		if (findSymbol(t.c_str(), n))
+		if (sym_pcs[id] >= 0) {
+			*n = sym_pcs[id] + (int)(intptr_t)data;
 			return true;
-		if (libs->findSymbol(t.c_str(), n))
+		}
+		if (libs->findSymbol(sym_names[id].c_str(), n))
 			return true;
-		std::string err = "Symbol '" + t + "' not found";
+		std::string err = "Symbol '" + sym_names[id] + "' not found";
+#ifdef _WIN32
 		MessageBox(GetDesktopWindow(), err.c_str(), "Blitz Linker Error", MB_TOPMOST | MB_SETFOREGROUND);
+#else
+		fprintf(stderr, "Blitz Linker Error: %s\n", err.c_str());
+#endif
 		return false;
 	}
 
@@ -63,14 +139,19 @@ class BBModule : public Module {
 	}
 };
 
-BBModule::BBModule() : data(0), data_sz(0), pc(0), linked(false) {}
+BBModule::BBModule() : data(0), data_sz(0), pc(0), data_pc(-1), map_sz(0), linked(false), lookups(0) {}
 
 BBModule::~BBModule()
 {
-	if (linked)
+	if (!linked)
+		delete[] data;
+#ifdef _WIN32
+	else
 		VirtualFree(data, 0, MEM_RELEASE);
+#else
 	else
-		delete[] data;
+		munmap(data, map_sz);
+#endif
 }
 
 void* BBModule::link(Module* libs)
@@ -78,29 +159,64 @@ void* BBModule::link(Module* libs)
 	if (linked)
 		return data;
 
-	int                        dest;
-	std::map<int, std::string>::iterator it;
-
+#ifdef _WIN32
 	char* p = (char*)VirtualAlloc(0, pc, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE);
+#else
+	//writable while it's relocated - then the code is made executable, and never both
+	int page       = sysconf(_SC_PAGESIZE);
+	int mmap_flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_32BIT
+	mmap_flags |= MAP_32BIT; //relocs are 32 bit
+#endif
+	map_sz  = (pc + page - 1) / page * page;
+	char* p = (char*)mmap(0, map_sz ? map_sz : page, PROT_READ | PROT_WRITE, mmap_flags, -1, 0);
+	if (p == MAP_FAILED) {
+		fprintf(stderr, "Blitz Linker Error: Unable to map %d bytes of code\n", pc);
+		return 0;
+	}
+	if (!map_sz)
+		map_sz = page;
+#endif
 	memcpy(p, data, pc);
 	delete[] data;
 	data = p;
 
 	linked = true;
 
+	//resolve each symbol once, then patch relocs in one pass
+	std::vector<int>  dests(sym_names.size());
+	std::vector<bool> found(sym_names.size(), false);
+
+	std::vector<Reloc>::iterator it;
 	for (it = rel_relocs.begin(); it != rel_relocs.end(); ++it) {
-		if (!findSym(it->second, libs, &dest))
-			return 0;
-		int* p = (int*)(data + it->first);
-		*p += (dest - (int)p);
+		if (!found[it->sym]) {
+			if (!findSym(it->sym, libs, &dests[it->sym]))
+				return 0;
+			found[it->sym] = true;
+		}
+		int* p = (int*)(data + it->pc);
+		*p += (dests[it->sym] - (int)(intptr_t)p);
 	}
 
 	for (it = abs_relocs.begin(); it != abs_relocs.end(); ++it) {
-		if (!findSym(it->second, libs, &dest))
-			return 0;
-		int* p = (int*)(data + it->first);
-		*p += dest;
+		if (!found[it->sym]) {
+			if (!findSym(it->sym, libs, &dests[it->sym]))
+				return 0;
+			found[it->sym] = true;
+		}
+		int* p = (int*)(data + it->pc);
+		*p += dests[it->sym];
+	}
+
+#ifndef _WIN32
+	//beginData() started the data on a page of its own
+	int code_sz = data_pc >= 0 ? data_pc : pc;
+	if (code_sz && mprotect(data, (code_sz + page - 1) / page * page, PROT_READ | PROT_EXEC)) {
+		fprintf(stderr, "Blitz Linker Error: Unable to make code executable\n");
+		return 0;
 	}
+	__builtin___clear_cache(data, data + code_sz);
+#endif
 
 	return data;
 }
@@ -137,34 +253,56 @@ void BBModule::emitx(void* mem, int sz)
 	pc += sz;
 }
 
+void BBModule::beginData()
+{
+	if (data_pc >= 0)
+		return;
+#ifndef _WIN32
+	//so the code can be mapped read only - pages are at least this big
+	while (pc & 4095)
+		emit(0xcc);
+#endif
+	data_pc = pc;
+}
+
 bool BBModule::addSymbol(const char* sym, int pc)
 {
-	std::string t(sym);
-	if (symbols.find(t) != symbols.end())
+	int id = symId(sym);
+	if (sym_pcs[id] >= 0)
 		return false;
-	symbols[t] = pc;
+	sym_pcs[id] = pc;
 	return true;
 }
 
 bool BBModule::addReloc(const char* dest_sym, int pc, bool pcrel)
 {
-	std::map<int, std::string>& rel = pcrel ? rel_relocs : abs_relocs;
-	if (rel.find(pc) != rel.end())
+	//relocs arrive in pc order, so a duplicate can only be the last one
+	std::vector<Reloc>& rel = pcrel ? rel_relocs : abs_relocs;
+	if (rel.size() && rel.back().pc == pc)
 		return false;
-	rel[pc] = std::string(dest_sym);
+	Reloc r = {pc, symId(dest_sym)};
+	rel.push_back(r);
 	return true;
 }
 
 bool BBModule::findSymbol(const char* sym, int* pc)
 {
-	std::string                          t  = std::string(sym);
-	std::map<std::string, int>::iterator it = symbols.find(t);
-	if (it == symbols.end())
+	int id = findId(sym);
+	if (id < 0 || sym_pcs[id] < 0)
 		return false;
-	*pc = it->second + (int)data;
+	*pc = sym_pcs[id] + (int)(intptr_t)data;
 	return true;
 }
 
+void BBModule::getStats(ModuleStats* st)
+{
+	st->code    = data_pc >= 0 ? data_pc : pc;
+	st->data    = pc - st->code;
+	st->relocs  = rel_relocs.size() + abs_relocs.size();
+	st->symbols = sym_names.size();
+	st->lookups = lookups;
+}
+
 int Linker::version()
 {
 	return VERSION;
@@ -172,7 +310,11 @@ int Linker::version()
 
 bool Linker::canCreateExe()
 {
+#ifdef _WIN32
 	return true;
+#else
+	return false;
+#endif
 }
 
 Module* Linker::createModule()
@@ -193,6 +335,10 @@ Linker* _cdecl linkerGetLinker()
 
 bool BBModule::createExe(const char* exe_file, const char* dll_file)
 {
+#ifndef _WIN32
+	//executables are runtime.dll with the module in its resources
+	return false;
+#else
 	//find proc address of bbWinMain
 	HMODULE hmod = LoadLibrary(dll_file);
 	if (!hmod)
@@ -213,54 +359,55 @@ bool BBModule::createExe(const char* exe_file, const char* dll_file)
 
 	//create module
 	//code size: code...
-	//num_syms:  name,val...
-	//num_rels:  name,val...
-	//num_abss:  name,val...
+	//num_names: name...
+	//num_syms:  name_id,val...
+	//num_rels:  val,name_id...
+	//num_abss:  val,name_id...
 	//
 	qstreambuf buf;
 	std::iostream out(&buf);
 
-	std::map<std::string, int>::iterator it;
-	std::map<int, std::string>::iterator rit;
-
 	//write the code
 	int sz = pc;
 	out.write((char*)&sz, 4);
 	out.write(data, pc);
 
+	//write symbol names
+	sz = sym_names.size();
+	out.write((char*)&sz, 4);
+	for (int k = 0; k < sym_names.size(); ++k)
+		out.write(sym_names[k].c_str(), sym_names[k].size() + 1);
+
 	//write symbols
-	sz = symbols.size();
+	sz = 0;
+	for (int k = 0; k < sym_pcs.size(); ++k) {
+		if (sym_pcs[k] >= 0)
+			++sz;
+	}
 	out.write((char*)&sz, 4);
-	for (it = symbols.begin(); it != symbols.end(); ++it) {
-		std::string t = it->first + '\0';
-		out.write(t.data(), t.size());
-		sz = it->second;
-		out.write((char*)&sz, 4);
+	for (int k = 0; k < sym_pcs.size(); ++k) {
+		if (sym_pcs[k] < 0)
+			continue;
+		out.write((char*)&k, 4);
+		out.write((char*)&sym_pcs[k], 4);
 	}
 
 	//write relative relocs
 	sz = rel_relocs.size();
 	out.write((char*)&sz, 4);
-	for (rit = rel_relocs.begin(); rit != rel_relocs.end(); ++rit) {
-		std::string t = rit->second + '\0';
-		out.write(t.data(), t.size());
-		sz = rit->first;
-		out.write((char*)&sz, 4);
-	}
+	if (sz)
+		out.write((char*)&rel_relocs[0], sz * sizeof(Reloc));
 
 	//write absolute relocs
 	sz = abs_relocs.size();
 	out.write((char*)&sz, 4);
-	for (rit = abs_relocs.begin(); rit != abs_relocs.end(); ++rit) {
-		std::string t = rit->second + '\0';
-		out.write(t.data(), t.size());
-		sz = rit->first;
-		out.write((char*)&sz, 4);
-	}
+	if (sz)
+		out.write((char*)&abs_relocs[0], sz * sizeof(Reloc));
 
 	replaceRsrc(10, 1111, 1033, buf.data(), buf.size());
 
 	closeImage();
 
 	return true;
+#endif
 }
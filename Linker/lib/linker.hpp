@@ -2,6 +2,13 @@
 #ifndef LINKER_H
 #define LINKER_H
 
+//what's in a module, for blitzcc -stats
+struct ModuleStats {
+	int code, data; //bytes
+	int relocs, symbols;
+	int lookups; //of symbols, by name
+};
+
 class Module {
 	public:
 	virtual ~Module() {}
@@ -16,10 +23,15 @@ class Module {
 	virtual void emitd(int dword)          = 0;
 	virtual void emitx(void* data, int sz) = 0;
 
+	//everything emitted after this is data - the code before it can be made read only
+	virtual void beginData() = 0;
+
 	virtual bool addSymbol(const char* sym, int pc)                 = 0;
 	virtual bool addReloc(const char* dest_sym, int pc, bool pcrel) = 0;
 
 	virtual bool findSymbol(const char* sym, int* pc) = 0;
+
+	virtual void getStats(ModuleStats* st) = 0;
 };
 
 class Linker {
@@ -30,6 +42,10 @@ class Linker {
 	virtual void    deleteModule(Module* mod);
 };
 
+#ifdef _WIN32
 extern "C" _declspec(dllexport) Linker* _cdecl linkerGetLinker();
+#else
+extern "C" Linker* linkerGetLinker();
+#endif
 
 #endif
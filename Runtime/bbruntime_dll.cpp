@@ -9,6 +9,7 @@ using namespace std;
 #include <eh.h>
 #include <float.h>
 #include <map>
+#include <vector>
 
 #include "bbruntime.hpp"
 
@@ -28,14 +29,14 @@ class DummyDebugger : public Debugger {
 	virtual void debugSys(void* msg) {}
 };
 
-static HINSTANCE                  hinst;
-static map<const char*, void*>    syms;
-map<const char*, void*>::iterator sym_it;
-static gxRuntime*                 gx_runtime;
+static HINSTANCE                        hinst;
+static vector<pair<const char*, void*>> syms; //in the order bbruntime_link gives them
+static int                              sym_k;
+static gxRuntime*                       gx_runtime;
 
 static void rtSym(const char* sym, void* pc)
 {
-	syms[sym] = pc;
+	syms.push_back(make_pair(sym, pc));
 }
 
 static void _cdecl seTranslator(unsigned int u, EXCEPTION_POINTERS* pExp)
@@ -62,20 +63,24 @@ const char* Runtime::nextSym()
 {
 	if (!syms.size()) {
 		bbruntime_link(rtSym);
-		sym_it = syms.begin();
+		sym_k = 0;
 	}
-	if (sym_it == syms.end()) {
+	if (sym_k == syms.size()) {
 		syms.clear();
 		return 0;
 	}
-	return (sym_it++)->first;
+	return syms[sym_k++].first;
 }
 
 int Runtime::symValue(const char* sym)
 {
-	map<const char*, void*>::iterator it = syms.find(sym);
-	if (it != syms.end())
-		return (int)it->second;
+	//it's nearly always the one nextSym just returned
+	if (sym_k && syms[sym_k - 1].first == sym)
+		return (int)syms[sym_k - 1].second;
+	for (int k = 0; k < syms.size(); ++k) {
+		if (syms[k].first == sym)
+			return (int)syms[k].second;
+	}
 	return -1;
 }
 
@@ -158,7 +163,6 @@ Runtime* _cdecl runtimeGetRuntime()
 /********************** BUTT UGLY DLL->EXE HOOK! *************************/
 
 static void*            module_pc;
-static map<string, int> module_syms;
 static map<string, int> runtime_syms;
 static Runtime*         runtime;
 
@@ -168,29 +172,10 @@ static void fail()
 	ExitProcess(-1);
 }
 
-struct Sym {
-	string name;
-	int    value;
-};
-
-static Sym getSym(void** p)
-{
-	Sym   sym;
-	char* t = (char*)*p;
-	while (char c = *t++)
-		sym.name += c;
-	sym.value = *(int*)t + (int)module_pc;
-	*p        = t + 4;
-	return sym;
-}
-
 static int findSym(const string& t)
 {
 	map<string, int>::iterator it;
 
-	it = module_syms.find(t);
-	if (it != module_syms.end())
-		return it->second;
 	it = runtime_syms.find(t);
 	if (it != runtime_syms.end())
 		return it->second;
@@ -248,35 +233,55 @@ static void link()
 
 	int k, cnt;
 
+	//symbol names, indexed by id
 	cnt = *(int*)p;
 	p   = (int*)p + 1;
+	vector<const char*> names(cnt);
 	for (k = 0; k < cnt; ++k) {
-		Sym sym = getSym(&p);
-		if (sym.value < (int)module_pc || sym.value >= (int)module_pc + sz)
+		names[k] = (char*)p;
+		p        = (char*)p + strlen(names[k]) + 1;
+	}
+
+	//symbol values - module symbols first, runtime symbols as they are needed
+	vector<int> dests(names.size(), 0);
+
+	cnt = *(int*)p;
+	p   = (int*)p + 1;
+	for (k = 0; k < cnt; ++k) {
+		int id = ((int*)p)[0], val = ((int*)p)[1];
+		p      = (int*)p + 2;
+		if (id < 0 || id >= names.size() || val < 0 || val >= sz)
 			fail();
-		module_syms[sym.name] = sym.value;
+		dests[id] = val + (int)module_pc;
 	}
 
 	cnt = *(int*)p;
 	p   = (int*)p + 1;
 	for (k = 0; k < cnt; ++k) {
-		Sym  sym  = getSym(&p);
-		int* pp   = (int*)sym.value;
-		int  dest = findSym(sym.name);
-		*pp += dest - (int)pp;
+		int pc = ((int*)p)[0], id = ((int*)p)[1];
+		p      = (int*)p + 2;
+		if (id < 0 || id >= names.size())
+			fail();
+		if (!dests[id])
+			dests[id] = findSym(names[id]);
+		int* pp = (int*)((char*)module_pc + pc);
+		*pp += dests[id] - (int)pp;
 	}
 
 	cnt = *(int*)p;
 	p   = (int*)p + 1;
 	for (k = 0; k < cnt; ++k) {
-		Sym  sym  = getSym(&p);
-		int* pp   = (int*)sym.value;
-		int  dest = findSym(sym.name);
-		*pp += dest;
+		int pc = ((int*)p)[0], id = ((int*)p)[1];
+		p      = (int*)p + 2;
+		if (id < 0 || id >= names.size())
+			fail();
+		if (!dests[id])
+			dests[id] = findSym(names[id]);
+		int* pp = (int*)((char*)module_pc + pc);
+		*pp += dests[id];
 	}
 
 	runtime_syms.clear();
-	module_syms.clear();
 }
 
 extern "C" _declspec(dllexport) int _stdcall bbWinMain();
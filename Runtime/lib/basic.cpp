@@ -1,4 +1,5 @@
 #include "bbsys.hpp"
+#include <cstdarg>
 #include <map>
 
 #include <stdutil.hpp>
@@ -167,6 +168,70 @@ BBStr* _bbStrConcat(BBStr* s1, BBStr* s2)
 	return s1;
 }
 
+//a$+b$+... in one go - kinds has a char for each part:
+//'s' a temp string, 'v' the address of a string var, 'c' a const C string,
+//'i' an int or 'f' a float.
+BBStr* _bbStrConcatN(const char* kinds, ...)
+{
+	va_list args;
+
+	//size it up front, so the result is only allocated once
+	int sz = 0;
+	va_start(args, kinds);
+	for (const char* k = kinds; *k; ++k) {
+		switch (*k) {
+		case 's':
+			sz += va_arg(args, BBStr*)->size();
+			break;
+		case 'v':
+			if (BBStr* s = *va_arg(args, BBStr**))
+				sz += s->size();
+			break;
+		case 'c':
+			sz += strlen(va_arg(args, const char*));
+			break;
+		default:
+			va_arg(args, int);
+			sz += 16; //longest int or float
+		}
+	}
+	va_end(args);
+
+	BBStr* str = new BBStr();
+	str->reserve(sz);
+	va_start(args, kinds);
+	for (const char* k = kinds; *k; ++k) {
+		switch (*k) {
+		case 's': {
+			BBStr* s = va_arg(args, BBStr*);
+			*str += *s;
+			delete s;
+			break;
+		}
+		case 'v':
+			if (BBStr* s = *va_arg(args, BBStr**))
+				*str += *s;
+			break;
+		case 'c':
+			*str += va_arg(args, const char*);
+			break;
+		case 'i': {
+			char buff[16];
+			_itoa(va_arg(args, int), buff, 10);
+			*str += buff;
+			break;
+		}
+		case 'f': {
+			int n = va_arg(args, int);
+			*str += ftoa(*(float*)&n);
+			break;
+		}
+		}
+	}
+	va_end(args);
+	return str;
+}
+
 int _bbStrCompare(BBStr* lhs, BBStr* rhs)
 {
 	int n = lhs->compare(*rhs);
@@ -175,6 +240,16 @@ int _bbStrCompare(BBStr* lhs, BBStr* rhs)
 	return n;
 }
 
+//Select dispatches on this - must match strHash in the compiler
+int _bbStrHash(BBStr* s, int seed)
+{
+	unsigned h = 2166136261u ^ seed;
+	for (int k = 0; k < s->size(); ++k)
+		h = (h ^ (unsigned char)(*s)[k]) * 16777619u;
+	delete s;
+	return h;
+}
+
 int _bbStrToInt(BBStr* s)
 {
 	int n = atoi(*s);
@@ -206,8 +281,8 @@ BBStr* _bbStrConst(const char* s)
 
 void* _bbVecAlloc(BBVecType* type)
 {
-	void* vec = bbMalloc(type->size * 4);
-	memset(vec, 0, type->size * 4);
+	void* vec = bbMalloc(type->size * sizeof(BBField));
+	memset(vec, 0, type->size * sizeof(BBField));
 	return vec;
 }
 
@@ -266,8 +341,8 @@ void _bbDimArray(BBArray* array)
 		array->scales[k] *= array->scales[k - 1];
 	}
 	int size    = array->scales[array->dims - 1];
-	array->data = bbMalloc(size * 4);
-	memset(array->data, 0, size * 4);
+	array->data = bbMalloc(size * sizeof(BBField));
+	memset(array->data, 0, size * sizeof(BBField));
 }
 
 void _bbArrayBoundsEx()
@@ -292,7 +367,7 @@ static void insertObj(BBObj* obj, BBObj* next)
 BBObj* _bbObjNew(BBObjType* type)
 {
 	if (type->free.next == &type->free) {
-		int    obj_size = sizeof(BBObj) + type->fieldCnt * 4;
+		int    obj_size = sizeof(BBObj) + type->fieldCnt * sizeof(BBField);
 		BBObj* o        = (BBObj*)bbMalloc(obj_size * OBJ_NEW_INC);
 		for (int k = 0; k < OBJ_NEW_INC; ++k) {
 			insertObj(o, &type->free);
@@ -681,7 +756,9 @@ void basic_link(void (*rtSym)(const char* sym, void* pc))
 	rtSym("_bbStrRelease", _bbStrRelease);
 	rtSym("_bbStrStore", _bbStrStore);
 	rtSym("_bbStrCompare", _bbStrCompare);
+	rtSym("_bbStrHash", _bbStrHash);
 	rtSym("_bbStrConcat", _bbStrConcat);
+	rtSym("_bbStrConcatN", _bbStrConcatN);
 	rtSym("_bbStrToInt", _bbStrToInt);
 	rtSym("_bbStrFromInt", _bbStrFromInt);
 	rtSym("_bbStrToFloat", _bbStrToFloat);
@@ -1,4 +1,5 @@
 #pragma once
+#include <cstdint>
 #include <mutex>
 #include <string>
 
@@ -22,11 +23,13 @@ struct BBVecType;
 union BBField;
 struct BBArray;
 
+//generated code reads and writes objects and arrays a pointer sized slot at a time, so
+//the ints in them are intptr_t - every slot is then the same size on 64 bit targets.
 struct BBObj {
 	BBField*   fields;
 	BBObj *    next, *prev;
 	BBObjType* type;
-	int        ref_cnt;
+	intptr_t   ref_cnt;
 };
 
 struct BBType {
@@ -55,8 +58,8 @@ union BBField {
 };
 
 struct BBArray {
-	void* data;
-	int   elementType, dims, scales[1];
+	void*    data;
+	intptr_t elementType, dims, scales[1];
 };
 
 struct BBStr : public std::string {
@@ -103,8 +106,10 @@ BBStr* _bbStrLoad(BBStr** var);
 void   _bbStrRelease(BBStr* str);
 void   _bbStrStore(BBStr** var, BBStr* str);
 int    _bbStrCompare(BBStr* lhs, BBStr* rhs);
+int    _bbStrHash(BBStr* s, int seed);
 
 BBStr* _bbStrConcat(BBStr* s1, BBStr* s2);
+BBStr* _bbStrConcatN(const char* kinds, ...);
 int    _bbStrToInt(BBStr* s);
 BBStr* _bbStrFromInt(int n);
 float  _bbStrToFloat(BBStr* s);
@@ -0,0 +1,362 @@
+/*
+
+  Compiler throughput over the #Test corpus.
+
+  Every program is tokenized, parsed, semanted, translated and assembled in process -
+  nothing is linked or run. Runtime functions are declared from the rtSym() calls in the
+  Runtime sources instead of from runtime.dll, so this runs headless anywhere compiler_lib
+  builds. Programs that don't compile (missing userlibs, includes and so on) are left out.
+
+  Usage: compiler_bench [-n runs] [-j jobs] [-O] [-v] [-root dir] [dir...]
+
+  The dirs are relative to -root, the source tree, and default to the samples, games and
+  tutorials.
+
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <assem_x86/assem_x86.hpp>
+#include <codegen_x86/codegen_x86.hpp>
+#include <environ.hpp>
+#include <ex.hpp>
+#include <linker.hpp>
+#include <optimizer.hpp>
+#include <parser.hpp>
+#include <prognode.hpp>
+#include <toker.hpp>
+#include <type.hpp>
+#include <stdutil.hpp>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static double now()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static bool chdirTo(const std::string& dir)
+{
+#ifdef _WIN32
+	return SetCurrentDirectory(dir.c_str()) != 0;
+#else
+	return chdir(dir.c_str()) == 0;
+#endif
+}
+
+//files under dir, recursively
+static void listFiles(const std::string& dir, std::vector<std::string>& files)
+{
+#ifdef _WIN32
+	WIN32_FIND_DATA fd;
+	HANDLE          h = FindFirstFile((dir + "\\*").c_str(), &fd);
+	if (h == INVALID_HANDLE_VALUE)
+		return;
+	do {
+		std::string t = fd.cFileName;
+		if (t == "." || t == "..")
+			continue;
+		if (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+			listFiles(dir + "\\" + t, files);
+		else
+			files.push_back(dir + "\\" + t);
+	} while (FindNextFile(h, &fd));
+	FindClose(h);
+#else
+	DIR* d = opendir(dir.c_str());
+	if (!d)
+		return;
+	while (dirent* e = readdir(d)) {
+		std::string t = e->d_name;
+		if (t == "." || t == "..")
+			continue;
+		struct stat st;
+		if (stat((dir + "/" + t).c_str(), &st))
+			continue;
+		if (S_ISDIR(st.st_mode))
+			listFiles(dir + "/" + t, files);
+		else
+			files.push_back(dir + "/" + t);
+	}
+	closedir(d);
+#endif
+}
+
+static bool endsWith(const std::string& s, const std::string& t)
+{
+	return s.size() >= t.size() && tolower(s.substr(s.size() - t.size())) == t;
+}
+
+static bool readFile(const std::string& file, std::string& text)
+{
+	std::ifstream in(file.c_str(), std::ios::binary);
+	if (!in)
+		return false;
+	text.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+	return true;
+}
+
+///////////////////////////////////////////////////////////////
+// The stub runtime environ - the first string of each rtSym //
+// call in the Runtime sources is the symbol runtime.dll has //
+// for the function.                                         //
+///////////////////////////////////////////////////////////////
+static int declareRuntime(const std::string& root, Environ* e)
+{
+	std::vector<std::string> files;
+	listFiles(root + "/Runtime", files);
+
+	int n = 0;
+	for (int k = 0; k < files.size(); ++k) {
+		std::string text;
+		if (!endsWith(files[k], ".cpp") || !readFile(files[k], text))
+			continue;
+		for (size_t i = 0; (i = text.find("rtSym(\"", i)) != std::string::npos;) {
+			std::string s;
+			for (i += 7; i < text.size() && text[i] != '\"'; ++i) {
+				if (text[i] == '\\')
+					++i;
+				s += text[i];
+			}
+
+			//internal?
+			if (!s.size() || s[0] == '_')
+				continue;
+
+			bool cfunc = s[0] == '!';
+			if (cfunc)
+				s = s.substr(1);
+			if (e->insertRuntimeFunc(s, cfunc))
+				++n;
+		}
+	}
+	return n;
+}
+
+enum { PH_TOKER, PH_PARSE, PH_SEMANT, PH_TRANSLATE, PH_COUNT };
+
+static const char* phaseNames[] = {"toker", "parse", "semant", "translate"};
+
+//totals for one run over the corpus
+struct Run {
+	double    secs[PH_COUNT];
+	long long lines[PH_COUNT]; //main file only for the toker, with includes after that
+	long long code;            //bytes assembled
+};
+
+struct Options {
+	int  jobs;
+	bool optimize;
+};
+
+//one program through every phase, adding to run - false if it doesn't compile
+static bool compileOne(const std::string& file, const std::string& text, Environ* runtime, const Options& opts,
+					   Run& run, std::string& err)
+{
+	std::vector<UserFunc> userFuncs;
+
+	double t0 = now();
+	{
+		Toker toker(text);
+		while (toker.curr() != EOF)
+			toker.next();
+	}
+	double t1 = now();
+	run.secs[PH_TOKER] += t1 - t0;
+	run.lines[PH_TOKER] += std::count(text.begin(), text.end(), '\n');
+
+	try {
+		Toker::lines_toked = 0;
+
+		t0 = now();
+		Toker                     toker(text);
+		Parser                    parser(toker);
+		std::shared_ptr<ProgNode> prog = parser.parse(file);
+		t1 = now();
+		run.secs[PH_PARSE] += t1 - t0;
+
+		std::shared_ptr<Environ> env = prog->semant(runtime);
+		t0                           = now();
+		run.secs[PH_SEMANT] += t0 - t1;
+
+		Module*       module = linkerGetLinker()->createModule();
+		qstreambuf    qbuf;
+		std::iostream asmcode(&qbuf);
+		Optimizer*    optimizer = opts.optimize ? new Optimizer() : 0;
+		{
+			Assem_x86   assem(module);
+			Codegen_x86 codegen(asmcode, false, &assem);
+			OptCodegen  optgen(&codegen, optimizer);
+			prog->translate(optimizer ? (Codegen*)&optgen : &codegen, userFuncs, opts.jobs);
+		}
+		t1 = now();
+		run.secs[PH_TRANSLATE] += t1 - t0;
+
+		ModuleStats ms = {};
+		module->getStats(&ms);
+		run.code += ms.code;
+		for (int k = PH_PARSE; k < PH_COUNT; ++k)
+			run.lines[k] += Toker::lines_toked;
+
+		delete optimizer;
+		linkerGetLinker()->deleteModule(module);
+	} catch (BlitzException& x) {
+		err = x.ex;
+		return false;
+	} catch (std::exception& x) {
+		err = x.what();
+		return false;
+	}
+	return true;
+}
+
+static void meanDev(const std::vector<double>& v, double& mean, double& dev)
+{
+	mean = dev = 0;
+	for (int k = 0; k < v.size(); ++k)
+		mean += v[k];
+	mean /= v.size();
+	for (int k = 0; k < v.size(); ++k)
+		dev += (v[k] - mean) * (v[k] - mean);
+	dev = v.size() > 1 ? sqrt(dev / (v.size() - 1)) : 0;
+}
+
+int main(int argc, char* argv[])
+{
+	std::string              root    = BENCH_ROOT;
+	std::vector<std::string> dirs;
+	Options                  opts    = {1, false};
+	int                      runs    = 10;
+	bool                     verbose = false;
+
+	for (int k = 1; k < argc; ++k) {
+		std::string t = argv[k];
+		if (t == "-n" && k + 1 < argc)
+			runs = std::max(1, atoi(argv[++k]));
+		else if (t == "-j" && k + 1 < argc)
+			opts.jobs = std::max(1, atoi(argv[++k]));
+		else if (t == "-root" && k + 1 < argc)
+			root = argv[++k];
+		else if (t == "-O")
+			opts.optimize = true;
+		else if (t == "-v")
+			verbose = true;
+		else if (t[0] == '-') {
+			std::cout << "Usage: compiler_bench [-n runs] [-j jobs] [-O] [-v] [-root dir] [dir...]" << std::endl;
+			return 1;
+		} else
+			dirs.push_back(t);
+	}
+	if (!dirs.size()) {
+		dirs.push_back("#Test/samples");
+		dirs.push_back("#Test/Games");
+		dirs.push_back("#Test/tutorials");
+	}
+
+	//vars are pointer sized, and this is the 32 bit codegen
+	Node::word = 4;
+
+	Environ* runtime = new Environ("", Type::int_type, 0, 0);
+	int      syms    = declareRuntime(root, runtime);
+	if (!syms) {
+		std::cout << "No rtSym() calls found under \"" << root << "/Runtime\"" << std::endl;
+		return 1;
+	}
+
+	//the corpus, held in memory so file reads aren't timed
+	struct Prog {
+		std::string file, dir, text;
+	};
+	std::vector<Prog> progs;
+	for (int k = 0; k < dirs.size(); ++k) {
+		std::vector<std::string> files;
+		listFiles(root + "/" + dirs[k], files);
+		std::sort(files.begin(), files.end());
+		for (int j = 0; j < files.size(); ++j) {
+			Prog p;
+			if (!endsWith(files[j], ".bb") || !readFile(files[j], p.text))
+				continue;
+			p.file = files[j];
+			p.dir  = p.file.substr(0, p.file.find_last_of("/\\") + 1);
+			progs.push_back(p);
+		}
+	}
+
+	//a warm up run, which also drops whatever doesn't compile
+	Run warm    = {};
+	int skipped = 0;
+	for (int k = 0; k < progs.size();) {
+		std::string err;
+		if (chdirTo(progs[k].dir) && compileOne(progs[k].file, progs[k].text, runtime, opts, warm, err)) {
+			++k;
+			continue;
+		}
+		if (verbose)
+			std::cout << "Skipped \"" << progs[k].file << "\": " << err << std::endl;
+		progs.erase(progs.begin() + k);
+		++skipped;
+	}
+	if (!progs.size()) {
+		std::cout << "Nothing to compile" << std::endl;
+		return 1;
+	}
+
+	std::cout << progs.size() << " programs, " << skipped << " skipped, " << syms << " runtime functions, " << runs
+			  << " runs" << std::endl;
+
+	std::vector<Run> results;
+	for (int r = 0; r < runs; ++r) {
+		Run run = {};
+		for (int k = 0; k < progs.size(); ++k) {
+			std::string err;
+			chdirTo(progs[k].dir);
+			if (!compileOne(progs[k].file, progs[k].text, runtime, opts, run, err)) {
+				std::cout << "\"" << progs[k].file << "\" stopped compiling: " << err << std::endl;
+				return 1;
+			}
+		}
+		results.push_back(run);
+	}
+
+	std::cout << std::fixed << std::setprecision(2);
+	std::cout << "Phase            ms/run      +/-      Klines/s      +/-" << std::endl;
+	double total = 0;
+	for (int p = 0; p < PH_COUNT; ++p) {
+		std::vector<double> ms, rate;
+		for (int r = 0; r < results.size(); ++r) {
+			ms.push_back(results[r].secs[p] * 1000);
+			rate.push_back(results[r].lines[p] / results[r].secs[p] / 1000);
+		}
+		double ms_mean, ms_dev, rate_mean, rate_dev;
+		meanDev(ms, ms_mean, ms_dev);
+		meanDev(rate, rate_mean, rate_dev);
+		total += ms_mean;
+		std::cout << std::left << std::setw(12) << phaseNames[p] << std::right << std::setw(11) << ms_mean
+				  << std::setw(9) << ms_dev << std::setw(14) << rate_mean << std::setw(9) << rate_dev << std::endl;
+	}
+	std::cout << std::left << std::setw(12) << "total" << std::right << std::setw(11) << total << std::endl;
+
+	std::vector<double> code;
+	for (int r = 0; r < results.size(); ++r)
+		code.push_back(results[r].code / results[r].secs[PH_TRANSLATE] / 1024);
+	double code_mean, code_dev;
+	meanDev(code, code_mean, code_dev);
+	std::cout << "Assembled " << results[0].code << " bytes a run, " << code_mean << " +/- " << code_dev << " KB/s"
+			  << std::endl;
+
+	delete runtime;
+	return 0;
+}
@@ -5,12 +5,22 @@
 
   Thanks NASM!
 
+  As well as the instruction table, this writes opcodes.hpp (one OP_ id per mnemonic) and a
+  perfect hash over the mnemonics, so the assembler never has to do a string keyed search.
+
+  It also writes keywords.cpp, the same sort of hash over the Blitz keywords for the Toker.
+
 */
 
+#ifdef _WIN32
 #include <conio.h>
+#endif
+#include <climits>
+#include <cstdio>
 #include <fstream>
 #include <iostream>
 #include <string>
+#include <vector>
 
 using namespace std;
 
@@ -64,13 +74,151 @@ static const char* optype(const string& s)
 		return "FPUREG";
 	if (s == "ST0")
 		return "ST0";
+	if (s == "xmmreg")
+		return "XMMREG";
+	if (s == "xmm/m32")
+		return "XMMREG|MEM32";
+	if (s == "xmm/m128")
+		return "XMMREG|MEM";
 	return 0;
 }
 
-void __cdecl main()
+//Blitz keywords and their tokens - the two word forms are looked up as one keyword
+static const char* keywords[][2] = {
+	{"Dim", "DIM"},
+	{"Goto", "GOTO"},
+	{"Gosub", "GOSUB"},
+	{"Return", "RETURN"},
+	{"Exit", "EXIT"},
+	{"If", "IF"},
+	{"Then", "THEN"},
+	{"Else", "ELSE"},
+	{"EndIf", "ENDIF"},
+	{"End If", "ENDIF"},
+	{"ElseIf", "ELSEIF"},
+	{"Else If", "ELSEIF"},
+	{"While", "WHILE"},
+	{"Wend", "WEND"},
+	{"For", "FOR"},
+	{"To", "TO"},
+	{"Step", "STEP"},
+	{"Next", "NEXT"},
+	{"Function", "FUNCTION"},
+	{"End Function", "ENDFUNCTION"},
+	{"Type", "TYPE"},
+	{"End Type", "ENDTYPE"},
+	{"Each", "EACH"},
+	{"Local", "LOCAL"},
+	{"Global", "GLOBAL"},
+	{"Field", "FIELD"},
+	{"Const", "BBCONST"},
+	{"Select", "SELECT"},
+	{"Case", "CASE"},
+	{"Default", "DEFAULT"},
+	{"End Select", "ENDSELECT"},
+	{"Repeat", "REPEAT"},
+	{"Until", "UNTIL"},
+	{"Forever", "FOREVER"},
+	{"Data", "DATA"},
+	{"Read", "READ"},
+	{"Restore", "RESTORE"},
+	{"Abs", "ABS"},
+	{"Sgn", "SGN"},
+	{"Mod", "MOD"},
+	{"Pi", "PI"},
+	{"True", "BBTRUE"},
+	{"False", "BBFALSE"},
+	{"Int", "BBINT"},
+	{"Float", "BBFLOAT"},
+	{"Str", "BBSTR"},
+	{"Include", "INCLUDE"},
+	{"New", "BBNEW"},
+	{"Delete", "BBDELETE"},
+	{"First", "FIRST"},
+	{"Last", "LAST"},
+	{"Insert", "INSERT"},
+	{"Before", "BEFORE"},
+	{"After", "AFTER"},
+	{"Null", "BBNULL"},
+	{"Object", "OBJECT"},
+	{"Handle", "BBHANDLE"},
+	{"And", "AND"},
+	{"Or", "OR"},
+	{"Xor", "XOR"},
+	{"Not", "NOT"},
+	{"Shl", "SHL"},
+	{"Shr", "SHR"},
+	{"Sar", "SAR"},
+};
+
+//must match instHash() in insts.hpp
+static unsigned instHash(const string& s, unsigned seed)
+{
+	unsigned h = 2166136261u ^ (seed * 0x9e3779b9u);
+	for (size_t k = 0; k < s.size(); ++k)
+		h = (h ^ (unsigned char)s[k]) * 16777619u;
+	return h ^ (h >> 15);
+}
+
+//hash and displace: each bucket of names gets a seed that drops all of its names into free slots.
+static bool buildHash(const vector<string>& names, int buckets, int slots, vector<int>& disp, vector<int>& table)
+{
+	vector<vector<int> > bucket(buckets);
+	for (size_t k = 0; k < names.size(); ++k)
+		bucket[instHash(names[k], 0) % buckets].push_back(k);
+
+	vector<int> order;
+	for (int n = 0; n < buckets; ++n)
+		order.push_back(n);
+	for (size_t i = 0; i < order.size(); ++i) {
+		for (size_t j = i + 1; j < order.size(); ++j) {
+			if (bucket[order[j]].size() > bucket[order[i]].size())
+				swap(order[i], order[j]);
+		}
+	}
+
+	disp.assign(buckets, 0);
+	table.assign(slots, -1);
+	for (size_t i = 0; i < order.size(); ++i) {
+		const vector<int>& b = bucket[order[i]];
+		if (!b.size())
+			break;
+		int d;
+		for (d = 1; d < 65536; ++d) {
+			vector<int> used;
+			size_t      k;
+			for (k = 0; k < b.size(); ++k) {
+				int slot = instHash(names[b[k]], d) % slots;
+				if (table[slot] >= 0)
+					break;
+				size_t j;
+				for (j = 0; j < used.size() && used[j] != slot; ++j) {
+				}
+				if (j < used.size())
+					break;
+				used.push_back(slot);
+			}
+			if (k == b.size()) {
+				for (k = 0; k < b.size(); ++k)
+					table[used[k]] = b[k];
+				break;
+			}
+		}
+		if (d == 65536)
+			return false;
+		disp[order[i]] = d;
+	}
+	return true;
+}
+
+int main()
 {
 	string name, lhs, rhs, byte, bytes, flags, last;
 
+	vector<string> opNames;
+	vector<int>    opIndex;
+	int            entry = 0;
+
 	ifstream in("nasm_insts.txt");
 	ofstream out("insts.cpp");
 
@@ -177,18 +325,95 @@ void __cdecl main()
 			name = "0";
 		else {
 			last = name;
+			opNames.push_back(name);
+			opIndex.push_back(entry);
 			name = '\"' + name + '\"';
 		}
 
 		char bf[4];
-		_itoa(bytes.size() / 3, bf, 16);
+		sprintf(bf, "%x", (int)(bytes.size() / 4)); //each byte is \\xNN
 		bytes = "\\x" + string(bf) + bytes;
 
 		out << name << ',' << lop << ',' << rop << ',' << flags << ",\"" << bytes << "\",\n";
+		++entry;
 	}
 	out << "\"\",0,0,0,0\n};\n";
+
+	//opcode ids
+	ofstream ops("opcodes.hpp");
+	ops << "//\n//This is generated code - do not modify!!!!!\n//\n";
+	ops << "\n#pragma once\n\n";
+	ops << "enum{\n";
+	for (size_t k = 0; k < opNames.size(); ++k) {
+		string t = opNames[k];
+		for (size_t n = 0; n < t.size(); ++n)
+			t[n] = toupper(t[n]);
+		ops << "\tOP_" << t << ",\n";
+	}
+	ops << "\tOP_COUNT\n};\n";
+	ops.close();
+
+	//first insts[] entry for each opcode
+	out << "\nconst short instIndex[]={";
+	for (size_t k = 0; k < opIndex.size(); ++k)
+		out << (k % 16 ? "" : "\n") << opIndex[k] << ',';
+	out << "\n};\n";
+
+	//perfect hash from mnemonic to opcode
+	int         buckets = opNames.size() / 2 + 1, slots = opNames.size() + opNames.size() / 4;
+	vector<int> disp, table;
+	while (!buildHash(opNames, buckets, slots, disp, table))
+		++slots;
+
+	out << "\nconst int instHashBuckets=" << buckets << ",instHashSlots=" << slots << ";\n";
+	out << "\nconst unsigned short instHashDisp[]={";
+	for (size_t k = 0; k < disp.size(); ++k)
+		out << (k % 16 ? "" : "\n") << disp[k] << ',';
+	out << "\n};\n";
+	out << "\nconst short instHashTable[]={";
+	for (size_t k = 0; k < table.size(); ++k)
+		out << (k % 16 ? "" : "\n") << table[k] << ',';
+	out << "\n};\n";
+
 	out.flush();
 	out.close();
+
+	//keywords, hashed on their lowercased names
+	vector<string> kwNames;
+	int            kwCount = sizeof(keywords) / sizeof(keywords[0]);
+	for (int k = 0; k < kwCount; ++k) {
+		string t = keywords[k][0];
+		for (size_t n = 0; n < t.size(); ++n)
+			t[n] = tolower(t[n]);
+		kwNames.push_back(t);
+	}
+	buckets = kwNames.size() / 2 + 1;
+	slots   = kwNames.size() + kwNames.size() / 4;
+	while (!buildHash(kwNames, buckets, slots, disp, table))
+		++slots;
+
+	ofstream kws("keywords.cpp");
+	kws << "//\n//This is generated code - do not modify!!!!!\n//\n";
+	kws << "\n#include \"keywords.hpp\"\n#include \"toker.hpp\"\n\n";
+	kws << "const Keyword keywords[]={\n";
+	for (int k = 0; k < kwCount; ++k)
+		kws << "{\"" << keywords[k][0] << "\"," << keywords[k][1] << "},\n";
+	kws << "};\n";
+	kws << "\nconst int keywordCount=" << kwCount << ";\n";
+	kws << "\nconst int keywordHashBuckets=" << buckets << ",keywordHashSlots=" << slots << ";\n";
+	kws << "\nconst unsigned short keywordHashDisp[]={";
+	for (size_t k = 0; k < disp.size(); ++k)
+		kws << (k % 16 ? "" : "\n") << disp[k] << ',';
+	kws << "\n};\n";
+	kws << "\nconst short keywordHashTable[]={";
+	for (size_t k = 0; k < table.size(); ++k)
+		kws << (k % 16 ? "" : "\n") << table[k] << ',';
+	kws << "\n};\n";
+	kws.close();
+
 	cout << "All done!\n";
+#ifdef _WIN32
 	_getch();
+#endif
+	return 0;
 }
@@ -5,8 +5,9 @@
 
 class Assem {
 	public:
-	std::istream& in;
+	std::istream* in;
 	Module*  mod;
-	Assem(std::istream& in, Module* mod) : in(in), mod(mod) {}
+	Assem(std::istream& in, Module* mod) : in(&in), mod(mod) {}
+	Assem(Module* mod) : in(0), mod(mod) {}
 	virtual void assemble() = 0;
 };
@@ -1,68 +1,48 @@
 /* BlitzPC assembler.
-  This REALLY needs some work - very slow. */
+  Mnemonics are found through the perfect hash generated into insts.cpp, and operands
+  are parsed in place, so the only strings built are labels. */
 
 #include "assem_x86.hpp"
-#include <map>
 #include "../ex.hpp"
 #include "insts.hpp"
 #include "operand.hpp"
 #include <istream>
+#include <cstring>
 
 #include <iomanip>
 
-typedef std::map<std::string, Inst*> InstMap;
-typedef InstMap::value_type          InstPair;
-typedef InstMap::const_iterator      InstIter;
+//#define LOG
 
-static InstMap instMap;
+Assem_x86::Assem_x86(std::istream& in, Module* mod) : Assem(in, mod), encoded(0) {}
 
-//#define LOG
+Assem_x86::Assem_x86(Module* mod) : Assem(mod), encoded(0) {}
 
-Assem_x86::Assem_x86(std::istream& in, Module* mod) : Assem(in, mod)
+static int findOp(const char* name, int len)
 {
-	//build instruction map, if not built already.
-	if (!instMap.size()) {
-		for (int k = 0; !insts[k].name || insts[k].name[0]; ++k) {
-			if (insts[k].name)
-				instMap.insert(InstPair(insts[k].name, &insts[k]));
-		}
-	}
+	unsigned b  = instHash(name, len, 0) % instHashBuckets;
+	int      op = instHashTable[instHash(name, len, instHashDisp[b]) % instHashSlots];
+	if (op < 0)
+		return -1;
+	const char* t = insts[instIndex[op]].name;
+	if (strncmp(t, name, len) || t[len])
+		return -1;
+	return op;
 }
 
-static int findCC(const std::string& s)
+static int findCC(const char* s, int len)
 {
-	if (s == "o")
-		return 0;
-	if (s == "no")
-		return 1;
-	if (s == "b" || s == "c" || s == "nae")
-		return 2;
-	if (s == "ae" || s == "nb" || s == "nc")
-		return 3;
-	if (s == "e" || s == "z")
-		return 4;
-	if (s == "ne" || s == "nz")
-		return 5;
-	if (s == "be" || s == "na")
-		return 6;
-	if (s == "a" || s == "nbe")
-		return 7;
-	if (s == "s")
-		return 8;
-	if (s == "ns")
-		return 9;
-	if (s == "p" || s == "pe")
-		return 10;
-	if (s == "ne" || s == "po")
-		return 11;
-	if (s == "l" || s == "nge")
-		return 12;
-	if (s == "ge" || s == "nl")
-		return 13;
-	if (s == "le" || s == "ng")
-		return 14;
-	if (s == "g" || s == "nle")
-		return 15;
+	static const struct {
+		const char* name;
+		int         cc;
+	} ccs[] = {{"o", 0},   {"no", 1},   {"b", 2},   {"c", 2},   {"nae", 2}, {"ae", 3},  {"nb", 3},  {"nc", 3},
+			   {"e", 4},   {"z", 4},    {"ne", 5},  {"nz", 5},  {"be", 6},  {"na", 6},  {"a", 7},   {"nbe", 7},
+			   {"s", 8},   {"ns", 9},   {"p", 10},  {"pe", 10}, {"np", 11}, {"po", 11}, {"l", 12},  {"nge", 12},
+			   {"ge", 13}, {"nl", 13},  {"le", 14}, {"ng", 14}, {"g", 15},  {"nle", 15}};
+
+	for (int k = 0; k < sizeof(ccs) / sizeof(ccs[0]); ++k) {
+		if (!strncmp(ccs[k].name, s, len) && !ccs[k].name[len])
+			return ccs[k].cc;
+	}
 	return -1;
 }
 
@@ -115,7 +95,7 @@ void Assem_x86::emitImm(const Operand& o, int size)
 
 void Assem_x86::emitImm(const std::string& s, int size)
 {
-	Operand op(s);
+	Operand op(s.data(), s.data() + s.size());
 	op.parse();
 	if (!(op.mode & IMM))
 		throw BlitzException("operand must be immediate");
@@ -136,45 +116,53 @@ void Assem_x86::a_reloc(const std::string& s)
 	mod->addReloc(s.c_str(), mod->getPC(), false);
 }
 
-void Assem_x86::assemInst(const std::string& name, const std::string& lhs, const std::string& rhs)
-{
-	//parse operands
-	Operand lop(lhs), rop(rhs);
-	lop.parse();
-	rop.parse();
-
-	//find instruction
-	int   cc   = -1;
-	Inst* inst = 0;
+static Inst jCC   = {"jCC", IMM, NONE, RW_RD | PLUSCC, "\x2\x0F\x80"};
+static Inst setCC = {"setne", R_M8, NONE, _2 | PLUSCC, "\x2\x0F\x90"};
 
+void Assem_x86::assemInst(const char* name, int len, const Operand& lop, const Operand& rop)
+{
 	//kludge for condition code instructions...
+	int cc = -1;
 	if (name[0] == 'j') {
-		if ((cc = findCC(name.substr(1))) >= 0) {
-			static Inst jCC = {"jCC", IMM, NONE, RW_RD | PLUSCC, "\x2\x0F\x80"};
-			inst            = &jCC;
+		if ((cc = findCC(name + 1, len - 1)) >= 0) {
+			encode(OP_JCC, lop, rop, cc);
+			return;
 		}
-	} else if (name[0] == 's' && name.substr(0, 3) == "set") {
-		if ((cc = findCC(name.substr(3))) >= 0) {
-			static Inst setCC = {"setne", R_M8, NONE, _2 | PLUSCC, "\x2\x0F\x90"};
-			inst              = &setCC;
+	} else if (len > 3 && !strncmp(name, "set", 3)) {
+		if ((cc = findCC(name + 3, len - 3)) >= 0) {
+			encode(OP_SETCC, lop, rop, cc);
+			return;
 		}
 	}
 
-	if (inst) {
+	int op = findOp(name, len);
+	if (op < 0)
+		throw BlitzException("unrecognized instruction");
+	encode(op, lop, rop);
+}
+
+void Assem_x86::encode(int op, const Operand& lop, const Operand& rop, int cc)
+{
+	if (op < 0) {
+		const Inst* inst = op == OP_JCC ? &jCC : &setCC;
 		if (!(lop.mode & inst->lmode) || !(rop.mode & inst->rmode))
 			throw BlitzException("illegal addressing mode");
-	} else {
-		InstIter it = instMap.find(name);
-		if (it == instMap.end())
-			throw BlitzException("unrecognized instruction");
-		inst = it->second;
-		for (;;) {
-			if ((lop.mode & inst->lmode) && (rop.mode & inst->rmode))
-				break;
-			if ((++inst)->name)
-				throw BlitzException("illegal addressing mode");
-		}
+		encodeInst(inst, lop, rop, cc);
+		return;
+	}
+	const Inst* inst = &insts[instIndex[op]];
+	for (;;) {
+		if ((lop.mode & inst->lmode) && (rop.mode & inst->rmode))
+			break;
+		if ((++inst)->name)
+			throw BlitzException("illegal addressing mode");
 	}
+	encodeInst(inst, lop, rop, -1);
+}
+
+void Assem_x86::encodeInst(const Inst* inst, const Operand& lop, const Operand& rop, int cc)
+{
+	++encoded;
 
 	//16/32 bit modifier - NOP for now
 	if (inst->flags & (O16 | O32)) {
@@ -222,11 +210,12 @@ void Assem_x86::assemInst(const std::string& name, const std::string& lhs, const
 			rm = 7;
 			break;
 		case _R:
-			rm = (inst->rmode & (REG8 | REG16 | REG32)) ? rop.reg : lop.reg;
+			//an xmmreg on its own on the right is the reg field, eg: movss mem32,xmmreg
+			rm = (inst->rmode & (REG8 | REG16 | REG32) || inst->rmode == XMMREG) ? rop.reg : lop.reg;
 			break;
 		}
 		rm <<= 3;
-		if (mop.mode & REG) { //reg
+		if (mop.mode & (REG | XMMREG)) { //reg
 			emit(0xc0 | rm | mop.reg);
 		} else if (mop.baseReg >= 0) { //base, index?
 			int mod = mop.offset ? 0x40 : 0x00;
@@ -308,7 +297,7 @@ void Assem_x86::assemDir(const std::string& name, const std::string& op)
 	} else if (name == ".dd") {
 		emitImm(op, 4);
 	} else if (name == ".align") {
-		Operand o(op);
+		Operand o(op.data(), op.data() + op.size());
 		o.parse();
 		if (!(o.mode & IMM))
 			throw BlitzException("operand must be immediate");
@@ -318,33 +307,36 @@ void Assem_x86::assemDir(const std::string& name, const std::string& op)
 	}
 }
 
-void Assem_x86::assemLine(const std::string& line)
+const char* Assem_x86::assemLine(const char* line)
 {
-	int                      i = 0;
-	std::string              name;
-	std::vector<std::string> ops;
+	int i = 0;
 
 	//label?
 	if (!isspace(line[i])) {
 		while (!isspace(line[i]))
 			++i;
-		std::string lab = line.substr(0, i);
-		if (!mod->addSymbol(lab.c_str(), mod->getPC()))
-			throw BlitzException("duplicate label");
+		label(std::string(line, i));
 	}
 
 	//skip space
 	while (isspace(line[i]) && line[i] != '\n')
 		++i;
-	if (line[i] == '\n' || line[i] == ';')
-		return;
+	if (line[i] == ';') {
+		while (line[i] != '\n')
+			++i;
+	}
+	if (line[i] == '\n')
+		return line + i + 1;
 
 	//fetch instruction name
-	int from = i;
+	const char* name = line + i;
 	for (++i; !isspace(line[i]); ++i) {
 	}
-	name = line.substr(from, i - from);
+	int  len = line + i - name;
+	bool dir = name[0] == '.';
 
+	Operand ops[2];
+	int     n_ops = 0;
 	for (;;) {
 		//skip space
 		while (isspace(line[i]) && line[i] != '\n')
@@ -364,9 +356,19 @@ void Assem_x86::assemLine(const std::string& line)
 		}
 
 		//back-up over space
-		while (i && isspace(line[i - 1]))
-			--i;
-		ops.push_back(line.substr(from, i - from));
+		int to = i;
+		while (to && isspace(line[to - 1]))
+			--to;
+
+		if (dir) {
+			//pseudo op!
+			assemDir(std::string(name, len), std::string(line + from, to - from));
+		} else {
+			if (n_ops == 2)
+				throw BlitzException("Too many operands");
+			ops[n_ops] = Operand(line + from, line + to);
+			ops[n_ops++].parse();
+		}
 
 		//skip space
 		while (isspace(line[i]) && line[i] != '\n')
@@ -377,34 +379,81 @@ void Assem_x86::assemLine(const std::string& line)
 		if (line[i++] != ',')
 			throw BlitzException("expecting ','");
 	}
-
-	//pseudo op?
-	if (name[0] == '.') {
-		for (int k = 0; k < ops.size(); ++k)
-			assemDir(name, ops[k]);
-		return;
-	}
+	while (line[i] != '\n')
+		++i;
 
 	//normal instruction!
-	if (ops.size() > 2)
-		throw BlitzException("Too many operands");
-	ops.push_back("");
-	ops.push_back("");
-	assemInst(name, ops[0], ops[1]);
+	if (!dir)
+		assemInst(name, len, ops[0], ops[1]);
+	else if (std::string(name, len) == ".data")
+		mod->beginData();
+	return line + i + 1;
+}
+
+void Assem_x86::label(const std::string& l)
+{
+	if (!mod->addSymbol(l.c_str(), mod->getPC()))
+		throw BlitzException("duplicate label");
+}
+
+//a module that only counts what's emitted into it
+class SizeModule : public Module {
+	public:
+	int size;
+	SizeModule() : size(0) {}
+
+	void* link(Module* libs) { return 0; }
+	bool  createExe(const char* exe_file, const char* dll_file) { return false; }
+	int   getPC() { return size; }
+	void  emit(int byte) { size += 1; }
+	void  emitw(int word) { size += 2; }
+	void  emitd(int dword) { size += 4; }
+	void  emitx(void* data, int sz) { size += sz; }
+	void  beginData() {}
+	bool  addSymbol(const char* sym, int pc) { return true; }
+	bool  addReloc(const char* dest_sym, int pc, bool pcrel) { return true; }
+	bool  findSymbol(const char* sym, int* pc) { return false; }
+	void  getStats(ModuleStats* st) {}
+};
+
+int Assem_x86::measure(int op, const Operand& lhs, const Operand& rhs, int cc)
+{
+	SizeModule m;
+	Assem_x86  a(&m);
+	a.encode(op, lhs, rhs, cc);
+	return m.size;
+}
+
+std::string Assem_x86::source(int op, const Operand& lhs, const Operand& rhs, int cc)
+{
+	static const char* ccs[] = {"o", "no", "b", "ae", "z", "nz", "be", "a", "s", "ns", "p", "np", "l", "ge", "le", "g"};
+
+	std::string t = "\t";
+	if (op == OP_JCC)
+		t += std::string("j") + ccs[cc];
+	else if (op == OP_SETCC)
+		t += std::string("set") + ccs[cc];
+	else
+		t += insts[instIndex[op]].name;
+	if (lhs.mode != NONE)
+		t += '\t' + lhs.str();
+	if (rhs.mode != NONE)
+		t += ',' + rhs.str();
+	return t + '\n';
 }
 
 void Assem_x86::assemble()
 {
 	std::string line;
 
-	while (!in.eof()) {
+	while (!in->eof()) {
 		try {
-			std::getline(in, line);
+			std::getline(*in, line);
 			line += '\n';
 #ifdef LOG
 			clog << line;
 #endif
-			assemLine(line);
+			assemLine(line.c_str());
 #ifdef LOG
 			clog << endl;
 #endif
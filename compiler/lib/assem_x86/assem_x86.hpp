@@ -4,26 +4,48 @@
 #include <string>
 #include <vector>
 #include "assem.hpp"
+#include "opcodes.hpp"
+#include "operand.hpp"
 
 class Module;
-struct Operand;
+struct Inst;
+
+//jcc and setcc aren't in the instruction table - these are their ops for encode(), which takes
+//the condition code as cc. A condition is negated by flipping its bottom bit.
+enum { OP_JCC = -1, OP_SETCC = -2 };
+enum { CC_O, CC_NO, CC_B, CC_AE, CC_Z, CC_NZ, CC_BE, CC_A, CC_S, CC_NS, CC_P, CC_NP, CC_L, CC_GE, CC_LE, CC_G };
 
 class Assem_x86 : public Assem {
 	public:
 	Assem_x86(std::istream& in, Module* mod);
+	Assem_x86(Module* mod);
+
+	int encoded; //instructions, so far
 
 	virtual void assemble();
 
-	private:
+	//direct interface, used by the binary code generator
+	void encode(int op, const Operand& lhs = Operand(), const Operand& rhs = Operand(), int cc = -1);
+
+	//size of an instruction in bytes, without emitting it
+	static int measure(int op, const Operand& lhs = Operand(), const Operand& rhs = Operand(), int cc = -1);
+
+	//an instruction as a line of source for assemble(), eg: "\tmov\teax,[ebp-4]\n"
+	static std::string source(int op, const Operand& lhs = Operand(), const Operand& rhs = Operand(), int cc = -1);
+
+	void label(const std::string& l);
 	void align(int n);
 	void emit(int n);
 	void emitw(int n);
 	void emitd(int n);
-	void emitImm(const std::string& s, int size);
-	void emitImm(const Operand& o, int size);
 	void r_reloc(const std::string& dest);
 	void a_reloc(const std::string& dest);
+
+	private:
+	void emitImm(const std::string& s, int size);
+	void emitImm(const Operand& o, int size);
 	void assemDir(const std::string& name, const std::string& op);
-	void assemInst(const std::string& name, const std::string& lhs, const std::string& rhs);
-	void assemLine(const std::string& line);
+	void assemInst(const char* name, int len, const Operand& lhs, const Operand& rhs);
+	void encodeInst(const Inst* inst, const Operand& lhs, const Operand& rhs, int cc);
+	const char* assemLine(const char* line);
 };
@@ -39,6 +39,7 @@ Inst insts[]={
 0,R_M32,IMM32,O32|_0|ID,"\x1\x81",
 0,R_M16,IMM8,O16|_0|IB,"\x1\x83",
 0,R_M32,IMM8,O32|_0|IB,"\x1\x83",
+"addss",XMMREG,XMMREG|MEM32,_R,"\x3\xF3\x0F\x58",
 "and",AL,IMM8,IB,"\x1\x24",
 0,AX,IMM16,O16|IW,"\x1\x25",
 0,EAX,IMM32,O32|ID,"\x1\x25",
@@ -115,7 +116,11 @@ Inst insts[]={
 0,R_M16,REG16,O16|_R,"\x2\x0F\xA7",
 0,R_M32,REG32,O32|_R,"\x2\x0F\xA7",
 "cmpxchg8b",MEM,NONE,_1,"\x2\x0F\xC7",
+"comiss",XMMREG,XMMREG|MEM32,_R,"\x2\x0F\x2F",
 "cpuid",NONE,NONE,0,"\x2\x0F\xA2",
+"cvtsi2ss",XMMREG,R_M32,_R,"\x3\xF3\x0F\x2A",
+"cvtss2si",REG32,XMMREG|MEM32,_R,"\x3\xF3\x0F\x2D",
+"cvttss2si",REG32,XMMREG|MEM32,_R,"\x3\xF3\x0F\x2C",
 "daa",NONE,NONE,0,"\x1\x27",
 "das",NONE,NONE,0,"\x1\x2F",
 "dec",REG16,NONE,O16|PLUSREG,"\x1\x48",
@@ -126,6 +131,7 @@ Inst insts[]={
 "div",R_M8,NONE,_6,"\x1\xF6",
 0,R_M16,NONE,O16|_6,"\x1\xF7",
 0,R_M32,NONE,O32|_6,"\x1\xF7",
+"divss",XMMREG,XMMREG|MEM32,_R,"\x3\xF3\x0F\x5E",
 "emms",NONE,NONE,0,"\x2\x0F\x77",
 "enter",IMM,IMM,IW|IB,"\x1\xC8",
 "f2xm1",NONE,NONE,0,"\x2\xD9\xF0",
@@ -137,7 +143,7 @@ Inst insts[]={
 "faddp",FPUREG,NONE,PLUSREG,"\x2\xDE\xC0",
 0,FPUREG,ST0,PLUSREG,"\x2\xDE\xC0",
 "fchs",NONE,NONE,0,"\x2\xD9\xE0",
-"fclex",NONE,NONE,0,"\x4\x9B\xDB\xE2",
+"fclex",NONE,NONE,0,"\x3\x9B\xDB\xE2",
 "fnclex",NONE,NONE,0,"\x2\xDB\xE2",
 "fcmovb",FPUREG,NONE,PLUSREG,"\x2\xDA\xC0",
 0,ST0,FPUREG,PLUSREG,"\x2\xDA\xC0",
@@ -168,9 +174,9 @@ Inst insts[]={
 0,ST0,FPUREG,PLUSREG,"\x2\xDF\xF0",
 "fcos",NONE,NONE,0,"\x2\xD9\xFF",
 "fdecstp",NONE,NONE,0,"\x2\xD9\xF6",
-"fdisi",NONE,NONE,0,"\x4\x9B\xDB\xE1",
+"fdisi",NONE,NONE,0,"\x3\x9B\xDB\xE1",
 "fndisi",NONE,NONE,0,"\x2\xDB\xE1",
-"feni",NONE,NONE,0,"\x4\x9B\xDB\xE0",
+"feni",NONE,NONE,0,"\x3\x9B\xDB\xE0",
 "fneni",NONE,NONE,0,"\x2\xDB\xE0",
 "fdiv",MEM32,NONE,_6,"\x1\xD8",
 0,FPUREG,NONE,PLUSREG,"\x2\xD8\xF0",
@@ -204,7 +210,7 @@ Inst insts[]={
 "fimul",MEM16,NONE,_1,"\x1\xDE",
 0,MEM32,NONE,_1,"\x1\xDA",
 "fincstp",NONE,NONE,0,"\x2\xD9\xF7",
-"finit",NONE,NONE,0,"\x4\x9B\xDB\xE3",
+"finit",NONE,NONE,0,"\x3\x9B\xDB\xE3",
 "fninit",NONE,NONE,0,"\x2\xDB\xE3",
 "fisub",MEM16,NONE,_4,"\x1\xDE",
 0,MEM32,NONE,_4,"\x1\xDA",
@@ -250,7 +256,7 @@ Inst insts[]={
 "fstenv",MEM,NONE,_6,"\x2\x9B\xD9",
 "fnstenv",MEM,NONE,_6,"\x1\xD9",
 "fstsw",MEM16,NONE,_0,"\x2\x9B\xDD",
-0,AX,NONE,0,"\x4\x9B\xDF\xE0",
+0,AX,NONE,0,"\x3\x9B\xDF\xE0",
 "fnstsw",MEM16,NONE,_0,"\x1\xDD",
 0,AX,NONE,0,"\x2\xDF\xE0",
 "fsub",MEM32,NONE,_4,"\x1\xD8",
@@ -363,9 +369,13 @@ Inst insts[]={
 0,R_M8,IMM8,_0|IB,"\x1\xC6",
 0,R_M16,IMM16,O16|_0|IW,"\x1\xC7",
 0,R_M32,IMM32,O32|_0|ID,"\x1\xC7",
+"movd",XMMREG,R_M32,_R,"\x3\x66\x0F\x6E",
+0,R_M32,XMMREG,_R,"\x3\x66\x0F\x7E",
 "movsb",NONE,NONE,0,"\x1\xA4",
 "movsw",NONE,NONE,O16,"\x1\xA5",
 "movsd",NONE,NONE,O32,"\x1\xA5",
+"movss",XMMREG,XMMREG|MEM32,_R,"\x3\xF3\x0F\x10",
+0,MEM32,XMMREG,_R,"\x3\xF3\x0F\x11",
 "movsx",REG16,R_M8,O16|_R,"\x2\x0F\xBE",
 0,REG32,R_M8,O32|_R,"\x2\x0F\xBE",
 0,REG32,R_M16,O32|_R,"\x2\x0F\xBF",
@@ -375,6 +385,7 @@ Inst insts[]={
 "mul",R_M8,NONE,_4,"\x1\xF6",
 0,R_M16,NONE,O16|_4,"\x1\xF7",
 0,R_M32,NONE,O32|_4,"\x1\xF7",
+"mulss",XMMREG,XMMREG|MEM32,_R,"\x3\xF3\x0F\x59",
 "neg",R_M8,NONE,_3,"\x1\xF6",
 0,R_M16,NONE,O16|_3,"\x1\xF7",
 0,R_M32,NONE,O32|_3,"\x1\xF7",
@@ -528,6 +539,7 @@ Inst insts[]={
 0,R_M32,IMM32,O32|_5|ID,"\x1\x81",
 0,R_M16,IMM8,O16|_5|IB,"\x1\x83",
 0,R_M32,IMM8,O32|_5|IB,"\x1\x83",
+"subss",XMMREG,XMMREG|MEM32,_R,"\x3\xF3\x0F\x5C",
 "test",AL,IMM8,IB,"\x1\xA8",
 0,AX,IMM16,O16|IW,"\x1\xA9",
 0,EAX,IMM32,O32|ID,"\x1\xA9",
@@ -537,6 +549,7 @@ Inst insts[]={
 0,R_M8,IMM8,_7|IB,"\x1\xF6",
 0,R_M16,IMM16,O16|_7|IW,"\x1\xF7",
 0,R_M32,IMM32,O32|_7|ID,"\x1\xF7",
+"ucomiss",XMMREG,XMMREG|MEM32,_R,"\x2\x0F\x2E",
 "umov",R_M8,REG8,_R,"\x2\x0F\x10",
 0,R_M16,REG16,O16|_R,"\x2\x0F\x11",
 0,R_M32,REG32,O32|_R,"\x2\x0F\x11",
@@ -578,5 +591,64 @@ Inst insts[]={
 0,R_M32,IMM32,O32|_6|ID,"\x1\x81",
 0,R_M16,IMM8,O16|_6|IB,"\x1\x83",
 0,R_M32,IMM8,O32|_6|IB,"\x1\x83",
+"xorps",XMMREG,XMMREG|MEM,_R,"\x2\x0F\x57",
 "",0,0,0,0
 };
+
+const short instIndex[]={
+0,1,2,4,6,20,34,35,49,50,52,54,56,57,61,65,
+69,73,76,77,78,79,80,81,82,83,84,85,87,101,102,103,
+104,107,110,111,112,113,114,115,116,117,118,123,126,127,128,129,
+130,131,135,137,138,139,140,142,144,146,148,150,152,154,156,159,
+162,163,165,167,168,169,170,171,172,173,177,181,183,185,186,188,
+190,192,194,196,198,200,202,204,205,206,207,209,211,213,214,215,
+216,217,218,219,220,221,222,226,228,229,230,231,232,233,234,235,
+236,237,238,239,240,241,242,244,246,247,248,249,250,252,254,258,
+262,264,266,267,269,271,272,274,276,277,281,282,283,284,285,287,
+290,299,302,307,308,309,310,311,312,313,314,315,316,317,318,319,
+320,321,324,325,327,329,331,333,335,337,339,340,341,342,343,344,
+345,346,347,348,349,351,352,364,366,367,368,369,371,374,377,380,
+381,384,387,388,402,405,406,407,408,412,413,414,415,416,417,418,
+425,426,427,428,429,430,431,437,443,444,445,446,448,450,452,458,
+464,465,466,472,478,479,493,494,495,496,497,498,499,505,511,512,
+513,514,515,516,517,518,519,520,534,535,544,545,551,552,553,554,
+555,556,559,561,571,572,586,
+};
+
+const int instHashBuckets=132,instHashSlots=328;
+
+const unsigned short instHashDisp[]={
+5,1,2,2,2,1,5,4,2,2,1,7,1,1,4,2,
+2,3,27,0,3,7,2,0,0,2,16,4,8,1,7,0,
+1,1,2,5,1,1,0,1,4,0,1,5,3,3,3,5,
+2,27,2,1,1,1,7,0,1,1,0,1,1,3,13,8,
+1,3,1,0,0,10,4,2,2,10,0,3,1,1,5,6,
+15,6,2,2,3,1,1,1,4,1,6,9,0,4,5,9,
+4,1,2,2,12,6,5,4,1,3,1,5,5,2,1,4,
+9,2,1,10,2,1,3,2,10,12,1,4,8,8,0,17,
+1,2,1,0,
+};
+
+const short instHashTable[]={
+-1,-1,-1,172,214,169,42,55,41,220,-1,3,148,47,-1,14,
+-1,8,-1,170,216,167,210,87,98,146,44,188,199,162,23,99,
+-1,25,40,168,173,79,233,45,91,-1,123,-1,254,203,28,32,
+59,145,-1,-1,67,237,137,-1,36,228,-1,101,-1,77,43,24,
+51,136,-1,49,-1,66,18,-1,215,127,9,223,163,-1,134,81,
+46,12,-1,117,142,71,7,89,-1,60,29,39,-1,212,83,147,
+200,183,175,184,5,151,177,62,90,204,246,176,211,34,118,72,
+96,-1,171,50,191,160,232,252,-1,259,156,-1,13,-1,182,38,
+84,104,189,-1,102,178,257,58,110,-1,166,161,230,-1,-1,251,
+258,88,73,221,112,157,30,158,115,82,253,126,207,165,108,250,
+152,198,122,245,63,241,-1,144,76,242,86,208,143,-1,105,-1,
+164,57,159,53,260,180,-1,109,20,-1,202,65,27,-1,124,139,
+181,196,179,-1,217,262,-1,74,195,-1,248,16,193,227,-1,226,
+135,93,-1,92,219,111,213,54,129,64,22,37,229,114,106,35,
+-1,187,-1,185,255,130,138,26,243,128,155,103,-1,0,-1,154,
+-1,15,-1,19,70,206,48,133,256,94,68,125,120,11,21,-1,
+-1,17,201,174,205,80,-1,-1,132,4,235,119,-1,247,238,-1,
+69,6,150,78,225,113,97,-1,240,149,249,2,236,10,-1,-1,
+95,192,56,-1,1,186,190,261,31,75,-1,85,234,-1,194,140,
+197,107,-1,33,244,222,100,153,-1,116,61,231,218,-1,-1,239,
+141,-1,224,-1,52,121,131,209,
+};
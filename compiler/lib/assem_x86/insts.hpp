@@ -9,6 +9,7 @@ enum{
 	AL=0x10000,AX=0x20000,EAX=0x40000,
 	CL=0x80000,CX=0x100000,ECX=0x200000,
 	ST0=0x400000,FPUREG=0x800000,
+	XMMREG=0x1000000,
 
 	NONE=0x80000000
 };
@@ -30,3 +31,20 @@ struct Inst{
 };
 
 extern Inst insts[];
+
+//first insts[] entry for each OP_ id (see opcodes.hpp)
+extern const short instIndex[];
+
+//perfect hash from mnemonic to OP_ id, built by compiler/gen
+extern const int            instHashBuckets, instHashSlots;
+extern const unsigned short instHashDisp[];
+extern const short          instHashTable[];
+
+//must match instHash() in compiler/gen/main.cpp
+inline unsigned instHash(const char* p, int n, unsigned seed)
+{
+	unsigned h = 2166136261u ^ (seed * 0x9e3779b9u);
+	while (n--)
+		h = (h ^ (unsigned char)*p++) * 16777619u;
+	return h ^ (h >> 15);
+}
@@ -0,0 +1,272 @@
+//
+//This is generated code - do not modify!!!!!
+//
+
+#pragma once
+
+enum{
+	OP_AAA,
+	OP_AAS,
+	OP_AAD,
+	OP_AAM,
+	OP_ADC,
+	OP_ADD,
+	OP_ADDSS,
+	OP_AND,
+	OP_ARPL,
+	OP_BOUND,
+	OP_BSF,
+	OP_BSR,
+	OP_BSWAP,
+	OP_BT,
+	OP_BTC,
+	OP_BTR,
+	OP_BTS,
+	OP_CALL,
+	OP_CBW,
+	OP_CWD,
+	OP_CDQ,
+	OP_CWDE,
+	OP_CLC,
+	OP_CLD,
+	OP_CLI,
+	OP_CLTS,
+	OP_CMC,
+	OP_CMOVCC,
+	OP_CMP,
+	OP_CMPSB,
+	OP_CMPSW,
+	OP_CMPSD,
+	OP_CMPXCHG,
+	OP_CMPXCHG486,
+	OP_CMPXCHG8B,
+	OP_COMISS,
+	OP_CPUID,
+	OP_CVTSI2SS,
+	OP_CVTSS2SI,
+	OP_CVTTSS2SI,
+	OP_DAA,
+	OP_DAS,
+	OP_DEC,
+	OP_DIV,
+	OP_DIVSS,
+	OP_EMMS,
+	OP_ENTER,
+	OP_F2XM1,
+	OP_FABS,
+	OP_FADD,
+	OP_FADDP,
+	OP_FCHS,
+	OP_FCLEX,
+	OP_FNCLEX,
+	OP_FCMOVB,
+	OP_FCMOVBE,
+	OP_FCMOVE,
+	OP_FCMOVNB,
+	OP_FCMOVNBE,
+	OP_FCMOVNE,
+	OP_FCMOVNU,
+	OP_FCMOVU,
+	OP_FCOM,
+	OP_FCOMP,
+	OP_FCOMPP,
+	OP_FCOMI,
+	OP_FCOMIP,
+	OP_FCOS,
+	OP_FDECSTP,
+	OP_FDISI,
+	OP_FNDISI,
+	OP_FENI,
+	OP_FNENI,
+	OP_FDIV,
+	OP_FDIVR,
+	OP_FDIVP,
+	OP_FDIVRP,
+	OP_FFREE,
+	OP_FIADD,
+	OP_FICOM,
+	OP_FICOMP,
+	OP_FIDIV,
+	OP_FIDIVR,
+	OP_FILD,
+	OP_FIST,
+	OP_FISTP,
+	OP_FIMUL,
+	OP_FINCSTP,
+	OP_FINIT,
+	OP_FNINIT,
+	OP_FISUB,
+	OP_FISUBR,
+	OP_FLD,
+	OP_FLD1,
+	OP_FLDL2E,
+	OP_FLDL2T,
+	OP_FLDLG2,
+	OP_FLDLN2,
+	OP_FLDPI,
+	OP_FLDZ,
+	OP_FLDCW,
+	OP_FLDENV,
+	OP_FMUL,
+	OP_FMULP,
+	OP_FNOP,
+	OP_FPATAN,
+	OP_FPTAN,
+	OP_FPREM,
+	OP_FPREM1,
+	OP_FRNDINT,
+	OP_FSAVE,
+	OP_FNSAVE,
+	OP_FRSTOR,
+	OP_FSCALE,
+	OP_FSETPM,
+	OP_FSIN,
+	OP_FSINCOS,
+	OP_FSQRT,
+	OP_FST,
+	OP_FSTP,
+	OP_FSTCW,
+	OP_FNSTCW,
+	OP_FSTENV,
+	OP_FNSTENV,
+	OP_FSTSW,
+	OP_FNSTSW,
+	OP_FSUB,
+	OP_FSUBR,
+	OP_FSUBP,
+	OP_FSUBRP,
+	OP_FTST,
+	OP_FUCOM,
+	OP_FUCOMP,
+	OP_FUCOMPP,
+	OP_FUCOMI,
+	OP_FUCOMIP,
+	OP_FXAM,
+	OP_FXCH,
+	OP_FXTRACT,
+	OP_FYL2X,
+	OP_FYL2XP1,
+	OP_HLT,
+	OP_IBTS,
+	OP_IDIV,
+	OP_IMUL,
+	OP_IN,
+	OP_INC,
+	OP_INSB,
+	OP_INSW,
+	OP_INSD,
+	OP_INT,
+	OP_INT1,
+	OP_ICEBP,
+	OP_INT01,
+	OP_INT3,
+	OP_INTO,
+	OP_INVD,
+	OP_INVLPG,
+	OP_IRET,
+	OP_IRETW,
+	OP_IRETD,
+	OP_JMP,
+	OP_LAHF,
+	OP_LAR,
+	OP_LDS,
+	OP_LES,
+	OP_LFS,
+	OP_LGS,
+	OP_LSS,
+	OP_LEA,
+	OP_LEAVE,
+	OP_LGDT,
+	OP_LIDT,
+	OP_LLDT,
+	OP_LMSW,
+	OP_LOADALL,
+	OP_LOADALL286,
+	OP_LODSB,
+	OP_LODSW,
+	OP_LODSD,
+	OP_LSL,
+	OP_LTR,
+	OP_MOV,
+	OP_MOVD,
+	OP_MOVSB,
+	OP_MOVSW,
+	OP_MOVSD,
+	OP_MOVSS,
+	OP_MOVSX,
+	OP_MOVZX,
+	OP_MUL,
+	OP_MULSS,
+	OP_NEG,
+	OP_NOT,
+	OP_NOP,
+	OP_OR,
+	OP_OUT,
+	OP_OUTSB,
+	OP_OUTSW,
+	OP_OUTSD,
+	OP_POP,
+	OP_POPA,
+	OP_POPAW,
+	OP_POPAD,
+	OP_POPF,
+	OP_POPFW,
+	OP_POPFD,
+	OP_PUSH,
+	OP_PUSHA,
+	OP_PUSHAD,
+	OP_PUSHAW,
+	OP_PUSHF,
+	OP_PUSHFD,
+	OP_PUSHFW,
+	OP_RCL,
+	OP_RCR,
+	OP_RDMSR,
+	OP_RDPMC,
+	OP_RDTSC,
+	OP_RET,
+	OP_RETF,
+	OP_RETN,
+	OP_ROL,
+	OP_ROR,
+	OP_RSM,
+	OP_SAHF,
+	OP_SAL,
+	OP_SAR,
+	OP_SALC,
+	OP_SBB,
+	OP_SCASB,
+	OP_SCASW,
+	OP_SCASD,
+	OP_SGDT,
+	OP_SIDT,
+	OP_SLDT,
+	OP_SHL,
+	OP_SHR,
+	OP_SMI,
+	OP_SMSW,
+	OP_STC,
+	OP_STD,
+	OP_STI,
+	OP_STOSB,
+	OP_STOSW,
+	OP_STOSD,
+	OP_STR,
+	OP_SUB,
+	OP_SUBSS,
+	OP_TEST,
+	OP_UCOMISS,
+	OP_UMOV,
+	OP_VERR,
+	OP_VERW,
+	OP_WAIT,
+	OP_WBINVD,
+	OP_WRMSR,
+	OP_XADD,
+	OP_XBTS,
+	OP_XCHG,
+	OP_XLATB,
+	OP_XOR,
+	OP_XORPS,
+	OP_COUNT
+};
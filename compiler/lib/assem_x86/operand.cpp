@@ -1,6 +1,8 @@
 #include "operand.hpp"
 #include "../ex.hpp"
 #include "insts.hpp"
+#include <cstdio>
+#include <cstring>
 
 static const char* regs[] = {"al", "cl", "dl", "bl", "ah",  "ch",  "dh",  "bh",  "ax",  "cx",  "dx",  "bx",
 							 "sp", "bp", "si", "di", "eax", "ecx", "edx", "ebx", "esp", "ebp", "esi", "edi"};
@@ -15,25 +17,176 @@ static void sizeError()
 	throw BlitzException("illegal operand size");
 }
 
-Operand::Operand() : mode(NONE), reg(-1), imm(0), offset(0), baseReg(-1), indexReg(-1), shift(0) {}
+Operand::Operand() : mode(NONE), reg(-1), imm(0), offset(0), baseReg(-1), indexReg(-1), shift(0), p(0), end(0) {}
 
-Operand::Operand(const std::string& s)
-	: mode(NONE), reg(-1), imm(0), offset(0), baseReg(-1), indexReg(-1), shift(0), s(s)
+Operand::Operand(const char* begin, const char* end)
+	: mode(NONE), reg(-1), imm(0), offset(0), baseReg(-1), indexReg(-1), shift(0), p(begin), end(end)
 {}
 
+Operand Operand::reg32(int r)
+{
+	Operand o;
+	o.setReg(r + 16, 0);
+	return o;
+}
+
+Operand Operand::reg16(int r)
+{
+	Operand o;
+	o.setReg(r + 8, 0);
+	return o;
+}
+
+Operand Operand::reg8(int r)
+{
+	Operand o;
+	o.setReg(r, 0);
+	return o;
+}
+
+Operand Operand::xmm(int r)
+{
+	Operand o;
+	o.mode = XMMREG;
+	o.reg  = r;
+	return o;
+}
+
+Operand Operand::fpu(int r)
+{
+	Operand o;
+	o.mode = r ? FPUREG : FPUREG | ST0;
+	o.reg  = r;
+	return o;
+}
+
+Operand Operand::immediate(int n, int sz)
+{
+	Operand o;
+	o.imm  = n;
+	o.mode = IMM | (sz == 1 ? IMM8 : (sz == 2 ? IMM16 : IMM32));
+	return o;
+}
+
+Operand Operand::label(const std::string& l)
+{
+	Operand o;
+	o.immLabel = l;
+	o.mode     = IMM | IMM32;
+	return o;
+}
+
+Operand Operand::memory(int base, int offset, const std::string& l, int index, int shift)
+{
+	Operand o;
+	o.mode      = MEM | R_M | MEM32 | R_M32;
+	o.baseReg   = base;
+	o.offset    = offset;
+	o.baseLabel = l;
+	o.indexReg  = index;
+	o.shift     = shift;
+	return o;
+}
+
+bool Operand::isReg() const
+{
+	return (mode & REG) != 0;
+}
+
+bool Operand::isMem() const
+{
+	return (mode & MEM) != 0;
+}
+
+bool Operand::uses(int r) const
+{
+	if (mode & REG)
+		return (mode & REG8 ? reg & 3 : reg) == r; //ah is the top of eax
+	return (mode & MEM) && (baseReg == r || indexReg == r);
+}
+
+bool Operand::operator==(const Operand& o) const
+{
+	return mode == o.mode && reg == o.reg && imm == o.imm && offset == o.offset && immLabel == o.immLabel &&
+		   baseLabel == o.baseLabel && baseReg == o.baseReg && indexReg == o.indexReg && shift == o.shift;
+}
+
+static std::string itos(int n)
+{
+	char buff[16];
+	snprintf(buff, sizeof(buff), "%d", n);
+	return buff;
+}
+
+std::string Operand::str() const
+{
+	if (mode & REG)
+		return regs[(mode & REG8 ? 0 : (mode & REG16 ? 8 : 16)) + reg];
+	if (mode & XMMREG)
+		return "xmm" + itos(reg);
+	if (mode & FPUREG)
+		return "st(" + itos(reg) + ")";
+	if (mode & IMM) {
+		std::string t = mode & IMM8 ? "byte " : (mode & IMM16 ? "word " : "");
+		return t + (immLabel.size() ? immLabel : itos(imm));
+	}
+	if (!(mode & MEM))
+		return "";
+
+	std::string t = baseLabel;
+	if (baseReg >= 0)
+		t += (t.size() ? "+" : "") + std::string(regs[16 + baseReg]);
+	if (indexReg >= 0)
+		t += (t.size() ? "+" : "") + std::string(regs[16 + indexReg]) + '*' + itos(1 << shift);
+	if (offset || !t.size())
+		t += (offset >= 0 && t.size() ? "+" : "") + itos(offset);
+	return (mode & MEM8 ? "byte [" : (mode & MEM16 ? "word [" : "[")) + t + ']';
+}
+
+void Operand::setReg(int r, int sz)
+{
+	mode = REG | R_M;
+	if (r < 8) {
+		if (sz && sz != 1)
+			sizeError();
+		mode |= REG8 | R_M8;
+		if (r == 0)
+			mode |= AL;
+		else if (r == 1)
+			mode |= CL;
+	} else if (r < 16) {
+		if (sz && sz != 2)
+			sizeError();
+		mode |= REG16 | R_M16;
+		if (r == 8)
+			mode |= AX;
+		else if (r == 9)
+			mode |= CX;
+	} else {
+		if (sz && sz != 4)
+			sizeError();
+		mode |= REG32 | R_M32;
+		if (r == 16)
+			mode |= EAX;
+		else if (r == 17)
+			mode |= ECX;
+	}
+	reg = r & 7;
+}
+
 bool Operand::parseSize(int* sz)
 {
-	if (!s.size())
+	if (p == end)
 		return false;
-	if (s.find("byte ") == 0) {
+	if (end - p > 5 && !strncmp(p, "byte ", 5)) {
 		*sz = 1;
-		s   = s.substr(5);
-	} else if (s.find("word ") == 0) {
+		p += 5;
+	} else if (end - p > 5 && !strncmp(p, "word ", 5)) {
 		*sz = 2;
-		s   = s.substr(5);
-	} else if (s.find("dword ") == 0) {
+		p += 5;
+	} else if (end - p > 6 && !strncmp(p, "dword ", 6)) {
 		*sz = 4;
-		s   = s.substr(6);
+		p += 6;
 	} else
 		return false;
 
@@ -42,24 +195,23 @@ bool Operand::parseSize(int* sz)
 
 bool Operand::parseChar(char c)
 {
-	if (!s.size() || s[0] != c)
+	if (p == end || *p != c)
 		return false;
-	s = s.substr(1);
+	++p;
 	return true;
 }
 
 bool Operand::parseReg(int* reg)
 {
 	int i;
-	for (i = 0; i < s.size() && isalpha(s[i]); ++i) {
+	for (i = 0; p + i != end && isalpha(p[i]); ++i) {
 	}
-	if (!i)
+	if (i != 2 && i != 3)
 		return false;
-	std::string t = s.substr(0, i);
 	for (int j = 0; j < 24; ++j) {
-		if (t == regs[j]) {
+		if (!strncmp(p, regs[j], i) && !regs[j][i]) {
 			*reg = j;
-			s    = s.substr(i);
+			p += i;
 			return true;
 		}
 	}
@@ -69,86 +221,81 @@ bool Operand::parseReg(int* reg)
 bool Operand::parseFPReg(int* reg)
 {
 	//eg: st(0)
-	if (s.size() < 5)
+	if (end - p < 5)
+		return false;
+	if (p[0] != 's' || p[1] != 't' || p[2] != '(' || p[4] != ')')
+		return false;
+	if (p[3] < '0' || p[3] > '7')
+		return false;
+	*reg = p[3] - '0';
+	p += 5;
+	return true;
+}
+
+bool Operand::parseXMMReg(int* reg)
+{
+	//eg: xmm0
+	if (end - p < 4 || (end - p > 4 && isalnum(p[4])))
 		return false;
-	if (s[0] != 's' || s[1] != 't' || s[2] != '(' || s[4] != ')')
+	if (p[0] != 'x' || p[1] != 'm' || p[2] != 'm')
 		return false;
-	if (s[3] < '0' || s[3] > '7')
+	if (p[3] < '0' || p[3] > '7')
 		return false;
-	*reg = s[3] - '0';
-	s    = s.substr(5);
+	*reg = p[3] - '0';
+	p += 4;
 	return true;
 }
 
 bool Operand::parseLabel(std::string* label)
 {
-	if (!s.size() || (!isalpha(s[0]) && s[0] != '_'))
+	if (p == end || (!isalpha(*p) && *p != '_'))
 		return false;
 	int i;
-	for (i = 1; i < s.size() && (isalnum(s[i]) || s[i] == '_'); ++i) {
+	for (i = 1; p + i != end && (isalnum(p[i]) || p[i] == '_'); ++i) {
 	}
-	*label = s.substr(0, i);
-	s      = s.substr(i);
+	label->assign(p, i);
+	p += i;
 	return true;
 }
 
 bool Operand::parseConst(int* iconst)
 {
-	int i, sgn = s.size() && (s[0] == '-' || s[0] == '+');
-	for (i = sgn; i < s.size() && isdigit(s[i]); ++i) {
+	int i, sgn = p != end && (*p == '-' || *p == '+');
+	for (i = sgn; p + i != end && isdigit(p[i]); ++i) {
 	}
 	if (i == sgn)
 		return false;
-	int n   = atoi(s.c_str());
-	*iconst = n;
-	s       = s.substr(i);
+	unsigned n = 0;
+	for (int k = sgn; k < i; ++k)
+		n = n * 10 + (p[k] - '0');
+	*iconst = *p == '-' ? int(0u - n) : int(n);
+	p += i;
 	return true;
 }
 
 void Operand::parse()
 {
-	if (!s.size())
+	if (p == end)
 		return;
 
 	int sz;
 	if (!parseSize(&sz))
 		sz = 0;
 
-	if (s[0] != '[') {
+	if (*p != '[') {
 		int r;
 		if (parseReg(&r)) {
-			mode = REG | R_M;
-			if (r < 8) {
-				if (sz && sz != 1)
-					sizeError();
-				mode |= REG8 | R_M8;
-				if (r == 0)
-					mode |= AL;
-				else if (r == 1)
-					mode |= CL;
-			} else if (r < 16) {
-				if (sz && sz != 2)
-					sizeError();
-				mode |= REG16 | R_M16;
-				if (r == 8)
-					mode |= AX;
-				else if (r == 9)
-					mode |= CX;
-			} else {
-				if (sz && sz != 4)
-					sizeError();
-				mode |= REG32 | R_M32;
-				if (r == 16)
-					mode |= EAX;
-				else if (r == 17)
-					mode |= ECX;
-			}
-			reg = r & 7;
+			setReg(r, sz);
 		} else if (parseFPReg(&r)) {
 			mode = FPUREG;
 			if (!r)
 				mode |= ST0;
 			reg = r;
+		} else if (parseXMMReg(&r)) {
+			if (sz)
+				sizeError();
+			mode = XMMREG;
+			reg  = r;
 		} else if (parseLabel(&immLabel)) {
 			if (sz && sz != 4)
 				sizeError();
@@ -163,14 +310,15 @@ void Operand::parse()
 				mode |= IMM32;
 		} else
 			opError();
-		if (s.size())
+		if (p != end)
 			opError();
 		return;
 	}
 
-	if (s[s.size() - 1] != ']')
+	if (end[-1] != ']')
 		opError();
-	s = s.substr(1, s.size() - 2);
+	++p;
+	--end;
 
 	mode = MEM | R_M;
 	if (sz == 1)
@@ -219,8 +367,9 @@ void Operand::parse()
 			offset += n;
 		} else
 			break;
-		if (!s.size())
+		if (p == end)
 			return;
+		parseChar('+'); //eg: [label+eax*4]
 	}
 	opError();
 }
@@ -9,16 +9,40 @@ struct Operand {
 	int         baseReg, indexReg, shift;
 
 	Operand();
-	Operand(const std::string& s);
+	//text to parse() - it isn't copied, so it must outlive the parse() call
+	Operand(const char* begin, const char* end);
 
 	void parse();
 
+	//ready parsed operands, for the direct encoder.
+	//registers are 0-7 in encoding order - eax,ecx,edx,ebx,esp,ebp,esi,edi.
+	static Operand reg32(int r);
+	static Operand reg16(int r);
+	static Operand reg8(int r);
+	static Operand xmm(int r);
+	static Operand fpu(int r);
+	static Operand immediate(int n, int sz = 4);
+	static Operand label(const std::string& l);
+	static Operand memory(int base, int offset, const std::string& l = "", int index = -1, int shift = 0);
+
+	bool isReg() const;
+	bool isMem() const;
+	bool uses(int r) const; //names 32 bit reg r, or part of it, or addresses with it
+
+	bool operator==(const Operand& o) const;
+	bool operator!=(const Operand& o) const { return !(*this == o); }
+
+	//as parse() would take it, eg: "[ebp-4]"
+	std::string str() const;
+
 	private:
-	std::string s;
+	const char *p, *end;
+	void        setReg(int r, int sz);
 	bool        parseSize(int* sz);
 	bool        parseChar(char c);
 	bool        parseReg(int* reg);
 	bool        parseFPReg(int* reg);
+	bool        parseXMMReg(int* reg);
 	bool        parseLabel(std::string* t);
 	bool        parseConst(int* iconst);
 };
@@ -0,0 +1,355 @@
+#include "codecache.hpp"
+#include <fstream>
+#include <iterator>
+#include "decl.hpp"
+#include "environ.hpp"
+#include "label.hpp"
+#include "type.hpp"
+
+#include <config.hpp>
+#include <stdutil.hpp>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#endif
+
+static const int CACHE_MAGIC = 0x34434242; //'BBC4' - bump when the format changes
+
+CodeInst CodeInst::at(const std::string& label)
+{
+	CodeInst i;
+	i.kind  = LABEL;
+	i.label = label;
+	return i;
+}
+
+CodeInst CodeInst::esp(int n)
+{
+	CodeInst i;
+	i.kind = ESP;
+	i.l    = Operand::immediate(n);
+	return i;
+}
+
+static uint64_t hash(const char* p, int sz, uint64_t h = 14695981039346656037ull)
+{
+	while (sz--)
+		h = (h ^ (unsigned char)*p++) * 1099511628211ull;
+	return h;
+}
+
+static uint64_t hash(const std::string& t, uint64_t h = 14695981039346656037ull)
+{
+	return hash(t.data(), t.size(), h);
+}
+
+/////////////////////////////////////////////////////////
+// Digest of everything a function's code can refer to //
+// outside of its own body.                            //
+/////////////////////////////////////////////////////////
+static std::string typeDigest(Type* t)
+{
+	if (t == Type::int_type)
+		return "%";
+	if (t == Type::float_type)
+		return "#";
+	if (t == Type::string_type)
+		return "$";
+	if (t == Type::void_type)
+		return "*";
+	if (t == Type::null_type)
+		return "0";
+	if (StructType* s = t->structType())
+		return "." + s->ident;
+	if (ConstType* c = t->constType()) {
+		if (c->valueType == Type::int_type)
+			return "=%" + itoa(c->intValue);
+		if (c->valueType == Type::float_type)
+			return "=#" + itoa(*(int*)&c->floatValue);
+		return "=$" + c->stringValue;
+	}
+	if (ArrayType* a = t->arrayType())
+		return "()" + itoa(a->size) + typeDigest(a->type);
+	if (VectorType* v = t->vectorType()) {
+		//not the label - it's numbered in whatever scope declared it.
+		std::string d = "[]";
+		for (int k = 0; k < v->sizes.size(); ++k)
+			d += itoa(v->sizes[k]) + ",";
+		return d + typeDigest(v->elementType);
+	}
+	if (FuncType* f = t->funcType()) {
+		std::string d = f->cfunc ? "c(" : (f->userlib ? "u(" : "(");
+		for (int k = 0; k < f->params->size(); ++k) {
+			Decl* p = f->params->decls[k];
+			d += typeDigest(p->type);
+			if (p->defType)
+				d += typeDigest(p->defType);
+			d += ",";
+		}
+		return d + ")" + typeDigest(f->returnType);
+	}
+	return "?";
+}
+
+static uint64_t declsDigest(DeclSeq* decls, uint64_t h)
+{
+	for (int k = 0; k < decls->size(); ++k) {
+		Decl* d = decls->decls[k];
+		if (d->kind & (DECL_LOCAL | DECL_PARAM))
+			continue;
+		h = hash(d->name + ':' + itoa(d->kind) + typeDigest(d->type) + ';', h);
+		if (StructType* s = d->type->structType()) {
+			if (d->kind == DECL_STRUCT && s->fields)
+				h = declsDigest(s->fields, h);
+		}
+	}
+	return h;
+}
+
+static uint64_t envDigest(Environ* e, uint64_t h)
+{
+	h = declsDigest(e->decls, h);
+	h = declsDigest(e->typeDecls, h);
+	h = declsDigest(e->funcDecls, h);
+
+	//Restore can reach main program labels from inside a function
+	for (int k = 0; k < e->labels.size(); ++k)
+		h = hash(e->labels[k]->name + ':' + itoa(e->labels[k]->data_sz) + ';', h);
+	return h;
+}
+
+/////////////////////
+// The code cache! //
+/////////////////////
+CodeCache::CodeCache(const std::string& d, Environ* prog, Environ* runtime, const std::string& options)
+	: hits(0), misses(0), dir(d)
+{
+	digest = hash(itoa(VERSION) + options);
+	if (runtime)
+		digest = envDigest(runtime, digest);
+	if (prog)
+		digest = envDigest(prog, digest);
+}
+
+CodeCache::~CodeCache() {}
+
+void CodeCache::depend(const std::string& file)
+{
+	std::ifstream in(file.c_str(), std::ios_base::binary);
+	std::string   text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	digest = hash(file + ':' + text, digest);
+}
+
+std::string CodeCache::cacheFile(const std::string& file)
+{
+	char buff[32];
+	sprintf(buff, "%016llx", (unsigned long long)hash(tolower(file)));
+	return dir + "/" + buff + ".bbc";
+}
+
+static int readInt(std::istream& in)
+{
+	int n = 0;
+	in.read((char*)&n, 4);
+	return n;
+}
+
+static std::string readString(std::istream& in)
+{
+	int sz = readInt(in);
+	if (sz < 0 || sz > 0x1000000 || !in)
+		return std::string();
+	std::string t(sz, 0);
+	in.read(&t[0], sz);
+	return t;
+}
+
+static void writeInt(std::ostream& out, int n)
+{
+	out.write((char*)&n, 4);
+}
+
+static void writeString(std::ostream& out, const std::string& t)
+{
+	writeInt(out, t.size());
+	out.write(t.data(), t.size());
+}
+
+static Operand readOperand(std::istream& in)
+{
+	Operand o;
+	o.mode      = readInt(in);
+	o.reg       = readInt(in);
+	o.imm       = readInt(in);
+	o.offset    = readInt(in);
+	o.immLabel  = readString(in);
+	o.baseLabel = readString(in);
+	o.baseReg   = readInt(in);
+	o.indexReg  = readInt(in);
+	o.shift     = readInt(in);
+	return o;
+}
+
+static void writeOperand(std::ostream& out, const Operand& o)
+{
+	writeInt(out, o.mode);
+	writeInt(out, o.reg);
+	writeInt(out, o.imm);
+	writeInt(out, o.offset);
+	writeString(out, o.immLabel);
+	writeString(out, o.baseLabel);
+	writeInt(out, o.baseReg);
+	writeInt(out, o.indexReg);
+	writeInt(out, o.shift);
+}
+
+static CodeInst readInst(std::istream& in)
+{
+	CodeInst i;
+	i.kind  = readInt(in);
+	i.op    = readInt(in);
+	i.cc    = readInt(in);
+	i.l     = readOperand(in);
+	i.r     = readOperand(in);
+	i.label = readString(in);
+	return i;
+}
+
+static void writeInst(std::ostream& out, const CodeInst& i)
+{
+	writeInt(out, i.kind);
+	writeInt(out, i.op);
+	writeInt(out, i.cc);
+	writeOperand(out, i.l);
+	writeOperand(out, i.r);
+	writeString(out, i.label);
+}
+
+CodeCache::File& CodeCache::getFile(const std::string& file)
+{
+	std::map<std::string, File>::iterator it = files.find(file);
+	if (it != files.end())
+		return it->second;
+
+	File& f  = files[file];
+	f.dirty  = false;
+	f.usable = false;
+
+	//hash the source as it is now - if we can't, don't cache it at all
+	std::ifstream src(file.c_str(), std::ios_base::binary);
+	if (!src)
+		return f;
+	f.usable = true;
+	std::string text((std::istreambuf_iterator<char>(src)), std::istreambuf_iterator<char>());
+	f.hash = hash(text);
+
+	//and see what we had last time
+	std::ifstream in(cacheFile(file).c_str(), std::ios_base::binary);
+	if (!in)
+		return f;
+
+	uint64_t hash, dig;
+	if (readInt(in) != CACHE_MAGIC)
+		return f;
+	in.read((char*)&hash, 8);
+	in.read((char*)&dig, 8);
+	if (!in || hash != f.hash || dig != digest)
+		return f;
+
+	int n = readInt(in);
+	for (int k = 0; k < n && in; ++k) {
+		std::string ident = readString(in);
+		CodeFunc&   fn    = f.funcs[ident];
+		fn.label          = readString(in);
+		fn.frameSize      = readInt(in);
+		fn.popSize        = readInt(in);
+		fn.saved          = readInt(in);
+		int cnt           = readInt(in);
+		for (int j = 0; j < cnt && in; ++j)
+			fn.code.push_back(readInst(in));
+		cnt = readInt(in);
+		for (int j = 0; j < cnt && in; ++j) {
+			int kind = readInt(in), i = readInt(in);
+			fn.data.push_back(CodeData(kind, i, readString(in)));
+		}
+		cnt = readInt(in);
+		for (int j = 0; j < cnt && in; ++j)
+			fn.usedfuncs.push_back(readString(in));
+	}
+	if (!in)
+		f.funcs.clear();
+	return f;
+}
+
+const CodeFunc* CodeCache::find(const std::string& file, const std::string& func)
+{
+	File& f = getFile(file);
+	if (!f.usable)
+		return 0;
+	std::map<std::string, CodeFunc>::iterator it = f.funcs.find(func);
+	if (it == f.funcs.end()) {
+		++misses;
+		return 0;
+	}
+	++hits;
+	return &it->second;
+}
+
+void CodeCache::insert(const std::string& file, const std::string& func, const CodeFunc& fn)
+{
+	File& f = getFile(file);
+	if (!f.usable)
+		return;
+	f.funcs[func] = fn;
+	f.dirty       = true;
+}
+
+void CodeCache::flush()
+{
+#ifdef _WIN32
+	CreateDirectory(dir.c_str(), 0);
+#else
+	mkdir(dir.c_str(), 0777);
+#endif
+
+	std::map<std::string, File>::iterator it;
+	for (it = files.begin(); it != files.end(); ++it) {
+		File& f = it->second;
+		if (!f.dirty)
+			continue;
+
+		std::ofstream out(cacheFile(it->first).c_str(), std::ios_base::binary);
+		if (!out)
+			continue;
+
+		writeInt(out, CACHE_MAGIC);
+		out.write((char*)&f.hash, 8);
+		out.write((char*)&digest, 8);
+		writeInt(out, f.funcs.size());
+
+		std::map<std::string, CodeFunc>::iterator fit;
+		for (fit = f.funcs.begin(); fit != f.funcs.end(); ++fit) {
+			const CodeFunc& fn = fit->second;
+			writeString(out, fit->first);
+			writeString(out, fn.label);
+			writeInt(out, fn.frameSize);
+			writeInt(out, fn.popSize);
+			writeInt(out, fn.saved);
+			writeInt(out, fn.code.size());
+			for (int k = 0; k < fn.code.size(); ++k)
+				writeInst(out, fn.code[k]);
+			writeInt(out, fn.data.size());
+			for (int k = 0; k < fn.data.size(); ++k) {
+				writeInt(out, fn.data[k].kind);
+				writeInt(out, fn.data[k].i);
+				writeString(out, fn.data[k].s);
+			}
+			writeInt(out, fn.usedfuncs.size());
+			for (int k = 0; k < fn.usedfuncs.size(); ++k)
+				writeString(out, fn.usedfuncs[k]);
+		}
+		f.dirty = false;
+	}
+}
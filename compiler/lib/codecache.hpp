@@ -0,0 +1,92 @@
+/*
+
+  The code cache keeps the translated code of each function on disk, so functions in
+  files that haven't changed since the last build don't have to be translated again.
+
+  A file's entry is only used if the file's contents, the program's declarations, the
+  compiler version and options all match the build that wrote it.
+
+  Only code is cached - every file is still parsed and semanted on each build. Parsing
+  is cheap next to translation, and semant can't be done a file at a time: a Blitz
+  program's globals, types and functions are visible from every file, and its vars are
+  declared by first use, so what a file's AST means depends on the whole program. The
+  declarations digest is taken after semant for the same reason. Include text is kept
+  in memory between a compile server's builds instead, see includeText() in parser.cpp.
+
+*/
+
+#pragma once
+#include <cinttypes>
+#include <map>
+#include <string>
+#include <vector>
+#include "assem_x86/operand.hpp"
+
+class Environ;
+
+//a data fragment
+struct CodeData {
+	enum { LABEL, INT, STR, PTR, ALIGN };
+
+	int         kind, i;
+	std::string s;
+	CodeData(int kind, int i, const std::string& s) : kind(kind), i(i), s(s) {}
+};
+
+//an instruction, as Assem_x86::encode takes it - or a label, or an esp adjustment, which
+//are kept apart so the peephole pass and epilogue can see them
+struct CodeInst {
+	enum { INST, LABEL, ESP };
+
+	int         kind, op, cc; //cc is for OP_JCC and OP_SETCC
+	Operand     l, r;         //ESP: l.imm is added to esp
+	std::string label;
+
+	CodeInst(int op = 0, const Operand& l = Operand(), const Operand& r = Operand(), int cc = -1)
+		: kind(INST), op(op), cc(cc), l(l), r(r)
+	{}
+	static CodeInst at(const std::string& label);
+	static CodeInst esp(int n);
+};
+
+//the code of a single function
+struct CodeFunc {
+	std::string              label;
+	int                      frameSize, popSize;
+	int                      saved; //callee saved regs the prologue pushes
+	std::vector<CodeInst>    code;
+	std::vector<CodeData>    data;
+	std::vector<std::string> usedfuncs;
+};
+
+class CodeCache {
+	public:
+	//options are anything else that changes the code, eg: "-O"
+	CodeCache(const std::string& dir, Environ* prog, Environ* runtime, const std::string& options);
+	~CodeCache();
+
+	//code can depend on the contents of other files too, eg: functions inlined from them
+	void depend(const std::string& file);
+
+	const CodeFunc* find(const std::string& file, const std::string& func);
+	void            insert(const std::string& file, const std::string& func, const CodeFunc& f);
+
+	//write out any files that have changed
+	void flush();
+
+	int hits, misses;
+
+	private:
+	struct File {
+		uint64_t                        hash;
+		bool                            usable, dirty;
+		std::map<std::string, CodeFunc> funcs;
+	};
+
+	std::string                 dir;
+	uint64_t                    digest;
+	std::map<std::string, File> files;
+
+	File&       getFile(const std::string& file);
+	std::string cacheFile(const std::string& file);
+};
@@ -1,12 +1,14 @@
 #pragma once
 #include <string>
 #include <ostream>
+#include "counter.hpp"
 
 enum {
 	IR_JUMP,
 	IR_JUMPT,
 	IR_JUMPF,
 	IR_JUMPGE,
+	IR_JUMPTABLE, //jump through the table of labels at sconst, indexed by l
 
 	IR_SEQ,
 	IR_MOVE,
@@ -15,6 +17,8 @@ enum {
 	IR_GLOBAL,
 	IR_ARG,
 	IR_CONST,
+	IR_REG, //a local the codegen keeps in a register
+	IR_REGARG, //iconst'th register arg of a user function - a CALL arg's dest, or a param's source on entry
 
 	IR_JSR,
 	IR_RET,
@@ -25,7 +29,7 @@ enum {
 	IR_SHR,
 	IR_SAR,
 
-	IR_CALL,
+	IR_CALL, //iconst is the arg size - sconst is "C" if the caller pops them
 	IR_RETURN,
 	IR_CAST,
 	IR_NEG,
@@ -33,6 +37,7 @@ enum {
 	IR_SUB,
 	IR_MUL,
 	IR_DIV,
+	IR_MULHI, //high 32 bits of signed multiply
 	IR_SETEQ,
 	IR_SETNE,
 	IR_SETLT,
@@ -56,15 +61,23 @@ enum {
 	IR_FSETGE,
 };
 
+//user functions take their first REG_ARGS int, string and object args in registers
+const int REG_ARGS = 2;
+
+//iconst flags for what a 64 bit target can't tell from the op. Ints only live in the
+//low half of a register there, so addresses have to be told apart from them.
+const int IR_ADDR  = 1; //ADD, JUMPT or JUMPF whose l is an address
+const int IR_FLOAT = 1; //MOVE of a float arg, or of a float param on entry
+
 struct TNode {
 	int    op;     //opcode
 	TNode *l, *r;  //args
 	int    iconst; //for CONST type_int
 	std::string sconst; //for CONST type_string
 
-	TNode(int op, TNode* l = 0, TNode* r = 0) : op(op), l(l), r(r), iconst(0) {}
-	TNode(int op, TNode* l, TNode* r, int i) : op(op), l(l), r(r), iconst(i) {}
-	TNode(int op, TNode* l, TNode* r, const std::string& s) : op(op), l(l), r(r), iconst(0), sconst(s) {}
+	TNode(int op, TNode* l = 0, TNode* r = 0) : op(op), l(l), r(r), iconst(0) { ++created; }
+	TNode(int op, TNode* l, TNode* r, int i) : op(op), l(l), r(r), iconst(i) { ++created; }
+	TNode(int op, TNode* l, TNode* r, const std::string& s) : op(op), l(l), r(r), iconst(0), sconst(s) { ++created; }
 	~TNode()
 	{
 		delete l;
@@ -72,13 +85,28 @@ struct TNode {
 	}
 
 	void log();
+
+	static thread_local ThreadCount created; //for -stats
+
+	//TNodes are made and freed by the thread translating a function, so each thread has a pool of
+	//them. releasePool() gives the calling thread's back once translate is done - or returns false
+	//if some are still allocated. resetPool() frees them regardless, eg: after translate failed.
+	static void* operator new(size_t sz);
+	static void  operator delete(void* p);
+	static bool  releasePool();
+	static void  resetPool();
 };
 
+class CodeCache;
+struct CodeFunc;
+
 class Codegen {
 	public:
 	std::ostream& out;
 	bool     debug;
-	Codegen(std::ostream& out, bool debug) : out(out), debug(debug) {}
+	CodeCache* cache; //if set, functions are looked up here before translating
+	Codegen(std::ostream& out, bool debug) : out(out), debug(debug), cache(0) {}
+	virtual ~Codegen() {}
 
 	virtual void enter(const std::string& l, int frameSize)              = 0;
 	virtual void code(TNode* code)                             = 0;
@@ -87,6 +115,15 @@ class Codegen {
 	virtual void i_data(int i, const std::string& l = "")                = 0;
 	virtual void s_data(const std::string& s, const std::string& l = "") = 0;
 	virtual void p_data(const std::string& p, const std::string& l = "") = 0;
+	virtual void w_data(int i, const std::string& l = "") { i_data(i, l); } //pointer sized
 	virtual void align_data(int n)                             = 0;
 	virtual void flush()                                       = 0;
+
+	//code of the last function left, and re-emitting it later
+	virtual bool record(CodeFunc& f) { return false; }
+	virtual bool replay(const CodeFunc& f) { return false; }
+
+	//a codegen that can translate a function on another thread - its code is
+	//taken with record() and emitted here with replay().
+	virtual Codegen* fork() { return 0; }
 };
@@ -0,0 +1,854 @@
+#include "codegen_x64.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <stdutil.hpp>
+
+//temps by depth - the int ones are callee saved, so they live through calls
+static const std::string intTemps[] = {"rbx", "r12", "r13", "r14", "r15"};
+static const int         INT_TEMPS  = 5;
+static const int         FLT_TEMPS  = 8; //xmm8 up
+
+//SysV arg regs
+static const std::string intArgs[] = {"rdi", "rsi", "rdx", "rcx", "r8", "r9"};
+static const int         INT_ARGS  = 6;
+static const int         FLT_ARGS  = 8; //xmm0 up
+
+static std::string itoa_sgn(int n)
+{
+	return n ? (n > 0 ? "+" + itoa(n) : itoa(n)) : "";
+}
+
+//low 32 bits of a reg
+static std::string lo(const std::string& r)
+{
+	if (isdigit(r[1]))
+		return r + 'd';
+	return 'e' + r.substr(1);
+}
+
+static std::string xmm(int n)
+{
+	return "xmm" + itoa(n);
+}
+
+static bool isRelop(int op)
+{
+	return op == IR_SETEQ || op == IR_SETNE || op == IR_SETLT || op == IR_SETGT || op == IR_SETLE || op == IR_SETGE;
+}
+
+static bool isFPRelop(int op)
+{
+	return op == IR_FSETEQ || op == IR_FSETNE || op == IR_FSETLT || op == IR_FSETGT || op == IR_FSETLE ||
+		   op == IR_FSETGE;
+}
+
+//ops with a float result
+static bool isFPOp(int op)
+{
+	return op == IR_FCALL || op == IR_FCAST || op == IR_FNEG || op == IR_FADD || op == IR_FSUB || op == IR_FMUL ||
+		   op == IR_FDIV;
+}
+
+static std::string invert(const std::string& cc)
+{
+	static const char* ccs[][2] = {{"e", "ne"}, {"z", "nz"}, {"l", "ge"}, {"g", "le"}, {"b", "ae"}, {"a", "be"}};
+	for (int k = 0; k < 6; ++k) {
+		if (cc == ccs[k][0])
+			return ccs[k][1];
+		if (cc == ccs[k][1])
+			return ccs[k][0];
+	}
+	return cc;
+}
+
+static std::string quote(const std::string& s)
+{
+	std::string t = "\"";
+	for (int k = 0; k < s.size(); ++k) {
+		unsigned char c = s[k];
+		if (c == '\"' || c == '\\') {
+			t += '\\';
+			t += c;
+		} else if (c < 32 || c > 126) {
+			char buff[8];
+			sprintf(buff, "\\%03o", c);
+			t += buff;
+		} else {
+			t += c;
+		}
+	}
+	return t + '\"';
+}
+
+Codegen_x64::Codegen_x64(std::ostream& out, bool debug)
+	: Codegen(out, debug), inCode(false), frameSize(0), temps(0), saved(0), intParams(0), fltParams(0),
+	  stackParams(0), traps(0)
+{
+	out << "\t.intel_syntax\tnoprefix\n";
+	out << "\t.section\t.note.GNU-stack,\"\",@progbits\n"; //no executable stack
+}
+
+void Codegen_x64::enter(const std::string& l, int frameSize)
+{
+	inCode          = true;
+	funcLabel       = l;
+	this->frameSize = frameSize;
+	temps = saved = 0;
+	intParams = fltParams = stackParams = 0;
+	kinds.clear();
+	body.clear();
+}
+
+void Codegen_x64::code(TNode* stmt)
+{
+	gen(stmt);
+	delete stmt;
+}
+
+//////////////////////////////////////////////////////////////
+// Frame, down from rbp: locals, the return value while the //
+// cleanup runs, temps, and the callee saved regs.          //
+//////////////////////////////////////////////////////////////
+void Codegen_x64::leave(TNode* cleanup, int pop_sz)
+{
+	std::string ret_i = "[rbp" + itoa_sgn(-frameSize - 8) + "]";
+	std::string ret_f = "[rbp" + itoa_sgn(-frameSize - 16) + "]";
+	if (cleanup) {
+		emit("\tmov\tqword ptr " + ret_i + ",rax\n");
+		emit("\tmovss\tdword ptr " + ret_f + ",xmm0\n");
+		gen(cleanup);
+		emit("\tmov\trax,qword ptr " + ret_i + "\n");
+		emit("\tmovss\txmm0,dword ptr " + ret_f + "\n");
+	}
+
+	int n = 0;
+	for (int k = 0; k < INT_TEMPS; ++k) {
+		if (saved & (1 << k))
+			++n;
+	}
+	int save = frameSize + 16 + temps * 8;
+	int size = (save + n * 8 + 15) & ~15;
+
+	out << "\t.text\n";
+	out << "\t.p2align\t4\n";
+	if (funcLabel == "__MAIN")
+		out << "\t.globl\t__MAIN\n";
+	if (funcLabel.size())
+		out << funcLabel << ":\n";
+	out << "\tpush\trbp\n";
+	out << "\tmov\trbp,rsp\n";
+	out << "\tsub\trsp," << size << '\n';
+	for (int k = 0, j = 0; k < INT_TEMPS; ++k) {
+		if (saved & (1 << k))
+			out << "\tmov\tqword ptr [rbp" << itoa_sgn(-save - 8 * ++j) << "]," << intTemps[k] << '\n';
+	}
+	out << body;
+	for (int k = 0, j = 0; k < INT_TEMPS; ++k) {
+		if (saved & (1 << k))
+			out << "\tmov\t" << intTemps[k] << ",qword ptr [rbp" << itoa_sgn(-save - 8 * ++j) << "]\n";
+	}
+	out << "\tleave\n";
+	out << "\tret\n";
+
+	body.clear();
+	delete cleanup;
+	inCode = false;
+}
+
+void Codegen_x64::label(const std::string& l)
+{
+	if (inCode)
+		emit(l + ":\n");
+	else
+		dataFrags.push_back(l + ":\n");
+}
+
+void Codegen_x64::i_data(int i, const std::string& l)
+{
+	if (l.size())
+		dataFrags.push_back(l + ":\n");
+	dataFrags.push_back("\t.long\t" + itoa(i) + '\n');
+}
+
+void Codegen_x64::s_data(const std::string& s, const std::string& l)
+{
+	if (l.size())
+		dataFrags.push_back(l + ":\n");
+	dataFrags.push_back("\t.asciz\t" + quote(s) + '\n');
+}
+
+void Codegen_x64::p_data(const std::string& p, const std::string& l)
+{
+	if (l.size())
+		dataFrags.push_back(l + ":\n");
+	dataFrags.push_back("\t.quad\t" + p + '\n');
+}
+
+void Codegen_x64::w_data(int i, const std::string& l)
+{
+	if (l.size())
+		dataFrags.push_back(l + ":\n");
+	dataFrags.push_back("\t.quad\t" + itoa(i) + '\n');
+}
+
+void Codegen_x64::align_data(int n)
+{
+	dataFrags.push_back("\t.balign\t" + itoa(n) + '\n');
+}
+
+void Codegen_x64::flush()
+{
+	if (!dataFrags.size())
+		return;
+	out << "\t.data\n";
+	for (int k = 0; k < dataFrags.size(); ++k)
+		out << dataFrags[k];
+	dataFrags.clear();
+}
+
+void Codegen_x64::emit(const std::string& s)
+{
+	body += s;
+}
+
+///////////
+// Temps //
+///////////
+std::string Codegen_x64::slot(int d)
+{
+	temps = std::max(temps, d + 1);
+	return "[rbp" + itoa_sgn(-frameSize - 16 - 8 * (d + 1)) + "]";
+}
+
+//the reg an int temp is in - loaded into scratch if it's in the frame
+std::string Codegen_x64::get(int d, const std::string& scratch)
+{
+	if (d < INT_TEMPS) {
+		saved |= 1 << d;
+		return intTemps[d];
+	}
+	emit("\tmov\t" + scratch + ",qword ptr " + slot(d) + "\n");
+	return scratch;
+}
+
+void Codegen_x64::put(int d, const std::string& r)
+{
+	if (kinds.size() <= d)
+		kinds.resize(d + 1);
+	kinds[d] = 'i';
+	if (d < INT_TEMPS) {
+		saved |= 1 << d;
+		if (r != intTemps[d])
+			emit("\tmov\t" + intTemps[d] + "," + r + "\n");
+		return;
+	}
+	emit("\tmov\tqword ptr " + slot(d) + "," + r + "\n");
+}
+
+std::string Codegen_x64::fget(int d, const std::string& scratch)
+{
+	if (d < FLT_TEMPS)
+		return xmm(8 + d);
+	emit("\tmovss\t" + scratch + ",dword ptr " + slot(d) + "\n");
+	return scratch;
+}
+
+void Codegen_x64::fput(int d, const std::string& x)
+{
+	if (kinds.size() <= d)
+		kinds.resize(d + 1);
+	kinds[d] = 'f';
+	if (d < FLT_TEMPS) {
+		if (x != xmm(8 + d))
+			emit("\tmovss\t" + xmm(8 + d) + "," + x + "\n");
+		return;
+	}
+	emit("\tmovss\tdword ptr " + slot(d) + "," + x + "\n");
+}
+
+/////////////////////////////////////////////////////////////
+// The memory operand for a MEM's ref - anything it has to //
+// work out goes in temps from depth d, and rax/rcx.       //
+/////////////////////////////////////////////////////////////
+std::string Codegen_x64::mode(TNode* t, int d)
+{
+	switch (t->op) {
+	case IR_LOCAL:
+		return "[rbp" + itoa_sgn(t->iconst) + "]";
+	case IR_GLOBAL:
+		return "[rip+" + t->sconst + "]";
+	case IR_ADD:
+		if (!(t->iconst & IR_ADDR))
+			break;
+		if (t->r->op == IR_CONST) {
+			if (t->l->op == IR_LOCAL)
+				return "[rbp" + itoa_sgn(t->l->iconst + t->r->iconst) + "]";
+			if (t->l->op == IR_GLOBAL)
+				return "[rip+" + t->l->sconst + itoa_sgn(t->r->iconst) + "]";
+			genInt(t->l, d);
+			return "[" + get(d, "rax") + itoa_sgn(t->r->iconst) + "]";
+		}
+		//base+index*scale
+		{
+			TNode* i     = t->r;
+			int    scale = 1;
+			if (i->op == IR_MUL && i->r->op == IR_CONST) {
+				int c = i->r->iconst;
+				if (c == 2 || c == 4 || c == 8) {
+					scale = c;
+					i     = i->l;
+				}
+			}
+			genInt(t->l, d);
+			genInt(i, d + 1);
+			std::string b = get(d, "rax");
+			std::string x = get(d + 1, "rcx");
+			emit("\tmovsxd\t" + x + "," + lo(x) + "\n");
+			return "[" + b + "+" + x + (scale > 1 ? "*" + itoa(scale) : "") + "]";
+		}
+	}
+	genInt(t, d);
+	return "[" + get(d, "rax") + "]";
+}
+
+////////////////////////
+// Gen and throw away //
+////////////////////////
+void Codegen_x64::gen(TNode* t)
+{
+	if (!t)
+		return;
+	switch (t->op) {
+	case IR_SEQ:
+		gen(t->l);
+		gen(t->r);
+		return;
+	case IR_MOVE: {
+		TNode* src = t->l;
+		if (src->op == IR_REGARG) {
+			param(t);
+			return;
+		}
+		if (isFPOp(src->op)) {
+			genFloat(src, 0);
+			std::string m = mode(t->r->l, 1);
+			emit("\tmovss\tdword ptr " + m + "," + fget(0, "xmm0") + "\n");
+			return;
+		}
+		if (src->op == IR_CONST) {
+			std::string m = mode(t->r->l, 0);
+			emit("\tmov\tqword ptr " + m + "," + itoa(src->iconst) + "\n");
+			return;
+		}
+		genInt(src, 0);
+		std::string m = mode(t->r->l, 1);
+		emit("\tmov\tqword ptr " + m + "," + get(0, "rdx") + "\n");
+		return;
+	}
+	case IR_CALL:
+	case IR_FCALL:
+		genCall(t, 0);
+		return;
+	case IR_JUMP:
+		emit("\tjmp\t" + t->sconst + "\n");
+		return;
+	case IR_JUMPT:
+	case IR_JUMPF:
+		if (isRelop(t->l->op) || isFPRelop(t->l->op)) {
+			trap(genCompare(t->l, 0, t->op == IR_JUMPF), t->sconst);
+			return;
+		}
+		genJump(t, 0);
+		return;
+	case IR_JUMPGE:
+		genJump(t, 0);
+		return;
+	case IR_JUMPTABLE: {
+		genInt(t->l, 0);
+		emit("\tmovsxd\trax," + lo(get(0, "rax")) + "\n");
+		emit("\tlea\trcx,[rip+" + t->sconst + "]\n");
+		emit("\tjmp\tqword ptr [rcx+rax*8]\n");
+		return;
+	}
+	case IR_JSR:
+		//keep rsp 16 byte aligned for calls made from the subroutine
+		emit("\tsub\trsp,8\n\tcall\t" + t->sconst + "\n\tadd\trsp,8\n");
+		return;
+	case IR_RET:
+		emit("\tret\n");
+		return;
+	case IR_RETURN: {
+		genInt(t->l, 0);
+		std::string r = get(0, "rax");
+		if (r != "rax")
+			emit("\tmov\trax," + r + "\n");
+		emit("\tjmp\t" + t->sconst + "\n");
+		return;
+	}
+	case IR_FRETURN: {
+		genFloat(t->l, 0);
+		std::string x = fget(0, "xmm0");
+		if (x != "xmm0")
+			emit("\tmovss\txmm0," + x + "\n");
+		emit("\tjmp\t" + t->sconst + "\n");
+		return;
+	}
+	}
+	genInt(t, 0);
+}
+
+//store a param on entry - SysV gives ints and floats the next free reg of their own
+//kind, and the rest are on the stack past the return address
+void Codegen_x64::param(TNode* t)
+{
+	std::string m = mode(t->r->l, 0);
+	if (t->iconst & IR_FLOAT) {
+		if (fltParams < FLT_ARGS) {
+			emit("\tmovss\tdword ptr " + m + "," + xmm(fltParams++) + "\n");
+			return;
+		}
+	} else if (intParams < INT_ARGS) {
+		emit("\tmov\tqword ptr " + m + "," + intArgs[intParams++] + "\n");
+		return;
+	}
+	emit("\tmov\trax,qword ptr [rbp" + itoa_sgn(16 + 8 * stackParams++) + "]\n");
+	emit("\tmov\tqword ptr " + m + ",rax\n");
+}
+
+//j<cc> to l - or, for the runtime's error funcs, call them so the stack is as they expect
+void Codegen_x64::trap(const std::string& cc, const std::string& l)
+{
+	if (l.compare(0, 4, "__bb")) {
+		emit("\tj" + cc + "\t" + l + "\n");
+		return;
+	}
+	std::string ok = ".Ltrap" + itoa(++traps);
+	emit("\tj" + invert(cc) + "\t" + ok + "\n");
+	emit("\tcall\t" + l + "\n");
+	emit(ok + ":\n");
+}
+
+/////////////////////////////////////////////////////////
+// Gen an int, or an address, into the temp at depth d //
+/////////////////////////////////////////////////////////
+void Codegen_x64::genInt(TNode* t, int d)
+{
+	std::string w = d < INT_TEMPS ? intTemps[d] : "rax";
+	if (isFPOp(t->op)) {
+		//a float's bits
+		genFloat(t, d);
+		emit("\tmovd\t" + lo(w) + "," + fget(d, "xmm0") + "\n");
+		put(d, w);
+		return;
+	}
+	switch (t->op) {
+	case IR_CONST:
+		if (t->iconst)
+			emit("\tmov\t" + lo(w) + "," + itoa(t->iconst) + "\n");
+		else
+			emit("\txor\t" + lo(w) + "," + lo(w) + "\n");
+		break;
+	case IR_LOCAL:
+		emit("\tlea\t" + w + ",[rbp" + itoa_sgn(t->iconst) + "]\n");
+		break;
+	case IR_GLOBAL:
+		emit("\tlea\t" + w + ",[rip+" + t->sconst + "]\n");
+		break;
+	case IR_MEM: {
+		std::string m = mode(t->l, d);
+		emit("\tmov\t" + w + ",qword ptr " + m + "\n");
+		break;
+	}
+	case IR_CALL:
+		genCall(t, d);
+		return;
+	case IR_CAST:
+		genFloat(t->l, d);
+		emit("\tcvtss2si\t" + lo(w) + "," + fget(d, "xmm0") + "\n");
+		break;
+	case IR_NEG:
+		genInt(t->l, d);
+		w = get(d, "rax");
+		emit("\tneg\t" + lo(w) + "\n");
+		break;
+	case IR_ADD:
+	case IR_SUB:
+	case IR_MUL:
+	case IR_AND:
+	case IR_OR:
+	case IR_XOR:
+		genArith(t, d);
+		return;
+	case IR_SHL:
+	case IR_SHR:
+	case IR_SAR:
+		genShift(t, d);
+		return;
+	case IR_DIV:
+	case IR_MULHI:
+		genDivide(t, d);
+		return;
+	case IR_JUMPT:
+	case IR_JUMPF:
+	case IR_JUMPGE:
+		genJump(t, d);
+		return;
+	default:
+		if (isRelop(t->op) || isFPRelop(t->op)) {
+			emit("\tset" + genCompare(t, d, false) + "\tal\n");
+			emit("\tmovzx\t" + lo(w) + ",al\n");
+			break;
+		}
+		throw std::runtime_error("Codegen_x64: unexpected IR op " + itoa(t->op));
+	}
+	put(d, w);
+}
+
+void Codegen_x64::genArith(TNode* t, int d)
+{
+	std::string op;
+	switch (t->op) {
+	case IR_ADD:
+		op = "add";
+		break;
+	case IR_SUB:
+		op = "sub";
+		break;
+	case IR_MUL:
+		op = "imul";
+		break;
+	case IR_AND:
+		op = "and";
+		break;
+	case IR_OR:
+		op = "or";
+		break;
+	case IR_XOR:
+		op = "xor";
+		break;
+	}
+	bool ptr = t->op == IR_ADD && (t->iconst & IR_ADDR);
+
+	genInt(t->l, d);
+	if (t->r->op == IR_CONST) {
+		std::string a = get(d, "rax");
+		std::string r = ptr ? a : lo(a);
+		if (t->op == IR_MUL)
+			emit("\timul\t" + r + "," + r + "," + itoa(t->r->iconst) + "\n");
+		else
+			emit("\t" + op + "\t" + r + "," + itoa(t->r->iconst) + "\n");
+		put(d, a);
+		return;
+	}
+	genInt(t->r, d + 1);
+	std::string a = get(d, "rax");
+	std::string b = get(d + 1, "rcx");
+	if (ptr) {
+		//the offset's an int - only its low half means anything
+		emit("\tmovsxd\t" + b + "," + lo(b) + "\n");
+		emit("\tadd\t" + a + "," + b + "\n");
+	} else {
+		emit("\t" + op + "\t" + lo(a) + "," + lo(b) + "\n");
+	}
+	put(d, a);
+}
+
+void Codegen_x64::genShift(TNode* t, int d)
+{
+	std::string op = t->op == IR_SHL ? "shl" : (t->op == IR_SHR ? "shr" : "sar");
+	genInt(t->l, d);
+	if (t->r->op == IR_CONST) {
+		std::string a = get(d, "rax");
+		emit("\t" + op + "\t" + lo(a) + "," + itoa(t->r->iconst & 31) + "\n");
+		put(d, a);
+		return;
+	}
+	genInt(t->r, d + 1);
+	std::string a = get(d, "rax");
+	std::string b = get(d + 1, "rcx");
+	if (b != "rcx")
+		emit("\tmov\tecx," + lo(b) + "\n");
+	emit("\t" + op + "\t" + lo(a) + ",cl\n");
+	put(d, a);
+}
+
+void Codegen_x64::genDivide(TNode* t, int d)
+{
+	genInt(t->l, d);
+	genInt(t->r, d + 1);
+	std::string a = get(d, "rax");
+	std::string b = get(d + 1, "rcx");
+	if (a != "rax")
+		emit("\tmov\teax," + lo(a) + "\n");
+	if (t->op == IR_MULHI) {
+		emit("\timul\t" + lo(b) + "\n");
+		put(d, "rdx");
+		return;
+	}
+	emit("\tcdq\n");
+	emit("\tidiv\t" + lo(b) + "\n");
+	put(d, "rax");
+}
+
+////////////////////////////////////////////////////////
+// Gen a float into the temp at depth d - or an int's //
+// bits, for the odd float var copied as an int.      //
+////////////////////////////////////////////////////////
+void Codegen_x64::genFloat(TNode* t, int d)
+{
+	std::string x = d < FLT_TEMPS ? xmm(8 + d) : "xmm0";
+	switch (t->op) {
+	case IR_MEM: {
+		std::string m = mode(t->l, d);
+		emit("\tmovss\t" + x + ",dword ptr " + m + "\n");
+		break;
+	}
+	case IR_CONST:
+		emit("\tmov\teax," + itoa(t->iconst) + "\n");
+		emit("\tmovd\t" + x + ",eax\n");
+		break;
+	case IR_FCALL:
+		genCall(t, d);
+		return;
+	case IR_FCAST:
+		genInt(t->l, d);
+		emit("\tcvtsi2ss\t" + x + "," + lo(get(d, "rax")) + "\n");
+		break;
+	case IR_FNEG:
+		genFloat(t->l, d);
+		emit("\tmovd\teax," + fget(d, "xmm0") + "\n");
+		emit("\txor\teax,0x80000000\n");
+		emit("\tmovd\t" + x + ",eax\n");
+		break;
+	case IR_FADD:
+	case IR_FSUB:
+	case IR_FMUL:
+	case IR_FDIV:
+		genFPArith(t, d);
+		return;
+	default:
+		genInt(t, d);
+		emit("\tmovd\t" + x + "," + lo(get(d, "rax")) + "\n");
+		break;
+	}
+	fput(d, x);
+}
+
+void Codegen_x64::genFPArith(TNode* t, int d)
+{
+	std::string op;
+	switch (t->op) {
+	case IR_FADD:
+		op = "addss";
+		break;
+	case IR_FSUB:
+		op = "subss";
+		break;
+	case IR_FMUL:
+		op = "mulss";
+		break;
+	case IR_FDIV:
+		op = "divss";
+		break;
+	}
+	genFloat(t->l, d);
+	genFloat(t->r, d + 1);
+	std::string a = fget(d, "xmm0");
+	std::string b = fget(d + 1, "xmm1");
+	emit("\t" + op + "\t" + a + "," + b + "\n");
+	fput(d, a);
+}
+
+/////////////////////////////////////////////////////
+// Compare, and return the condition code that's   //
+// set if the relop is true - or false, if negate. //
+/////////////////////////////////////////////////////
+std::string Codegen_x64::genCompare(TNode* t, int d, bool negate)
+{
+	std::string cc;
+	switch (t->op) {
+	case IR_SETEQ:
+		cc = "e";
+		break;
+	case IR_SETNE:
+		cc = "ne";
+		break;
+	case IR_SETLT:
+		cc = "l";
+		break;
+	case IR_SETGT:
+		cc = "g";
+		break;
+	case IR_SETLE:
+		cc = "le";
+		break;
+	case IR_SETGE:
+		cc = "ge";
+		break;
+	case IR_FSETEQ:
+		cc = "z";
+		break;
+	case IR_FSETNE:
+		cc = "nz";
+		break;
+	case IR_FSETLT:
+		cc = "b";
+		break;
+	case IR_FSETGT:
+		cc = "a";
+		break;
+	case IR_FSETLE:
+		cc = "be";
+		break;
+	case IR_FSETGE:
+		cc = "ae";
+		break;
+	}
+	if (isFPRelop(t->op)) {
+		genFloat(t->l, d);
+		genFloat(t->r, d + 1);
+		std::string a = fget(d, "xmm0");
+		emit("\tucomiss\t" + a + "," + fget(d + 1, "xmm1") + "\n");
+	} else if (t->r->op == IR_CONST) {
+		genInt(t->l, d);
+		emit("\tcmp\t" + lo(get(d, "rax")) + "," + itoa(t->r->iconst) + "\n");
+	} else {
+		genInt(t->l, d);
+		genInt(t->r, d + 1);
+		std::string a = get(d, "rax");
+		emit("\tcmp\t" + lo(a) + "," + lo(get(d + 1, "rcx")) + "\n");
+	}
+	return negate ? invert(cc) : cc;
+}
+
+//a conditional jump - its value is what was tested, as a null object check's is
+void Codegen_x64::genJump(TNode* t, int d)
+{
+	genInt(t->l, d);
+	std::string a = get(d, "rax");
+	if (t->op == IR_JUMPGE) {
+		genInt(t->r, d + 1);
+		a = get(d, "rax");
+		emit("\tcmp\t" + lo(a) + "," + lo(get(d + 1, "rcx")) + "\n");
+		trap("ae", t->sconst);
+		return;
+	}
+	std::string r = (t->iconst & IR_ADDR) ? a : lo(a);
+	emit("\ttest\t" + r + "," + r + "\n");
+	trap(t->op == IR_JUMPT ? "nz" : "z", t->sconst);
+}
+
+/////////////////////////////////////////////////////////////
+// Call - the args are worked out into temps from depth d, //
+// then moved into the regs and stack slots SysV wants.    //
+/////////////////////////////////////////////////////////////
+struct Arg {
+	int  pos, depth;
+	bool flt;
+	bool operator<(const Arg& a) const { return pos < a.pos; }
+};
+
+static void collectArgs(TNode* t, std::vector<TNode*>& moves)
+{
+	if (!t)
+		return;
+	if (t->op == IR_MOVE) {
+		moves.push_back(t);
+		return;
+	}
+	collectArgs(t->l, moves);
+	collectArgs(t->r, moves);
+}
+
+void Codegen_x64::genCall(TNode* t, int d)
+{
+	std::vector<TNode*> moves;
+	collectArgs(t->r, moves);
+
+	std::vector<Arg> args;
+	for (int k = 0; k < moves.size(); ++k) {
+		TNode* m = moves[k];
+		Arg    a;
+		a.depth = d + k;
+		a.flt   = (m->iconst & IR_FLOAT) != 0;
+		a.pos   = m->r->op == IR_REGARG ? m->r->iconst : m->r->l->iconst;
+		if (a.flt)
+			genFloat(m->l, a.depth);
+		else
+			genInt(m->l, a.depth);
+		args.push_back(a);
+	}
+	std::stable_sort(args.begin(), args.end());
+
+	//floats held over the call are trashed by it
+	std::vector<int> spilled;
+	for (int k = 0; k < d && k < FLT_TEMPS && k < kinds.size(); ++k) {
+		if (kinds[k] != 'f')
+			continue;
+		emit("\tmovss\tdword ptr " + slot(k) + "," + xmm(8 + k) + "\n");
+		spilled.push_back(k);
+	}
+
+	std::vector<std::string> regs;
+	std::vector<Arg>         stack;
+	int                      ni = 0, nf = 0;
+	for (int k = 0; k < args.size(); ++k) {
+		const Arg& a = args[k];
+		if (a.flt && nf < FLT_ARGS)
+			regs.push_back(xmm(nf++));
+		else if (!a.flt && ni < INT_ARGS)
+			regs.push_back(intArgs[ni++]);
+		else {
+			regs.push_back("");
+			stack.push_back(a);
+		}
+	}
+
+	int sz = (stack.size() * 8 + 15) & ~15;
+	if (sz)
+		emit("\tsub\trsp," + itoa(sz) + "\n");
+	for (int k = 0; k < stack.size(); ++k) {
+		std::string m = "[rsp" + itoa_sgn(k * 8) + "]";
+		if (stack[k].flt)
+			emit("\tmovss\tdword ptr " + m + "," + fget(stack[k].depth, "xmm0") + "\n");
+		else
+			emit("\tmov\tqword ptr " + m + "," + get(stack[k].depth, "rax") + "\n");
+	}
+	for (int k = 0; k < args.size(); ++k) {
+		const Arg& a = args[k];
+		if (!regs[k].size())
+			continue;
+		if (a.flt) {
+			if (a.depth < FLT_TEMPS)
+				emit("\tmovss\t" + regs[k] + "," + xmm(8 + a.depth) + "\n");
+			else
+				emit("\tmovss\t" + regs[k] + ",dword ptr " + slot(a.depth) + "\n");
+		} else {
+			if (a.depth < INT_TEMPS)
+				emit("\tmov\t" + regs[k] + "," + get(a.depth, "") + "\n");
+			else
+				emit("\tmov\t" + regs[k] + ",qword ptr " + slot(a.depth) + "\n");
+		}
+	}
+
+	//varargs want the number of vector regs used in al
+	if (t->sconst == "C")
+		emit("\tmov\teax," + itoa(nf) + "\n");
+	if (t->l->op == IR_MEM)
+		emit("\tcall\tqword ptr [rip+" + t->l->l->sconst + "]\n");
+	else
+		emit("\tcall\t" + t->l->sconst + "\n");
+	if (sz)
+		emit("\tadd\trsp," + itoa(sz) + "\n");
+
+	for (int k = 0; k < spilled.size(); ++k)
+		emit("\tmovss\t" + xmm(8 + spilled[k]) + ",dword ptr " + slot(spilled[k]) + "\n");
+
+	if (t->op == IR_FCALL)
+		fput(d, "xmm0");
+	else
+		put(d, "rax");
+}
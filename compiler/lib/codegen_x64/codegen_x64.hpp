@@ -0,0 +1,65 @@
+#pragma once
+#include "../codegen.hpp"
+#include <ostream>
+#include <string>
+#include <vector>
+
+//x86-64 code as GNU as source (intel syntax), calling and called with the SysV ABI.
+//
+//Every var is a pointer sized slot, see Node::word. Ints only live in the low 32 bits
+//of a register and are worked on with 32 bit ops, so the IR says which adds and tests
+//are of addresses - see IR_ADDR. Temps go in rbx and r12-r15, floats in xmm8-xmm15,
+//and anything deeper than that in the frame.
+//
+//This is the code generator only: it writes source for the system assembler, and there's no
+//Assem_x64 to encode it into a Module (which only has 32 bit relocations) or 64 bit runtime to
+//link it with.
+class Codegen_x64 : public Codegen {
+	public:
+	Codegen_x64(std::ostream& out, bool debug);
+
+	virtual void enter(const std::string& l, int frameSize);
+	virtual void code(TNode* code);
+	virtual void leave(TNode* cleanup, int pop_sz);
+	virtual void label(const std::string& l);
+	virtual void i_data(int i, const std::string& l);
+	virtual void s_data(const std::string& s, const std::string& l);
+	virtual void p_data(const std::string& p, const std::string& l);
+	virtual void w_data(int i, const std::string& l);
+	virtual void align_data(int n);
+	virtual void flush();
+
+	private:
+	bool        inCode;
+	std::string funcLabel, body;
+	int         frameSize; //locals, as enumVars laid them out
+	int         temps;     //temp slots used - one per depth past the regs
+	int         saved;     //callee saved regs used, as 1<<depth
+	int         intParams, fltParams, stackParams; //params stored so far on entry
+	int         traps;     //labels for skipping calls to the runtime's error funcs
+
+	std::vector<char>        kinds; //'f' if the temp at a depth holds a float
+	std::vector<std::string> dataFrags;
+
+	void emit(const std::string& s);
+	void param(TNode* t);
+	void trap(const std::string& jcc, const std::string& l);
+
+	std::string slot(int d);
+	std::string get(int d, const std::string& scratch);
+	void        put(int d, const std::string& r);
+	std::string fget(int d, const std::string& scratch);
+	void        fput(int d, const std::string& x);
+	std::string mode(TNode* ref, int d);
+
+	void gen(TNode* t);              //gen and discard result
+	void genInt(TNode* t, int d);    //gen into the int temp at depth d
+	void genFloat(TNode* t, int d);  //gen into the float temp at depth d
+	void genCall(TNode* t, int d);
+	void genArith(TNode* t, int d);
+	void genShift(TNode* t, int d);
+	void genDivide(TNode* t, int d);
+	void genFPArith(TNode* t, int d);
+	std::string genCompare(TNode* t, int d, bool negate);
+	void genJump(TNode* t, int d);
+};
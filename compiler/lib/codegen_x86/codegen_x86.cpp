@@ -1,5 +1,9 @@
 #include "codegen_x86.hpp"
 #include "tile.hpp"
+#include "../assem_x86/assem_x86.hpp"
+#include <algorithm>
+#include <map>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -7,92 +11,200 @@
 
 //#define NOOPTS
 
-Codegen_x86::Codegen_x86(std::ostream& out, bool debug) : Codegen(out, debug), inCode(false) {}
+//in the order the prologue pushes them
+static const int calleeSaved[] = {EBX, ESI, EDI};
+
+static const Operand r_eax = Operand::reg32(0), r_ecx = Operand::reg32(1), r_edx = Operand::reg32(2),
+					 r_ebx = Operand::reg32(3), r_esp = Operand::reg32(4), r_ebp = Operand::reg32(5),
+					 r_esi = Operand::reg32(6), r_edi = Operand::reg32(7);
+static const Operand r_saved[] = {r_ebx, r_esi, r_edi}; //same order as calleeSaved
+static const Operand r_al = Operand::reg8(0), r_cl = Operand::reg8(1), r_ax = Operand::reg16(0);
+static const Operand st_1 = Operand::fpu(1), m_esp = Operand::memory(4, 0);
+
+//the regs the tile's children are in
+static const Arg l_reg = Arg::reg32(REG_L), r_reg = Arg::reg32(REG_R), l_xmm = Arg::xmm(REG_L),
+				 r_xmm = Arg::xmm(REG_R);
+
+//for the -a listing
+static std::string source(const CodeInst& i)
+{
+	if (i.kind == CodeInst::LABEL)
+		return i.label + '\n';
+	return Assem_x86::source(i.op, i.l, i.r, i.cc);
+}
+
+Codegen_x86::Codegen_x86(std::ostream& out, bool debug)
+	: Codegen(out, debug), sse(false), peep(0), inCode(false), worker(false), assem(0), funcData(0)
+{}
+
+Codegen_x86::Codegen_x86(std::ostream& out, bool debug, Assem_x86* assem)
+	: Codegen(out, debug), sse(false), peep(0), inCode(false), worker(false), assem(assem), funcData(0)
+{}
+
+Codegen* Codegen_x86::fork()
+{
+	if (!assem)
+		return 0;
+	Codegen_x86* g = new Codegen_x86(out, debug, assem);
+	g->worker      = true;
+	g->sse         = sse;
+	g->peep        = peep;
+	return g;
+}
 
 void Codegen_x86::enter(const std::string& l, int frameSize)
 {
 	inCode      = true;
-	::frameSize = maxFrameSize = frameSize;
-	codeFrags.clear();
-	funcLabel = l;
+	fn.frameSize = fn.maxFrameSize = frameSize;
+	fn.code.clear();
+	fn.funcLabel = l;
+	funcData  = binData.size();
 }
 
 void Codegen_x86::code(TNode* stmt)
 {
-	resetRegs();
-	Tile* q = munch(stmt);
+	Stmt st = {stmt};
+	stmts.push_back(st);
+}
+
+void Codegen_x86::tile(TNode* t, bool ret)
+{
+	fn.resetRegs();
+	if (ret)
+		fn.allocReg(EAX); //holds the return value
+	Tile* q = munch(t);
 	q->label();
-	q->eval(0);
+	q->eval(fn, 0);
 	delete q;
-	delete stmt;
 }
 
 void Codegen_x86::leave(TNode* cleanup, int pop_sz)
 {
-	if (cleanup) {
-		resetRegs();
-		allocReg(EAX);
-		Tile* q = munch(cleanup);
-		q->label();
-		q->eval(0);
-		delete q;
-	}
-
-	out << "\t.align\t16\n";
-
-	if (funcLabel.size())
-		out << funcLabel << '\n';
-
-	out << "\tpush\tebx\n";
-	out << "\tpush\tesi\n";
-	out << "\tpush\tedi\n";
-	out << "\tpush\tebp\n";
-	out << "\tmov\tebp,esp\n";
-	if (maxFrameSize)
-		out << "\tsub\tesp," << maxFrameSize << '\n';
-
-	int                                esp_off = 0;
-	std::vector<std::string>::iterator it      = codeFrags.begin();
-	for (it = codeFrags.begin(); it != codeFrags.end(); ++it) {
-		const std::string& t = *it;
-		if (t[0] == '+') {
-			esp_off += atoi(t.substr(1));
-		} else if (t[0] == '-') {
-			//***** Still needed for STDCALL *****
-			esp_off -= atoi(t.substr(1));
+	fn.numRegs = NUM_REGS;
+	if (!debug)
+		allocRegs(cleanup);
+
+	for (size_t k = 0; k < stmts.size(); ++k) {
+		if (TNode* t = stmts[k].t) {
+			tile(t, false);
+			delete t;
 		} else {
-			if (esp_off) {
-				out << fixEsp(esp_off);
-				esp_off = 0;
-			}
-			out << *it;
+			fn.code.push_back(CodeInst::at(stmts[k].label));
 		}
 	}
-	if (esp_off)
-		out << fixEsp(esp_off);
+	stmts.clear();
+
+	if (cleanup)
+		tile(cleanup, true);
+
+	peephole();
+
+	if (worker) {
+		//keep it all for whoever forked us - assem belongs to them
+		lastFunc.label     = fn.funcLabel;
+		lastFunc.frameSize = fn.maxFrameSize;
+		lastFunc.popSize   = pop_sz;
+		lastFunc.saved     = fn.saved;
+		lastFunc.code.swap(fn.code);
+		lastFunc.data.assign(binData.begin() + funcData, binData.end());
+		binData.erase(binData.begin() + funcData, binData.end());
+	} else if (assem) {
+		if (cache) {
+			lastFunc.label     = fn.funcLabel;
+			lastFunc.frameSize = fn.maxFrameSize;
+			lastFunc.popSize   = pop_sz;
+			lastFunc.saved     = fn.saved;
+			lastFunc.code      = fn.code;
+			lastFunc.data.assign(binData.begin() + funcData, binData.end());
+		}
+		emitCode(pop_sz);
+	} else {
+		out << "\t.align\t16\n";
 
-	out << "\tmov\tesp,ebp\n";
-	out << "\tpop\tebp\n";
-	out << "\tpop\tedi\n";
-	out << "\tpop\tesi\n";
-	out << "\tpop\tebx\n";
-	out << "\tret\tword " << pop_sz << "\n";
+		if (fn.funcLabel.size())
+			out << fn.funcLabel << '\n';
+
+		for (int k = 0; k < 3; ++k) {
+			if (fn.saved & (1 << calleeSaved[k]))
+				out << Assem_x86::source(OP_PUSH, r_saved[k]);
+		}
+		out << Assem_x86::source(OP_PUSH, r_ebp);
+		out << Assem_x86::source(OP_MOV, r_ebp, r_esp);
+		if (fn.maxFrameSize)
+			out << Assem_x86::source(OP_SUB, r_esp, Operand::immediate(fn.maxFrameSize));
+
+		int                                   esp_off = 0;
+		std::vector<CodeInst>::const_iterator it;
+		for (it = fn.code.begin(); it != fn.code.end(); ++it) {
+			const CodeInst& i = *it;
+			if (i.kind == CodeInst::ESP) {
+				//***** Still needed for STDCALL *****
+				esp_off += i.l.imm;
+			} else {
+				if (esp_off) {
+					out << source(fixEsp(esp_off));
+					esp_off = 0;
+				}
+				out << source(i);
+			}
+		}
+		if (esp_off)
+			out << source(fixEsp(esp_off));
+
+		out << Assem_x86::source(OP_MOV, r_esp, r_ebp);
+		out << Assem_x86::source(OP_POP, r_ebp);
+		for (int k = 2; k >= 0; --k) {
+			if (fn.saved & (1 << calleeSaved[k]))
+				out << Assem_x86::source(OP_POP, r_saved[k]);
+		}
+		out << Assem_x86::source(OP_RET, Operand::immediate(pop_sz, 2));
+	}
 
 	delete cleanup;
 	inCode = false;
 }
 
+bool Codegen_x86::record(CodeFunc& f)
+{
+	if (!worker && (!assem || !cache))
+		return false;
+	f = lastFunc;
+	return true;
+}
+
+bool Codegen_x86::replay(const CodeFunc& f)
+{
+	if (!assem)
+		return false;
+	fn.funcLabel    = f.label;
+	fn.maxFrameSize = f.frameSize;
+	fn.saved        = f.saved;
+	fn.code         = f.code;
+	emitCode(f.popSize);
+	binData.insert(binData.end(), f.data.begin(), f.data.end());
+	return true;
+}
+
 void Codegen_x86::label(const std::string& l)
 {
 	std::string t = l + '\n';
-	if (inCode)
-		codeFrags.push_back(t);
+	if (inCode) {
+		Stmt st = {0, l};
+		stmts.push_back(st);
+	} else if (assem)
+		binData.push_back(CodeData(CodeData::LABEL, 0, l));
 	else
 		dataFrags.push_back(t);
 }
 
 void Codegen_x86::i_data(int i, const std::string& l)
 {
+	if (assem) {
+		if (l.size())
+			binData.push_back(CodeData(CodeData::LABEL, 0, l));
+		binData.push_back(CodeData(CodeData::INT, i, ""));
+		return;
+	}
 	if (l.size())
 		dataFrags.push_back(l);
 	char buff[32];
@@ -102,6 +214,12 @@ void Codegen_x86::i_data(int i, const std::string& l)
 
 void Codegen_x86::s_data(const std::string& s, const std::string& l)
 {
+	if (assem) {
+		if (l.size())
+			binData.push_back(CodeData(CodeData::LABEL, 0, l));
+		binData.push_back(CodeData(CodeData::STR, 0, s));
+		return;
+	}
 	if (l.size())
 		dataFrags.push_back(l);
 	dataFrags.push_back(std::string("\t.db\t\"") + s + "\",0\n");
@@ -109,6 +227,12 @@ void Codegen_x86::s_data(const std::string& s, const std::string& l)
 
 void Codegen_x86::p_data(const std::string& p, const std::string& l)
 {
+	if (assem) {
+		if (l.size())
+			binData.push_back(CodeData(CodeData::LABEL, 0, l));
+		binData.push_back(CodeData(CodeData::PTR, 0, p));
+		return;
+	}
 	if (l.size())
 		dataFrags.push_back(l);
 	dataFrags.push_back(std::string("\t.dd\t") + p + '\n');
@@ -116,6 +240,10 @@ void Codegen_x86::p_data(const std::string& p, const std::string& l)
 
 void Codegen_x86::align_data(int n)
 {
+	if (assem) {
+		binData.push_back(CodeData(CodeData::ALIGN, n, ""));
+		return;
+	}
 	char buff[32];
 	_itoa(n, buff, 10);
 	dataFrags.push_back(std::string("\t.align\t") + buff + '\n');
@@ -123,15 +251,95 @@ void Codegen_x86::align_data(int n)
 
 void Codegen_x86::flush()
 {
+	if (assem) {
+		emitData();
+		return;
+	}
+	if (dataFrags.size())
+		out << "\t.data\n";
 	std::vector<std::string>::iterator it;
 	for (it = dataFrags.begin(); it != dataFrags.end(); ++it)
 		out << *it;
 	dataFrags.clear();
 }
 
-static std::string itoa_sgn(int n)
+/////////////////////////////////////////////////
+// Binary mode - emit straight into the Module //
+/////////////////////////////////////////////////
+void Codegen_x86::emitCode(int pop_sz)
 {
-	return n ? (n > 0 ? "+" + itoa(n) : itoa(n)) : "";
+	assem->align(16);
+
+	if (fn.funcLabel.size())
+		assem->label(fn.funcLabel);
+
+	for (int k = 0; k < 3; ++k) {
+		if (fn.saved & (1 << calleeSaved[k]))
+			assem->encode(OP_PUSH, r_saved[k]);
+	}
+	assem->encode(OP_PUSH, r_ebp);
+	assem->encode(OP_MOV, r_ebp, r_esp);
+	if (fn.maxFrameSize)
+		assem->encode(OP_SUB, r_esp, Operand::immediate(fn.maxFrameSize));
+
+	int                                   esp_off = 0;
+	std::vector<CodeInst>::const_iterator it;
+	for (it = fn.code.begin(); it != fn.code.end(); ++it) {
+		const CodeInst& i = *it;
+		if (i.kind == CodeInst::ESP) {
+			esp_off += i.l.imm;
+			continue;
+		}
+		if (esp_off) {
+			assem->encode(esp_off < 0 ? OP_SUB : OP_ADD, r_esp, Operand::immediate(abs(esp_off)));
+			esp_off = 0;
+		}
+		if (i.kind == CodeInst::LABEL)
+			assem->label(i.label);
+		else
+			assem->encode(i.op, i.l, i.r, i.cc);
+	}
+	if (esp_off)
+		assem->encode(esp_off < 0 ? OP_SUB : OP_ADD, r_esp, Operand::immediate(abs(esp_off)));
+
+	assem->encode(OP_MOV, r_esp, r_ebp);
+	assem->encode(OP_POP, r_ebp);
+	for (int k = 2; k >= 0; --k) {
+		if (fn.saved & (1 << calleeSaved[k]))
+			assem->encode(OP_POP, r_saved[k]);
+	}
+	assem->encode(OP_RET, Operand::immediate(pop_sz, 2));
+}
+
+void Codegen_x86::emitData()
+{
+	if (binData.size())
+		assem->mod->beginData();
+	std::vector<CodeData>::iterator it;
+	for (it = binData.begin(); it != binData.end(); ++it) {
+		const CodeData& d = *it;
+		switch (d.kind) {
+		case CodeData::LABEL:
+			assem->label(d.s);
+			break;
+		case CodeData::INT:
+			assem->emitd(d.i);
+			break;
+		case CodeData::STR:
+			for (int k = 0; k < d.s.size(); ++k)
+				assem->emit(d.s[k]);
+			assem->emit(0);
+			break;
+		case CodeData::PTR:
+			assem->a_reloc(d.s);
+			assem->emitd(0);
+			break;
+		case CodeData::ALIGN:
+			assem->align(d.i);
+			break;
+		}
+	}
+	binData.clear();
 }
 
 static bool isRelop(int op)
@@ -139,6 +347,19 @@ static bool isRelop(int op)
 	return op == IR_SETEQ || op == IR_SETNE || op == IR_SETLT || op == IR_SETGT || op == IR_SETLE || op == IR_SETGE;
 }
 
+static bool isFPRelop(int op)
+{
+	return op == IR_FSETEQ || op == IR_FSETNE || op == IR_FSETLT || op == IR_FSETGT || op == IR_FSETLE ||
+		   op == IR_FSETGE;
+}
+
+//ops with a float result
+static bool isFPOp(int op)
+{
+	return op == IR_FCALL || op == IR_FCAST || op == IR_FNEG || op == IR_FADD || op == IR_FSUB || op == IR_FMUL ||
+		   op == IR_FDIV;
+}
+
 static bool nodesEqual(TNode* t1, TNode* t2)
 {
 	if (t1->op != t2->op || t1->iconst != t2->iconst || t1->sconst != t2->sconst)
@@ -172,8 +393,13 @@ static bool getShift(int n, int& shift)
 	return false;
 }
 
-static bool matchMEM(TNode* t, std::string& s)
+static bool matchMEM(TNode* t, Operand& s)
 {
+	if (t->op == IR_REG) {
+		s = Operand::reg32(regNums[t->iconst]);
+		return true;
+	}
+
 #ifdef NOOPTS
 	return false;
 #endif
@@ -183,19 +409,19 @@ static bool matchMEM(TNode* t, std::string& s)
 	t = t->l;
 	switch (t->op) {
 	case IR_GLOBAL:
-		s = "[" + t->sconst + "]";
+		s = Operand::memory(-1, 0, t->sconst);
 		return true;
 	case IR_LOCAL:
-		s = "[ebp" + itoa_sgn(t->iconst) + "]";
+		s = Operand::memory(5, t->iconst);
 		return true;
 	case IR_ARG:
-		s = "[esp" + itoa_sgn(t->iconst) + "]";
+		s = Operand::memory(4, t->iconst);
 		return true;
 	}
 	return false;
 }
 
-static bool matchCONST(TNode* t, std::string& s)
+static bool matchCONST(TNode* t, Operand& s)
 {
 #ifdef NOOPTS
 	return false;
@@ -203,16 +429,16 @@ static bool matchCONST(TNode* t, std::string& s)
 
 	switch (t->op) {
 	case IR_CONST:
-		s = itoa(t->iconst);
+		s = Operand::immediate(t->iconst);
 		return true;
 	case IR_GLOBAL:
-		s = t->sconst;
+		s = Operand::label(t->sconst);
 		return true;
 	}
 	return false;
 }
 
-static bool matchMEMCONST(TNode* t, std::string& s)
+static bool matchMEMCONST(TNode* t, Operand& s)
 {
 #ifdef NOOPTS
 	return false;
@@ -221,53 +447,326 @@ static bool matchMEMCONST(TNode* t, std::string& s)
 	return matchMEM(t, s) || matchCONST(t, s);
 }
 
-Tile* Codegen_x86::genCompare(TNode* t, std::string& func, bool negate)
+//////////////////////////////////////////
+// Keep the busiest locals in registers //
+//////////////////////////////////////////
+static const int MAX_PINNED = 3; //ebx, esi and edi - the tiler gets the rest
+static const int MIN_USES   = 4; //uses, weighted by loop depth, worth a register
+
+//a local is only a candidate if its address is never taken
+static void countLocals(TNode* t, int weight, std::map<int, int>& uses, std::set<int>& taken)
+{
+	if (!t)
+		return;
+	if (t->op == IR_MEM && t->l->op == IR_LOCAL) {
+		uses[t->l->iconst] += weight;
+		return;
+	}
+	if (t->op == IR_LOCAL) {
+		taken.insert(t->iconst);
+		return;
+	}
+	countLocals(t->l, weight, uses, taken);
+	countLocals(t->r, weight, uses, taken);
+}
+
+static void findJumps(TNode* t, std::vector<std::string>& labels)
+{
+	if (!t)
+		return;
+	switch (t->op) {
+	case IR_JUMP:
+	case IR_JUMPT:
+	case IR_JUMPF:
+	case IR_JUMPGE:
+		labels.push_back(t->sconst);
+		break;
+	}
+	findJumps(t->l, labels);
+	findJumps(t->r, labels);
+}
+
+static TNode* pinLocals(TNode* t, const std::map<int, int>& regOf)
+{
+	if (!t)
+		return 0;
+	if (t->op == IR_MEM && t->l->op == IR_LOCAL) {
+		std::map<int, int>::const_iterator it = regOf.find(t->l->iconst);
+		if (it == regOf.end())
+			return t;
+		delete t;
+		return new TNode(IR_REG, 0, 0, it->second);
+	}
+	t->l = pinLocals(t->l, regOf);
+	t->r = pinLocals(t->r, regOf);
+	return t;
+}
+
+void Codegen_x86::allocRegs(TNode*& cleanup)
+{
+	//loop depth of each statement - a jump back to a label closes a loop
+	std::map<std::string, int> labels;
+	std::vector<int>           depth(stmts.size());
+	for (int k = 0; k < stmts.size(); ++k) {
+		if (!stmts[k].t) {
+			labels[stmts[k].label] = k;
+			continue;
+		}
+		std::vector<std::string> jumps;
+		findJumps(stmts[k].t, jumps);
+		for (int j = 0; j < jumps.size(); ++j) {
+			std::map<std::string, int>::iterator it = labels.find(jumps[j]);
+			if (it == labels.end())
+				continue;
+			for (int n = it->second; n <= k; ++n)
+				++depth[n];
+		}
+	}
+
+	std::map<int, int> uses;
+	std::set<int>      taken;
+	for (int k = 0; k < stmts.size(); ++k) {
+		if (stmts[k].t)
+			countLocals(stmts[k].t, 1 << std::min(depth[k] * 3, 15), uses, taken);
+	}
+	countLocals(cleanup, 1, uses, taken);
+
+	std::vector<std::pair<int, int>> best; //-uses, offset
+	std::map<int, int>::iterator     it;
+	for (it = uses.begin(); it != uses.end(); ++it) {
+		if (it->second >= MIN_USES && !taken.count(it->first))
+			best.push_back(std::make_pair(-it->second, it->first));
+	}
+	std::sort(best.begin(), best.end());
+	if (best.size() > MAX_PINNED)
+		best.resize(MAX_PINNED);
+	if (best.empty())
+		return;
+
+	std::map<int, int> regOf;
+	for (int k = 0; k < best.size(); ++k) {
+		int reg = NUM_REGS - k, offset = best[k].second;
+		regOf[offset] = reg;
+		//params arrive on the stack
+		if (offset > 0)
+			fn.code.push_back(CodeInst(OP_MOV, Operand::reg32(regNums[reg]), Operand::memory(5, offset)));
+	}
+	fn.numRegs = NUM_REGS - best.size();
+
+	for (int k = 0; k < stmts.size(); ++k)
+		stmts[k].t = pinLocals(stmts[k].t, regOf);
+	cleanup = pinLocals(cleanup, regOf);
+}
+
+///////////////////////////////////////
+// Peephole pass over the tiled code //
+///////////////////////////////////////
+
+static bool isInst(const CodeInst& i, int op)
+{
+	return i.kind == CodeInst::INST && i.op == op;
+}
+
+//windowed rewrites, until nothing changes
+static void rewrite(std::vector<CodeInst>& code, std::vector<CodeInst>& removed, std::vector<CodeInst>& added)
+{
+	std::vector<CodeInst> out;
+	for (bool changed = true; changed;) {
+		changed = false;
+		out.clear();
+		for (size_t k = 0; k < code.size(); ++k) {
+			const CodeInst& s = code[k];
+			const CodeInst* t = k + 1 < code.size() ? &code[k + 1] : 0;
+
+			if (isInst(s, OP_MOV) && s.l == s.r) {
+				//mov eax,eax
+				removed.push_back(s);
+				changed = true;
+				continue;
+			}
+			if (isInst(s, OP_MOV) && t && isInst(*t, OP_MOV)) {
+				if (t->l == s.r && t->r == s.l) {
+					//mov [ebp-4],eax / mov eax,[ebp-4]
+					out.push_back(s);
+					removed.push_back(code[++k]);
+					changed = true;
+					continue;
+				}
+				if (s.l.isMem() && t->r == s.l && !s.r.isMem()) {
+					//mov [ebp-4],eax / mov ecx,[ebp-4]
+					CodeInst i(OP_MOV, t->l, s.r);
+					out.push_back(s);
+					out.push_back(i);
+					removed.push_back(code[++k]);
+					added.push_back(i);
+					changed = true;
+					continue;
+				}
+				if (s.l.isReg() && t->l == s.l && !t->r.uses(s.l.reg)) {
+					//mov eax,1 / mov eax,2
+					removed.push_back(s);
+					changed = true;
+					continue;
+				}
+			}
+			if (isInst(s, OP_PUSH) && t && isInst(*t, OP_POP) && s.l.isReg() && t->l.isReg()) {
+				//push eax / pop ecx
+				removed.push_back(s);
+				removed.push_back(code[++k]);
+				if (s.l != code[k].l) {
+					CodeInst i(OP_MOV, code[k].l, s.l);
+					out.push_back(i);
+					added.push_back(i);
+				}
+				changed = true;
+				continue;
+			}
+			if (s.kind == CodeInst::ESP && s.l.imm == -4 && t && isInst(*t, OP_MOV) && t->l == m_esp &&
+				!t->r.isMem() && !t->r.uses(4)) {
+				//sub esp,4 / mov [esp],eax
+				CodeInst i(OP_PUSH, t->r);
+				out.push_back(i);
+				removed.push_back(fixEsp(-4));
+				removed.push_back(code[++k]);
+				added.push_back(i);
+				changed = true;
+				continue;
+			}
+			if (isInst(s, OP_JMP) && s.l.immLabel.size()) {
+				//jmp to a label just after
+				size_t n = k + 1;
+				while (n < code.size() && code[n].kind == CodeInst::LABEL && code[n].label != s.l.immLabel)
+					++n;
+				if (n < code.size() && code[n].kind == CodeInst::LABEL) {
+					removed.push_back(s);
+					changed = true;
+					continue;
+				}
+			}
+			out.push_back(s);
+		}
+		code.swap(out);
+	}
+
+	//esp is restored from ebp at the end anyway
+	int esp_off = 0;
+	while (code.size() && code.back().kind == CodeInst::ESP) {
+		esp_off += code.back().l.imm;
+		code.pop_back();
+	}
+	if (esp_off)
+		removed.push_back(fixEsp(esp_off));
+}
+
+//params are addressed from ebp, above the callee saved regs - so any regs that
+//aren't pushed move the params down
+static void moveParam(Operand& o, int gap)
+{
+	if (o.isMem() && o.baseReg == 5 && o.offset >= 20)
+		o.offset -= gap;
+}
+
+static void moveParams(std::vector<CodeInst>& code, int gap)
+{
+	for (size_t k = 0; k < code.size(); ++k) {
+		moveParam(code[k].l, gap);
+		moveParam(code[k].r, gap);
+	}
+}
+
+static int measure(const std::vector<CodeInst>& code)
+{
+	int n = 0;
+	for (size_t k = 0; k < code.size(); ++k)
+		n += Assem_x86::measure(code[k].op, code[k].l, code[k].r, code[k].cc);
+	return n;
+}
+
+void Codegen_x86::peephole()
+{
+	std::vector<CodeInst> removed, added;
+	rewrite(fn.code, removed, added);
+
+	//only push the callee saved regs that are used - the debugger expects them all
+	fn.saved = 0;
+	int gap  = 0;
+	for (int k = 0; k < 3; ++k) {
+		int  r    = regNums[calleeSaved[k]];
+		bool used = debug;
+		for (size_t n = 0; n < fn.code.size() && !used; ++n) {
+			const CodeInst& i = fn.code[n];
+			used              = i.kind == CodeInst::INST && (i.l.uses(r) || i.r.uses(r));
+		}
+		if (used) {
+			fn.saved |= 1 << calleeSaved[k];
+		} else {
+			removed.push_back(CodeInst(OP_PUSH, r_saved[k]));
+			removed.push_back(CodeInst(OP_POP, r_saved[k]));
+			gap += 4;
+		}
+	}
+	if (gap)
+		moveParams(fn.code, gap);
+
+	if (peep) {
+		peep->insts += removed.size() - added.size();
+		peep->bytes += measure(removed) - measure(added);
+	}
+}
+
+Tile* Codegen_x86::genCompare(TNode* t, int& cc, bool negate)
 {
 	switch (t->op) {
 	case IR_SETEQ:
-		func = negate ? "nz" : "z";
+		cc = CC_Z;
 		break;
 	case IR_SETNE:
-		func = negate ? "z" : "nz";
+		cc = CC_NZ;
 		break;
 	case IR_SETLT:
-		func = negate ? "ge" : "l";
+		cc = CC_L;
 		break;
 	case IR_SETGT:
-		func = negate ? "le" : "g";
+		cc = CC_G;
 		break;
 	case IR_SETLE:
-		func = negate ? "g" : "le";
+		cc = CC_LE;
 		break;
 	case IR_SETGE:
-		func = negate ? "l" : "ge";
+		cc = CC_GE;
 		break;
 	default:
 		return 0;
 	}
+	if (negate)
+		cc ^= 1;
 
-	std::string q, m, c;
-	TNode *ql = 0, *qr = 0;
+	Operand m, c;
+	Arg     a, b;
+	TNode * ql = 0, *qr = 0;
 
 	if (matchMEM(t->l, m)) {
+		a = m;
 		if (matchCONST(t->r, c)) {
-			q = "\tcmp\t" + m + "," + c + "\n";
+			b = c;
 		} else {
-			q  = "\tcmp\t" + m + ",%l\n";
+			b  = l_reg;
 			ql = t->r;
 		}
 	} else {
 		if (matchMEMCONST(t->r, m)) {
-			q  = "\tcmp\t%l," + m + "\n";
+			a  = l_reg;
+			b  = m;
 			ql = t->l;
 		} else {
-			q  = "\tcmp\t%l,%r\n";
+			a  = l_reg;
+			b  = r_reg;
 			ql = t->l;
 			qr = t->r;
 		}
 	}
 
-	return new Tile(q, ql ? munchReg(ql) : 0, qr ? munchReg(qr) : 0);
+	return (new Tile(ql ? munchReg(ql) : 0, qr ? munchReg(qr) : 0))->add(OP_CMP, a, b);
 }
 
 ////////////////////////////////////////////////
@@ -275,34 +774,34 @@ Tile* Codegen_x86::genCompare(TNode* t, std::string& func, bool negate)
 ////////////////////////////////////////////////
 Tile* Codegen_x86::munchUnary(TNode* t)
 {
-	std::string s;
+	int op;
 	switch (t->op) {
 	case IR_NEG:
-		s = "\tneg\t%l\n";
+		op = OP_NEG;
 		break;
 	default:
 		return 0;
 	}
-	return new Tile(s, munchReg(t->l));
+	return (new Tile(munchReg(t->l)))->add(op, l_reg);
 }
 
 Tile* Codegen_x86::munchLogical(TNode* t)
 {
-	std::string s;
+	int op;
 	switch (t->op) {
 	case IR_AND:
-		s = "\tand\t%l,%r\n";
+		op = OP_AND;
 		break;
 	case IR_OR:
-		s = "\tor\t%l,%r\n";
+		op = OP_OR;
 		break;
 	case IR_XOR:
-		s = "\txor\t%l,%r\n";
+		op = OP_XOR;
 		break;
 	default:
 		return 0;
 	}
-	return new Tile(s, munchReg(t->l), munchReg(t->r));
+	return (new Tile(munchReg(t->l), munchReg(t->r)))->add(op, l_reg, r_reg);
 }
 
 Tile* Codegen_x86::munchArith(TNode* t)
@@ -311,10 +810,18 @@ Tile* Codegen_x86::munchArith(TNode* t)
 		int shift;
 		if (t->r->op == IR_CONST) {
 			if (getShift(t->r->iconst, shift)) {
-				return new Tile("\tsar\t%l,byte " + itoa(shift) + "\n", munchReg(t->l));
+				return (new Tile(munchReg(t->l)))->add(OP_SAR, l_reg, Operand::immediate(shift, 1));
 			}
 		}
-		Tile* q   = new Tile("\tcdq\n\tidiv\tecx\n", munchReg(t->l), munchReg(t->r));
+		Tile* q   = (new Tile(munchReg(t->l), munchReg(t->r)))->add(OP_CDQ)->add(OP_IDIV, r_ecx);
+		q->want_l = EAX;
+		q->want_r = ECX;
+		q->hits   = 1 << EDX;
+		return q;
+	}
+
+	if (t->op == IR_MULHI) {
+		Tile* q   = (new Tile(munchReg(t->l), munchReg(t->r)))->add(OP_IMUL, r_ecx)->add(OP_MOV, r_eax, r_edx);
 		q->want_l = EAX;
 		q->want_r = ECX;
 		q->hits   = 1 << EDX;
@@ -325,71 +832,73 @@ Tile* Codegen_x86::munchArith(TNode* t)
 		int shift;
 		if (t->r->op == IR_CONST) {
 			if (getShift(t->r->iconst, shift)) {
-				return new Tile("\tshl\t%l,byte " + itoa(shift) + "\n", munchReg(t->l));
+				return (new Tile(munchReg(t->l)))->add(OP_SHL, l_reg, Operand::immediate(shift, 1));
 			}
 		} else if (t->l->op == IR_CONST) {
 			if (getShift(t->l->iconst, shift)) {
-				return new Tile("\tshl\t%l,byte " + itoa(shift) + "\n", munchReg(t->r));
+				return (new Tile(munchReg(t->r)))->add(OP_SHL, l_reg, Operand::immediate(shift, 1));
 			}
 		}
 	}
 
-	std::string s, op;
+	int op;
 	switch (t->op) {
 	case IR_ADD:
-		op = "\tadd\t";
+		op = OP_ADD;
 		break;
 	case IR_SUB:
-		op = "\tsub\t";
+		op = OP_SUB;
 		break;
 	case IR_MUL:
-		op = "\timul\t";
+		op = OP_IMUL;
 		break;
 	default:
 		return 0;
 	}
 
+	Operand s;
 	if (matchMEMCONST(t->r, s)) {
-		return new Tile(op + "%l," + s + "\n", munchReg(t->l));
+		return (new Tile(munchReg(t->l)))->add(op, l_reg, s);
 	}
 	if (t->op != IR_SUB && matchMEMCONST(t->l, s)) {
-		return new Tile(op + "%l," + s + "\n", munchReg(t->r));
+		return (new Tile(munchReg(t->r)))->add(op, l_reg, s);
 	}
-	return new Tile(op + "%l,%r\n", munchReg(t->l), munchReg(t->r));
+	return (new Tile(munchReg(t->l), munchReg(t->r)))->add(op, l_reg, r_reg);
 }
 
 Tile* Codegen_x86::munchShift(TNode* t)
 {
-	std::string s, op;
+	int op;
 	switch (t->op) {
 	case IR_SHL:
-		op = "\tshl\t";
+		op = OP_SHL;
 		break;
 	case IR_SHR:
-		op = "\tshr\t";
+		op = OP_SHR;
 		break;
 	case IR_SAR:
-		op = "\tsar\t";
+		op = OP_SAR;
 		break;
 	default:
 		return 0;
 	}
 
-	if (matchCONST(t->r, s)) {
-		return new Tile(op + "%l,byte " + s + "\n", munchReg(t->l));
+	Operand s;
+	if (t->r->op == IR_CONST && matchCONST(t->r, s)) {
+		return (new Tile(munchReg(t->l)))->add(op, l_reg, Operand::immediate(s.imm, 1));
 	}
 
-	Tile* q   = new Tile(op + "%l,cl\n", munchReg(t->l), munchReg(t->r));
+	Tile* q   = (new Tile(munchReg(t->l), munchReg(t->r)))->add(op, l_reg, r_cl);
 	q->want_r = ECX;
 	return q;
 }
 
 Tile* Codegen_x86::munchRelop(TNode* t)
 {
-	std::string func;
-	Tile*  q = genCompare(t, func, false);
+	int   cc;
+	Tile* q = genCompare(t, cc, false);
 
-	q         = new Tile("\tset" + func + "\tal\n\tmovzx\teax,al\n", q);
+	q         = (new Tile(q))->add(OP_SETCC, r_al, Arg(), cc)->add(OP_MOVZX, r_eax, r_al);
 	q->want_l = EAX;
 	return q;
 }
@@ -399,75 +908,76 @@ Tile* Codegen_x86::munchRelop(TNode* t)
 ////////////////////////////////////////////////
 Tile* Codegen_x86::munchFPUnary(TNode* t)
 {
-	std::string s;
+	int op;
 	switch (t->op) {
 	case IR_FNEG:
-		s = "\tfchs\n";
+		op = OP_FCHS;
 		break;
 	default:
 		return 0;
 	}
-	return new Tile(s, munchFP(t->l));
+	return (new Tile(munchFP(t->l)))->add(op);
 }
 
 Tile* Codegen_x86::munchFPArith(TNode* t)
 {
-	std::string s, s2;
+	int op, op2;
 	switch (t->op) {
 	case IR_FADD:
-		s = "\tfaddp\tst(1)\n";
+		op = op2 = OP_FADDP;
 		break;
 	case IR_FMUL:
-		s = "\tfmulp\tst(1)\n";
+		op = op2 = OP_FMULP;
 		break;
 	case IR_FSUB:
-		s  = "\tfsubrp\tst(1)\n";
-		s2 = "\tfsubp\tst(1)\n";
+		op  = OP_FSUBRP;
+		op2 = OP_FSUBP;
 		break;
 	case IR_FDIV:
-		s  = "\tfdivrp\tst(1)\n";
-		s2 = "\tfdivp\tst(1)\n";
+		op  = OP_FDIVRP;
+		op2 = OP_FDIVP;
 		break;
 	default:
 		return 0;
 	}
-	return new Tile(s, s2, munchFP(t->l), munchFP(t->r));
+	return (new Tile(munchFP(t->l), munchFP(t->r)))->add(op, st_1)->add2(op2, st_1);
 }
 
 Tile* Codegen_x86::munchFPRelop(TNode* t)
 {
-	std::string s, s2;
+	int cc, cc2;
 	switch (t->op) {
 	case IR_FSETEQ:
-		s  = "z";
-		s2 = "z";
+		cc  = CC_Z;
+		cc2 = CC_Z;
 		break;
 	case IR_FSETNE:
-		s  = "nz";
-		s2 = "nz";
+		cc  = CC_NZ;
+		cc2 = CC_NZ;
 		break;
 	case IR_FSETLT:
-		s  = "b";
-		s2 = "a";
+		cc  = CC_B;
+		cc2 = CC_A;
 		break;
 	case IR_FSETGT:
-		s  = "a";
-		s2 = "b";
+		cc  = CC_A;
+		cc2 = CC_B;
 		break;
 	case IR_FSETLE:
-		s  = "be";
-		s2 = "ae";
+		cc  = CC_BE;
+		cc2 = CC_AE;
 		break;
 	case IR_FSETGE:
-		s  = "ae";
-		s2 = "be";
+		cc  = CC_AE;
+		cc2 = CC_BE;
 		break;
 	default:
 		return 0;
 	}
-	s         = "\tfucompp\n\tfnstsw\tax\n\tsahf\n\tset" + s + "\tal\n\tmovzx\t%l,al\n";
-	s2        = "\tfucompp\n\tfnstsw\tax\n\tsahf\n\tset" + s2 + "\tal\n\tmovzx\t%l,al\n";
-	Tile* q   = new Tile(s, s2, munchFP(t->l), munchFP(t->r));
+	Tile* q = new Tile(munchFP(t->l), munchFP(t->r));
+	q->add(OP_FUCOMPP)->add(OP_FNSTSW, r_ax)->add(OP_SAHF)->add(OP_SETCC, r_al, Arg(), cc)->add(OP_MOVZX, l_reg, r_al);
+	q->add2(OP_FUCOMPP)->add2(OP_FNSTSW, r_ax)->add2(OP_SAHF)->add2(OP_SETCC, r_al, Arg(), cc2);
+	q->add2(OP_MOVZX, l_reg, r_al);
 	q->want_l = EAX;
 	return q;
 }
@@ -475,17 +985,55 @@ Tile* Codegen_x86::munchFPRelop(TNode* t)
 ///////////////////////////
 // Generic Call handling //
 ///////////////////////////
+//user functions take their first args in ecx and edx
+static const int argRegs[REG_ARGS] = {ECX, EDX};
+
+//the stack args - the register args are picked out to be tiled with the call
+Tile* Codegen_x86::munchArgs(TNode* t, TNode** regArgs)
+{
+	if (!t)
+		return 0;
+	if (t->op == IR_MOVE && t->r->op == IR_REGARG) {
+		regArgs[t->r->iconst] = t->l;
+		return 0;
+	}
+	if (t->op != IR_SEQ)
+		return munch(t);
+	Tile *l = munchArgs(t->l, regArgs), *r = munchArgs(t->r, regArgs);
+	if (!l || !r)
+		return l ? l : r;
+	return new Tile(l, r);
+}
+
 Tile* Codegen_x86::munchCall(TNode* t)
 {
+	TNode* regArgs[REG_ARGS] = {0};
+	Tile*  args              = munchArgs(t->r, regArgs);
+
 	Tile* q;
-	if (t->l->op == IR_GLOBAL) {
-		q = new Tile("\tcall\t" + t->l->sconst + "\n", t->r ? munchReg(t->r) : 0);
+	if (regArgs[0]) {
+		//the result comes back in eax, so the first reg arg is moved into ecx by hand
+		Tile* a0 = munchReg(regArgs[0]);
+		if (args)
+			a0 = new Tile(a0, args);
+		if (regArgs[1]) {
+			q         = new Tile(a0, munchReg(regArgs[1]));
+			q->want_r = EDX;
+		} else {
+			q = new Tile(a0);
+		}
+		q->add(OP_MOV, r_ecx, l_reg)->add(OP_CALL, Operand::label(t->l->sconst));
+	} else if (t->l->op == IR_GLOBAL) {
+		q = (new Tile(args))->add(OP_CALL, Operand::label(t->l->sconst));
 	} else {
-		q = new Tile("\tcall\t%l\n", munchReg(t->l), t->r ? munchReg(t->r) : 0);
+		q = (new Tile(munchReg(t->l), args))->add(OP_CALL, l_reg);
 	}
 	q->argFrame = t->iconst;
+	q->popArgs  = t->sconst == "C";
 	q->want_l   = EAX;
 	q->hits     = (1 << EAX) | (1 << ECX) | (1 << EDX);
+	if (sse)
+		q->hits |= HITS_XMM;
 	return q;
 }
 
@@ -496,57 +1044,77 @@ Tile* Codegen_x86::munch(TNode* t)
 {
 	if (!t)
 		return 0;
-	Tile*  q = 0;
-	std::string s;
+	Tile*   q = 0;
+	Operand s;
 	switch (t->op) {
 	case IR_JSR:
-		q = new Tile("\tcall\t" + t->sconst + '\n');
+		q = (new Tile())->add(OP_CALL, Operand::label(t->sconst));
 		break;
 	case IR_RET:
-		q = new Tile("\tret\n");
+		q = (new Tile())->add(OP_RET);
 		break;
 	case IR_RETURN:
 		q         = munchReg(t->l);
 		q->want_l = EAX;
-		s         = "\tjmp\t" + t->sconst + '\n';
-		q         = new Tile(s, q);
+		q         = (new Tile(q))->add(OP_JMP, Operand::label(t->sconst));
 		break;
 	case IR_FRETURN:
+		if (sse) {
+			//floats are always returned in st(0)
+			q = new Tile(munchSSE(t->l));
+			q->add(OP_PUSH, l_reg)->add(OP_MOVSS, m_esp, l_xmm)->add(OP_FLD, m_esp)->add(OP_POP, l_reg);
+			q->add(OP_JMP, Operand::label(t->sconst));
+			break;
+		}
 		q = munchFP(t->l);
-		s = "\tjmp\t" + t->sconst + '\n';
-		q = new Tile(s, q);
+		q = (new Tile(q))->add(OP_JMP, Operand::label(t->sconst));
 		break;
 	case IR_CALL:
 		q = munchCall(t);
 		break;
 	case IR_JUMP:
-		q = new Tile("\tjmp\t" + t->sconst + '\n');
+		q = (new Tile())->add(OP_JMP, Operand::label(t->sconst));
 		break;
 	case IR_JUMPT:
 		if (TNode* p = t->l) {
 			bool neg = false;
+			int  cc;
 			if (isRelop(p->op)) {
-				std::string func;
-				q = genCompare(p, func, neg);
-				q = new Tile("\tj" + func + "\t" + t->sconst + "\n", q);
+				q = genCompare(p, cc, neg);
+				q = (new Tile(q))->add(OP_JCC, Operand::label(t->sconst), Arg(), cc);
+			} else if (sse && isFPRelop(p->op)) {
+				q = genSSECompare(p, cc, neg);
+				q = (new Tile(q))->add(OP_JCC, Operand::label(t->sconst), Arg(), cc);
 			}
 		}
 		break;
 	case IR_JUMPF:
 		if (TNode* p = t->l) {
 			bool neg = true;
+			int  cc;
 			if (isRelop(p->op)) {
-				std::string func;
-				q = genCompare(p, func, neg);
-				q = new Tile("\tj" + func + "\t" + t->sconst + "\n", q);
+				q = genCompare(p, cc, neg);
+				q = (new Tile(q))->add(OP_JCC, Operand::label(t->sconst), Arg(), cc);
+			} else if (sse && isFPRelop(p->op)) {
+				q = genSSECompare(p, cc, neg);
+				q = (new Tile(q))->add(OP_JCC, Operand::label(t->sconst), Arg(), cc);
 			}
 		}
 		break;
 	case IR_MOVE:
+		if (t->l->op == IR_REGARG) {
+			//a register param, stored on entry
+			Operand r = Operand::reg32(regNums[argRegs[t->l->iconst]]);
+			if (matchMEM(t->r, s))
+				q = (new Tile())->add(OP_MOV, s, r);
+			else
+				q = (new Tile(munchReg(t->r->l)))->add(OP_MOV, Arg::memory(REG_L, 0), r);
+			break;
+		}
 		if (matchMEM(t->r, s)) {
-			std::string c;
-			if (matchCONST(t->l, c)) {
-				q = new Tile("\tmov\t" + s + "," + c + "\n");
+			Operand c;
+			if (matchCONST(t->l, c) || (t->l->op == IR_REG && matchMEM(t->l, c))) {
+				q = (new Tile())->add(OP_MOV, s, c);
 			} else if (t->l->op == IR_ADD || t->l->op == IR_SUB) {
 				TNode* p = 0;
 				if (nodesEqual(t->l->l, t->r))
@@ -554,24 +1122,20 @@ Tile* Codegen_x86::munch(TNode* t)
 				else if (t->l->op == IR_ADD && nodesEqual(t->l->r, t->r))
 					p = t->l->l;
 				if (p) {
-					std::string c, op;
-					switch (t->l->op) {
-					case IR_ADD:
-						op = "\tadd\t";
-						break;
-					case IR_SUB:
-						op = "\tsub\t";
-						break;
-					}
+					int op = t->l->op == IR_ADD ? OP_ADD : OP_SUB;
 					if (matchCONST(p, c)) {
-						q = new Tile(op + s + "," + c + "\n");
+						q = (new Tile())->add(op, s, c);
 					} else {
-						q = new Tile(op + s + ",%l\n", munchReg(p));
+						q = (new Tile(munchReg(p)))->add(op, s, l_reg);
 					}
 				}
 			}
+			if (!q && sse && isFPOp(t->l->op)) {
+				int op = t->r->op == IR_REG ? OP_MOVD : OP_MOVSS;
+				q      = (new Tile(munchSSE(t->l)))->add(op, s, l_xmm);
+			}
 			if (!q)
-				q = new Tile("\tmov\t" + s + ",%l\n", munchReg(t->l));
+				q = (new Tile(munchReg(t->l)))->add(OP_MOV, s, l_reg);
 		}
 		break;
 	}
@@ -588,18 +1152,24 @@ Tile* Codegen_x86::munchReg(TNode* t)
 	if (!t)
 		return 0;
 
-	std::string s;
-	Tile*  q = 0;
+	Operand s;
+	Tile*   q = 0;
 
 	switch (t->op) {
 	case IR_JUMPT:
-		q = new Tile("\tand\t%l,%l\n\tjnz\t" + t->sconst + '\n', munchReg(t->l));
+		q = (new Tile(munchReg(t->l)))->add(OP_AND, l_reg, l_reg);
+		q->add(OP_JCC, Operand::label(t->sconst), Arg(), CC_NZ);
 		break;
 	case IR_JUMPF:
-		q = new Tile("\tand\t%l,%l\n\tjz\t" + t->sconst + '\n', munchReg(t->l));
+		q = (new Tile(munchReg(t->l)))->add(OP_AND, l_reg, l_reg);
+		q->add(OP_JCC, Operand::label(t->sconst), Arg(), CC_Z);
 		break;
 	case IR_JUMPGE:
-		q = new Tile("\tcmp\t%l,%r\n\tjnc\t" + t->sconst + '\n', munchReg(t->l), munchReg(t->r));
+		q = (new Tile(munchReg(t->l), munchReg(t->r)))->add(OP_CMP, l_reg, r_reg);
+		q->add(OP_JCC, Operand::label(t->sconst), Arg(), CC_AE);
+		break;
+	case IR_JUMPTABLE:
+		q = (new Tile(munchReg(t->l)))->add(OP_JMP, Arg::memory(0, 0, t->sconst, REG_L));
 		break;
 	case IR_CALL:
 		q = munchCall(t);
@@ -607,37 +1177,43 @@ Tile* Codegen_x86::munchReg(TNode* t)
 	case IR_MOVE:
 		//MUST BE MOVE TO MEM!
 		if (matchMEM(t->r, s)) {
-			q = new Tile("\tmov\t" + s + ",%l\n", munchReg(t->l));
+			q = (new Tile(munchReg(t->l)))->add(OP_MOV, s, l_reg);
 		} else if (t->r->op == IR_MEM) {
-			q = new Tile("\tmov\t[%r],%l\n", munchReg(t->l), munchReg(t->r->l));
+			q = (new Tile(munchReg(t->l), munchReg(t->r->l)))->add(OP_MOV, Arg::memory(REG_R, 0), l_reg);
 		}
 		break;
 	case IR_MEM:
 		if (matchMEM(t, s)) {
-			q = new Tile("\tmov\t%l," + s + "\n");
+			q = (new Tile())->add(OP_MOV, l_reg, s);
 		} else {
-			q = new Tile("\tmov\t%l,[%l]\n", munchReg(t->l));
+			q = (new Tile(munchReg(t->l)))->add(OP_MOV, l_reg, Arg::memory(REG_L, 0));
 		}
 		break;
 	case IR_SEQ:
-		q = new Tile("", munch(t->l), munch(t->r));
+		q = new Tile(munch(t->l), munch(t->r));
 		break;
 	case IR_ARG:
-		q = new Tile("\tlea\t%l,[esp" + itoa_sgn(t->iconst) + "]\n");
+		q = (new Tile())->add(OP_LEA, l_reg, Operand::memory(4, t->iconst));
 		break;
 	case IR_LOCAL:
-		q = new Tile("\tlea\t%l,[ebp" + itoa_sgn(t->iconst) + "]\n");
+		q = (new Tile())->add(OP_LEA, l_reg, Operand::memory(5, t->iconst));
 		break;
 	case IR_GLOBAL:
-		q = new Tile(std::string("\tmov\t%l,") + t->sconst + '\n');
+		q = (new Tile())->add(OP_MOV, l_reg, Operand::label(t->sconst));
 		break;
 	case IR_CAST:
-		q = munchFP(t->l);
-		s = "\tpush\t%l\n\tfistp\t[esp]\n\tpop\t%l\n";
-		q = new Tile(s, q);
+		if (sse) {
+			q = (new Tile(munchSSE(t->l)))->add(OP_CVTSS2SI, l_reg, l_xmm);
+			break;
+		}
+		q = new Tile(munchFP(t->l));
+		q->add(OP_PUSH, l_reg)->add(OP_FISTP, m_esp)->add(OP_POP, l_reg);
 		break;
 	case IR_CONST:
-		q = new Tile("\tmov\t%l," + itoa(t->iconst) + "\n");
+		q = (new Tile())->add(OP_MOV, l_reg, Operand::immediate(t->iconst));
+		break;
+	case IR_REG:
+		q = (new Tile())->add(OP_MOV, l_reg, Arg::reg32(t->iconst));
 		break;
 	case IR_NEG:
 		q = munchUnary(t);
@@ -651,6 +1227,7 @@ Tile* Codegen_x86::munchReg(TNode* t)
 	case IR_SUB:
 	case IR_MUL:
 	case IR_DIV:
+	case IR_MULHI:
 		q = munchArith(t);
 		break;
 	case IR_SHL:
@@ -672,14 +1249,20 @@ Tile* Codegen_x86::munchReg(TNode* t)
 	case IR_FSETGT:
 	case IR_FSETLE:
 	case IR_FSETGE:
-		q = munchFPRelop(t);
+		q = sse ? munchSSERelop(t) : munchFPRelop(t);
 		break;
 	default:
+		if (sse) {
+			q = munchSSE(t);
+			if (!q)
+				return 0;
+			q = (new Tile(q))->add(OP_MOVD, l_reg, l_xmm);
+			break;
+		}
 		q = munchFP(t);
 		if (!q)
 			return 0;
-		s = "\tpush\t%l\n\tfstp\t[esp]\n\tpop\t%l\n";
-		q = new Tile(s, q);
+		q = (new Tile(q))->add(OP_PUSH, l_reg)->add(OP_FSTP, m_esp)->add(OP_POP, l_reg);
 	}
 	return q;
 }
@@ -691,17 +1274,17 @@ Tile* Codegen_x86::munchFP(TNode* t)
 {
 	if (!t)
 		return 0;
+	if (sse)
+		return munchSSE(t);
 
-	std::string s;
-	Tile*  q = 0;
+	Tile* q = 0;
 
 	switch (t->op) {
 	case IR_FCALL:
 		q = munchCall(t);
 		break;
 	case IR_FCAST:
-		s = "\tpush\t%l\n\tfild\t[esp]\n\tpop\t%l\n";
-		q = new Tile(s, munchReg(t->l));
+		q = (new Tile(munchReg(t->l)))->add(OP_PUSH, l_reg)->add(OP_FILD, m_esp)->add(OP_POP, l_reg);
 		break;
 	case IR_FNEG:
 		q = munchFPUnary(t);
@@ -716,8 +1299,131 @@ Tile* Codegen_x86::munchFP(TNode* t)
 		q = munchReg(t);
 		if (!q)
 			return 0;
-		s = "\tpush\t%l\n\tfld\t[esp]\n\tpop\t%l\n";
-		q = new Tile(s, q);
+		q = (new Tile(q))->add(OP_PUSH, l_reg)->add(OP_FLD, m_esp)->add(OP_POP, l_reg);
+	}
+	return q;
+}
+
+/////////////////////////////////////////////////////
+// Float expressions returned in an xmm reg (-sse) //
+/////////////////////////////////////////////////////
+Tile* Codegen_x86::genSSECompare(TNode* t, int& cc, bool negate)
+{
+	switch (t->op) {
+	case IR_FSETEQ:
+		cc = CC_Z;
+		break;
+	case IR_FSETNE:
+		cc = CC_NZ;
+		break;
+	case IR_FSETLT:
+		cc = CC_B;
+		break;
+	case IR_FSETGT:
+		cc = CC_A;
+		break;
+	case IR_FSETLE:
+		cc = CC_BE;
+		break;
+	case IR_FSETGE:
+		cc = CC_AE;
+		break;
+	default:
+		return 0;
+	}
+	if (negate)
+		cc ^= 1;
+
+	Operand m;
+	if (t->r->op == IR_MEM && matchMEM(t->r, m))
+		return (new Tile(munchSSE(t->l)))->add(OP_UCOMISS, l_xmm, m);
+	return (new Tile(munchSSE(t->l), munchSSE(t->r)))->add(OP_UCOMISS, l_xmm, r_xmm);
+}
+
+Tile* Codegen_x86::munchSSERelop(TNode* t)
+{
+	int   cc;
+	Tile* q = genSSECompare(t, cc, false);
+
+	q         = (new Tile(q))->add(OP_SETCC, r_al, Arg(), cc)->add(OP_MOVZX, r_eax, r_al);
+	q->want_l = EAX;
+	return q;
+}
+
+Tile* Codegen_x86::munchSSEArith(TNode* t)
+{
+	int op;
+	switch (t->op) {
+	case IR_FADD:
+		op = OP_ADDSS;
+		break;
+	case IR_FSUB:
+		op = OP_SUBSS;
+		break;
+	case IR_FMUL:
+		op = OP_MULSS;
+		break;
+	case IR_FDIV:
+		op = OP_DIVSS;
+		break;
+	default:
+		return 0;
+	}
+
+	Operand m;
+	if (t->r->op == IR_MEM && matchMEM(t->r, m))
+		return (new Tile(munchSSE(t->l)))->add(op, l_xmm, m);
+	if ((t->op == IR_FADD || t->op == IR_FMUL) && t->l->op == IR_MEM && matchMEM(t->l, m))
+		return (new Tile(munchSSE(t->r)))->add(op, l_xmm, m);
+	return (new Tile(munchSSE(t->l), munchSSE(t->r)))->add(op, l_xmm, r_xmm);
+}
+
+Tile* Codegen_x86::munchSSE(TNode* t)
+{
+	if (!t)
+		return 0;
+
+	Operand s;
+	Tile*   q = 0;
+
+	switch (t->op) {
+	case IR_FCALL:
+		//result comes back in st(0)
+		q = new Tile(munchCall(t));
+		q->add(OP_PUSH, l_reg)->add(OP_FSTP, m_esp)->add(OP_MOVSS, l_xmm, m_esp)->add(OP_POP, l_reg);
+		break;
+	case IR_FCAST:
+		if (t->l->op == IR_MEM && matchMEM(t->l, s))
+			q = (new Tile())->add(OP_CVTSI2SS, l_xmm, s);
+		else
+			q = (new Tile(munchReg(t->l)))->add(OP_CVTSI2SS, l_xmm, l_reg);
+		break;
+	case IR_FNEG:
+		q = new Tile(munchSSE(t->l));
+		q->add(OP_MOVD, l_reg, l_xmm)->add(OP_XOR, l_reg, Operand::immediate(int(0x80000000)));
+		q->add(OP_MOVD, l_xmm, l_reg);
+		break;
+	case IR_FADD:
+	case IR_FSUB:
+	case IR_FMUL:
+	case IR_FDIV:
+		q = munchSSEArith(t);
+		break;
+	case IR_REG:
+		q = (new Tile())->add(OP_MOVD, l_xmm, Arg::reg32(t->iconst));
+		break;
+	case IR_MEM:
+		if (matchMEM(t, s)) {
+			q = (new Tile())->add(OP_MOVSS, l_xmm, s);
+			break;
+		}
+		//fall through
+	default:
+		q = munchReg(t);
+		if (!q)
+			return 0;
+		q = (new Tile(q))->add(OP_MOVD, l_xmm, l_reg);
 	}
+	q->fp = true;
 	return q;
 }
@@ -1,13 +1,25 @@
 #pragma once
+#include "../codecache.hpp"
 #include "../codegen.hpp"
+#include "tile.hpp"
+#include <atomic>
 #include <ostream>
 #include <string>
+#include <vector>
 
-struct Tile;
+class Assem_x86;
+
+//what the peephole pass and prologue shrink wrapping took out, over all functions
+struct PeepholeStats {
+	std::atomic<int> insts, bytes;
+	PeepholeStats() : insts(0), bytes(0) {}
+};
 
 class Codegen_x86 : public Codegen {
 	public:
 	Codegen_x86(std::ostream& out, bool debug);
+	//binary mode - code is fed straight to assem, out is not written to.
+	Codegen_x86(std::ostream& out, bool debug, Assem_x86* assem);
 
 	virtual void enter(const std::string& l, int frameSize);
 	virtual void code(TNode* code);
@@ -19,16 +31,54 @@ class Codegen_x86 : public Codegen {
 	virtual void align_data(int n);
 	virtual void flush();
 
+	//floats go in xmm regs with SSE scalar code instead of on the x87 stack.
+	//they're still returned from functions in st(0).
+	bool sse;
+
+	//if set, peephole savings are added up here
+	PeepholeStats* peep;
+
+	virtual bool     record(CodeFunc& f);
+	virtual bool     replay(const CodeFunc& f);
+	virtual Codegen* fork();
+
 	private:
-	bool inCode;
+	bool       inCode, worker;
+	Assem_x86* assem;
+	FuncState  fn;
+
+	//data fragments for text mode
+	std::vector<std::string> dataFrags;
 
-	Tile* genCompare(TNode* t, std::string& func, bool negate);
+	//data fragments for binary mode
+	std::vector<CodeData> binData;
+
+	//statements of the current function - they're tiled once it's left, so
+	//locals can be given registers for the whole function
+	struct Stmt {
+		TNode*      t; //0 for a label
+		std::string label;
+	};
+	std::vector<Stmt> stmts;
+
+	//the last function, for the code cache
+	CodeFunc lastFunc;
+	int      funcData;
+
+	void allocRegs(TNode*& cleanup);
+	void peephole();
+	void tile(TNode* t, bool ret);
+	void emitCode(int pop_sz);
+	void emitData();
+
+	Tile* genCompare(TNode* t, int& cc, bool negate);
 
 	Tile* munch(TNode* t);    //munch and discard result
 	Tile* munchReg(TNode* t); //munch and put result in a CPU reg
 	Tile* munchFP(TNode* t);  //munch and put result on FP stack
 
 	Tile* munchCall(TNode* t);
+	Tile* munchArgs(TNode* t, TNode** regArgs);
 	Tile* munchUnary(TNode* t);
 	Tile* munchLogical(TNode* t);
 	Tile* munchArith(TNode* t);
@@ -37,4 +87,9 @@ class Codegen_x86 : public Codegen {
 	Tile* munchFPUnary(TNode* t);
 	Tile* munchFPArith(TNode* t);
 	Tile* munchFPRelop(TNode* t);
+
+	Tile* genSSECompare(TNode* t, int& cc, bool negate);
+	Tile* munchSSE(TNode* t); //munch and put result in an xmm reg
+	Tile* munchSSEArith(TNode* t);
+	Tile* munchSSERelop(TNode* t);
 };
\ No newline at end of file
@@ -1,36 +1,59 @@
 #include "tile.hpp"
+#include <algorithm>
 #include <string>
 #include <vector>
 #include "codegen_x86.hpp"
+#include "../assem_x86/assem_x86.hpp"
 
 #include <stdutil.hpp>
 
 //reduce to 3 for stress test
 
-const std::string regs[] = {"???", "eax", "ecx", "edx", "edi", "esi", "ebx"};
+const int regNums[] = {-1, 0, 1, 2, 7, 6, 3}; //eax, ecx, edx, edi, esi, ebx
 
-//array of 'used' flags
-bool regUsed[NUM_REGS + 1];
+static const Operand r_esp = Operand::reg32(4);
 
-//size of locals in function
-int frameSize, maxFrameSize;
+static std::atomic<int>  tilesMade;
+thread_local ThreadCount Tile::created(tilesMade);
 
-//code fragments
-std::vector<std::string> codeFrags, dataFrags;
+static thread_local pool<Tile> tilePool;
 
-//name of function
-std::string funcLabel;
+void* Tile::operator new(size_t sz)
+{
+	return tilePool.allocate();
+}
+
+void Tile::operator delete(void* p)
+{
+	if (p)
+		tilePool.deallocate(p);
+}
+
+bool Tile::releasePool()
+{
+	return tilePool.clear();
+}
+
+void Tile::resetPool()
+{
+	tilePool.reset();
+}
+
+FuncState::FuncState() : numRegs(NUM_REGS), frameSize(0), maxFrameSize(0), saved(0)
+{
+	resetRegs();
+}
 
-void resetRegs()
+void FuncState::resetRegs()
 {
 	for (int n = 1; n <= NUM_REGS; ++n)
-		regUsed[n] = false;
+		regUsed[n] = regFP[n] = false;
 }
 
-int allocReg(int n)
+int FuncState::allocReg(int n)
 {
 	if (!n || regUsed[n]) {
-		for (n = NUM_REGS; n >= 1 && regUsed[n]; --n) {
+		for (n = numRegs; n >= 1 && regUsed[n]; --n) {
 		}
 		if (!n)
 			return 0;
@@ -39,58 +62,96 @@ int allocReg(int n)
 	return n;
 }
 
-static void freeReg(int n)
+void FuncState::freeReg(int n)
 {
 	regUsed[n] = false;
 }
 
-static void pushReg(int n)
+static Operand reg(int n, bool fp)
+{
+	return fp ? Operand::xmm(n - 1) : Operand::reg32(regNums[n]);
+}
+
+void FuncState::pushReg(int n)
 {
 	frameSize += 4;
 	if (frameSize > maxFrameSize)
 		maxFrameSize = frameSize;
-	char buff[32];
-	_itoa(frameSize, buff, 10);
-	std::string s = "\tmov\t[ebp-";
-	s += buff;
-	s += "],";
-	s += regs[n];
-	s += '\n';
-	codeFrags.push_back(s);
-}
-
-static void popReg(int n)
-{
-	char buff[32];
-	_itoa(frameSize, buff, 10);
-	std::string s = "\tmov\t";
-	s += regs[n];
-	s += ",[ebp-";
-	s += buff;
-	s += "]\n";
-	codeFrags.push_back(s);
+	code.push_back(CodeInst(regFP[n] ? OP_MOVSS : OP_MOV, Operand::memory(5, -frameSize), reg(n, regFP[n])));
+}
+
+void FuncState::popReg(int n)
+{
+	code.push_back(CodeInst(regFP[n] ? OP_MOVSS : OP_MOV, reg(n, regFP[n]), Operand::memory(5, -frameSize)));
 	frameSize -= 4;
 }
 
-static void moveReg(int d, int s)
+void FuncState::moveReg(int d, int s)
 {
-	std::string t = "\tmov\t" + regs[d] + ',' + regs[s] + '\n';
-	codeFrags.push_back(t);
+	code.push_back(CodeInst(regFP[s] ? OP_MOVSS : OP_MOV, reg(d, regFP[s]), reg(s, regFP[s])));
+	regFP[d] = regFP[s];
 }
 
-static void swapRegs(int d, int s)
+void FuncState::swapRegs(int d, int s)
 {
-	std::string t = "\txchg\t" + regs[d] + ',' + regs[s] + '\n';
-	codeFrags.push_back(t);
+	code.push_back(CodeInst(OP_XCHG, reg(d, false), reg(s, false)));
+	if (regFP[d] || regFP[s]) {
+		//no xchg for xmm regs
+		code.push_back(CodeInst(OP_XORPS, reg(d, true), reg(s, true)));
+		code.push_back(CodeInst(OP_XORPS, reg(s, true), reg(d, true)));
+		code.push_back(CodeInst(OP_XORPS, reg(d, true), reg(s, true)));
+	}
+	std::swap(regFP[d], regFP[s]);
 }
 
-Tile::Tile(const std::string& a, Tile* l, Tile* r)
-	: assem(a), l(l), r(r), want_l(0), want_r(0), hits(0), need(0), argFrame(0)
-{}
+Arg Arg::reg32(int r)
+{
+	Arg a;
+	a.kind = REG;
+	a.reg  = r;
+	return a;
+}
 
-Tile::Tile(const std::string& a, const std::string& a2, Tile* l, Tile* r)
-	: assem(a), assem2(a2), l(l), r(r), want_l(0), want_r(0), hits(0), need(0), argFrame(0)
-{}
+Arg Arg::xmm(int r)
+{
+	Arg a;
+	a.kind = XMM;
+	a.reg  = r;
+	return a;
+}
+
+Arg Arg::memory(int base, int offset, const std::string& l, int index)
+{
+	Arg a;
+	a.kind   = MEM;
+	a.reg    = base;
+	a.index  = index;
+	a.offset = offset;
+	a.label  = l;
+	return a;
+}
+
+Operand Arg::operand(int l, int r) const
+{
+	int n = reg == REG_L ? l : (reg == REG_R ? r : reg);
+	switch (kind) {
+	case REG:
+		return Operand::reg32(regNums[n]);
+	case XMM:
+		return Operand::xmm(n - 1);
+	case MEM: {
+		int i = index == REG_L ? l : (index == REG_R ? r : index);
+		return Operand::memory(n ? regNums[n] : -1, offset, label, i ? regNums[i] : -1, 2);
+	}
+	}
+	return fixed;
+}
+
+Tile::Tile(Tile* l, Tile* r)
+	: l(l), r(r), want_l(0), want_r(0), hits(0), need(0), argFrame(0), fp(false), popArgs(false)
+{
+	++created;
+}
 
 Tile::~Tile()
 {
@@ -98,6 +159,20 @@ Tile::~Tile()
 	delete r;
 }
 
+Tile* Tile::add(int op, const Arg& a, const Arg& b, int cc)
+{
+	TileInst i = {op, cc, a, b};
+	assem.push_back(i);
+	return this;
+}
+
+Tile* Tile::add2(int op, const Arg& a, const Arg& b, int cc)
+{
+	TileInst i = {op, cc, a, b};
+	assem2.push_back(i);
+	return this;
+}
+
 void Tile::label()
 {
 	if (!l) {
@@ -117,7 +192,7 @@ void Tile::label()
 	}
 }
 
-int Tile::eval(int want)
+int Tile::eval(FuncState& f, int want)
 {
 	//save any hit registers
 	int spill = hits;
@@ -125,12 +200,16 @@ int Tile::eval(int want)
 		spill |= 1 << want_l;
 	if (want_r)
 		spill |= 1 << want_r;
+	bool spillFP[NUM_REGS + 1];
 	if (spill) {
 		for (int n = 1; n <= NUM_REGS; ++n) {
+			if ((spill & HITS_XMM) && f.regFP[n])
+				spill |= 1 << n;
 			if (spill & (1 << n)) {
-				if (regUsed[n])
-					pushReg(n);
-				else
+				if (f.regUsed[n]) {
+					f.pushReg(n);
+					spillFP[n] = f.regFP[n];
+				} else
 					spill &= ~(1 << n);
 			}
 		}
@@ -138,38 +217,40 @@ int Tile::eval(int want)
 
 	//if tile needs an argFrame...
 	if (argFrame) {
-		codeFrags.push_back("-" + itoa(argFrame));
+		f.code.push_back(CodeInst::esp(-argFrame));
 	}
 
 	int got_l = 0, got_r = 0;
 	if (want_l)
 		want = want_l;
 
-	std::string* as = &assem;
+	std::vector<TileInst>* as = &assem;
 
 	if (!l) {
-		got_l = allocReg(want);
+		got_l = f.allocReg(want);
 	} else if (!r) {
-		got_l = l->eval(want);
+		got_l = l->eval(f, want);
 	} else {
-		if (l->need >= NUM_REGS && r->need >= NUM_REGS) {
-			got_r = r->eval(0);
-			pushReg(got_r);
-			freeReg(got_r);
-			got_l = l->eval(want);
-			got_r = allocReg(want_r);
-			popReg(got_r);
+		if (l->need >= f.numRegs && r->need >= f.numRegs) {
+			got_r = r->eval(f, 0);
+			f.pushReg(got_r);
+			f.freeReg(got_r);
+			bool fp_r = f.regFP[got_r];
+			got_l     = l->eval(f, want);
+			got_r     = f.allocReg(want_r);
+			f.regFP[got_r] = fp_r;
+			f.popReg(got_r);
 		} else if (r->need > l->need) {
-			got_r = r->eval(want_r);
-			got_l = l->eval(want);
+			got_r = r->eval(f, want_r);
+			got_l = l->eval(f, want);
 		} else {
-			got_l = l->eval(want);
-			got_r = r->eval(want_r);
+			got_l = l->eval(f, want);
+			got_r = r->eval(f, want_r);
 			if (assem2.size())
 				as = &assem2;
 		}
 		if (want_l == got_r || want_r == got_l) {
-			swapRegs(got_l, got_r);
+			f.swapRegs(got_l, got_r);
 			int t = got_l;
 			got_l = got_r;
 			got_r = t;
@@ -179,44 +260,43 @@ int Tile::eval(int want)
 	if (!want_l)
 		want_l = got_l;
 	else if (want_l != got_l)
-		moveReg(want_l, got_l);
+		f.moveReg(want_l, got_l);
 
 	if (!want_r)
 		want_r = got_r;
 	else if (want_r != got_r)
-		moveReg(want_r, got_r);
+		f.moveReg(want_r, got_r);
 
-	int i;
-	while ((i = as->find("%l")) != std::string::npos)
-		as->replace(i, 2, regs[want_l]);
-	while ((i = as->find("%r")) != std::string::npos)
-		as->replace(i, 2, regs[want_r]);
-
-	codeFrags.push_back(*as);
+	for (size_t k = 0; k < as->size(); ++k) {
+		const TileInst& i = (*as)[k];
+		f.code.push_back(CodeInst(i.op, i.l.operand(want_l, want_r), i.r.operand(want_l, want_r), i.cc));
+	}
+	f.regFP[want_l] = fp;
 
-	freeReg(got_r);
+	f.freeReg(got_r);
 	if (want_l != got_l)
-		moveReg(got_l, want_l);
+		f.moveReg(got_l, want_l);
 
-	//cleanup argFrame
-	if (argFrame) {
-		//***** Not needed for STDCALL *****
-		//		codeFrags.push_back( "+"+itoa(argFrame) );
+	//cleanup argFrame - STDCALL funcs pop their own
+	if (argFrame && popArgs) {
+		f.code.push_back(CodeInst::esp(argFrame));
 	}
 
 	//restore spilled regs
 	if (spill) {
 		for (int n = NUM_REGS; n >= 1; --n) {
-			if (spill & (1 << n))
-				popReg(n);
+			if (spill & (1 << n)) {
+				f.regFP[n] = spillFP[n];
+				f.popReg(n);
+			}
 		}
 	}
 	return got_l;
 }
 
-std::string fixEsp(int esp_off)
+CodeInst fixEsp(int esp_off)
 {
 	if (esp_off < 0)
-		return "\tsub\tesp," + itoa(-esp_off) + "\n";
-	return "\tadd\tesp," + itoa(esp_off) + "\n";
+		return CodeInst(OP_SUB, r_esp, Operand::immediate(-esp_off));
+	return CodeInst(OP_ADD, r_esp, Operand::immediate(esp_off));
 }
@@ -1,32 +1,95 @@
 #pragma once
 #include <string>
 #include <vector>
+#include "../codecache.hpp"
+#include "../counter.hpp"
 
 enum { EAX = 1, ECX, EDX, EDI, ESI, EBX };
 
-extern std::vector<std::string> codeFrags, dataFrags;
-extern std::string              funcLabel;
-extern int                      frameSize, maxFrameSize;
-const int                NUM_REGS = 6;
-extern bool                     regUsed[];
-extern const std::string        regs[];
+//the regs a tile's children are evaluated into, which eval() picks
+enum { REG_L = -1, REG_R = -2 };
 
-extern void resetRegs();
-extern int  allocReg(int n);
-extern std::string fixEsp(int esp_off);
+const int NUM_REGS = 6;
+extern const int regNums[]; //for Operand::reg32 - with -sse, reg n also has xmm reg n-1
+
+const int HITS_XMM = 1; //bit 0 of Tile::hits - every xmm reg
+
+//state of the function being generated - one per codegen, so functions can be
+//generated on several threads at once.
+struct FuncState {
+	bool                     regUsed[NUM_REGS + 1];
+	bool                     regFP[NUM_REGS + 1]; //value is a float in the matching xmm reg
+	int                      numRegs; //regs free for expressions - the rest hold locals
+	int                      frameSize, maxFrameSize; //size of locals in function
+	std::vector<CodeInst>    code;                    //code so far
+	std::string              funcLabel;               //name of function
+	int                      saved;                   //callee saved regs the prologue pushes, as 1<<reg
+
+	FuncState();
+
+	void resetRegs();
+	int  allocReg(int n);
+	void freeReg(int n);
+	void pushReg(int n);
+	void popReg(int n);
+	void moveReg(int d, int s);
+	void swapRegs(int d, int s);
+};
+
+extern CodeInst fixEsp(int esp_off);
+
+//an operand of a tile's instruction. Regs are EAX..EBX, or REG_L or REG_R - see operand().
+struct Arg {
+	enum { FIXED, REG, XMM, MEM };
+
+	int         kind;
+	int         reg;    //REG and XMM: the reg, MEM: the base reg, or 0 for none
+	int         index;  //MEM: reg scaled by 4, or 0 for none
+	int         offset; //MEM
+	std::string label;  //MEM
+	Operand     fixed;  //FIXED: the operand itself
+
+	Arg(const Operand& o = Operand()) : kind(FIXED), reg(0), index(0), offset(0), fixed(o) {}
+
+	static Arg reg32(int r);
+	static Arg xmm(int r);
+	static Arg memory(int base, int offset, const std::string& l = "", int index = 0);
+
+	//with l and r for REG_L and REG_R
+	Operand operand(int l, int r) const;
+};
+
+struct TileInst {
+	int op, cc;
+	Arg l, r;
+};
 
 struct Tile {
-	int want_l, want_r, hits, argFrame;
+	int  want_l, want_r, hits, argFrame;
+	bool fp;      //result is in an xmm reg, the one Arg::xmm(REG_L) names
+	bool popArgs; //argFrame is popped here, not by the callee
 
-	Tile(const std::string& a, Tile* l = 0, Tile* r = 0);
-	Tile(const std::string& a, const std::string& a2, Tile* l = 0, Tile* r = 0);
+	Tile(Tile* l = 0, Tile* r = 0);
 	~Tile();
 
+	//adds an instruction. add2() adds to the instructions used instead if l is evaluated before
+	//r - eg: the reversed x87 ops.
+	Tile* add(int op, const Arg& a = Arg(), const Arg& b = Arg(), int cc = -1);
+	Tile* add2(int op, const Arg& a = Arg(), const Arg& b = Arg(), int cc = -1);
+
 	void label();
-	int  eval(int want);
+	int  eval(FuncState& f, int want);
+
+	static thread_local ThreadCount created; //for -stats
+
+	//pooled per thread, like TNodes
+	static void* operator new(size_t sz);
+	static void  operator delete(void* p);
+	static bool  releasePool();
+	static void  resetPool();
 
 	private:
-	int         need;
-	Tile *      l, *r;
-	std::string assem, assem2;
+	int                   need;
+	Tile *                l, *r;
+	std::vector<TileInst> assem, assem2;
 };
@@ -0,0 +1,25 @@
+#pragma once
+#include <atomic>
+
+//a count bumped on several threads without them sharing it - declared thread_local, each
+//thread counts into its own, which is added to the shared total when the thread ends
+class ThreadCount {
+	public:
+	ThreadCount(std::atomic<int>& total) : n(0), total(total) {}
+	~ThreadCount() { total += n; }
+
+	void operator++() { ++n; }
+
+	//the threads that have ended, and this one
+	int get() const { return total + n; }
+
+	void reset()
+	{
+		total = 0;
+		n     = 0;
+	}
+
+	private:
+	int               n;
+	std::atomic<int>& total;
+};
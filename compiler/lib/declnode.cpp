@@ -1,11 +1,17 @@
 #include "decl.hpp"
+#include <algorithm>
+#include <exception>
+#include <map>
 #include "environ.hpp"
 #include "ex.hpp"
 #include "nodes.hpp"
+#include "ranges.hpp"
+#include "reach.hpp"
 #include "type.hpp"
 #include "label.hpp"
 #include "varnode.hpp"
 #include "codegen.hpp"
+#include "codecache.hpp"
 
 #include <stdutil.hpp>
 #include "declnode.hpp"
@@ -54,6 +60,8 @@ void DeclSeqNode::semant(Environ* e)
 void DeclSeqNode::translate(Codegen* g)
 {
 	for (size_t k = 0; k < decls.size(); ++k) {
+		if (!decls[k]->reached())
+			continue;
 		try {
 			decls[k]->translate(g);
 		} catch (BlitzException& x) {
@@ -92,7 +100,7 @@ int DeclSeqNode::size()
 }
 
 VarDeclNode::VarDeclNode(const std::string& i, const std::string& t, int k, bool c, ExprNode* e)
-	: ident(i), tag(t), kind(k), constant(c), expr(e), sem_var(0)
+	: ident(i), tag(t), kind(k), constant(c), expr(e), sem_decl(0), sem_var(0)
 {}
 
 VarDeclNode::~VarDeclNode()
@@ -151,8 +159,14 @@ void VarDeclNode::proto(DeclSeq* d, Environ* e)
 	Decl* decl = d->insertDecl(ident, ty, kind, defType);
 	if (!decl)
 		ex("Duplicate variable name");
-	if (expr)
+	sem_decl = decl;
+	if (expr) {
 		sem_var = new DeclVarNode(decl);
+		Ranges::write(decl);
+		//the init has to be run anyway, unless it's constant
+		if (!expr->constNode())
+			Reach::global(decl);
+	}
 }
 
 void VarDeclNode::semant(Environ* e) {}
@@ -161,18 +175,38 @@ void VarDeclNode::translate(Codegen* g)
 {
 	if (kind & DECL_GLOBAL) {
 		g->align_data(4);
-		g->i_data(0, "_v" + ident);
+		g->w_data(0, "_v" + ident);
 	}
 	if (expr)
 		g->code(sem_var->store(g, expr->translate(g)));
 }
 
+bool VarDeclNode::reached()
+{
+	return !sem_decl || Reach::reached(sem_decl);
+}
+
+//functions small enough to inline, by decl
+static std::map<Decl*, FuncDeclNode*> inlines;
+
+//the args standing in for the params of the functions being inlined - per thread, as
+//functions can be translated in parallel
+static thread_local std::map<Decl*, ExprNode*>  inlineArgs;
+static thread_local std::vector<FuncDeclNode*> expanding;
+
+static const int MAX_INLINE       = 12; //weight of the function's value
+static const int MAX_INLINE_DEPTH = 4;
+
 FuncDeclNode::FuncDeclNode(const std::string& i, const std::string& t, DeclSeqNode* p, StmtSeqNode* ss)
-	: ident(i), tag(t), params(p), stmts(ss)
+	: ident(i), tag(t), params(p), stmts(ss), sem_decl(0), sem_labels(0), sem_inline(0), sem_traps(false),
+	  sem_calls(false)
 {}
 
 FuncDeclNode::~FuncDeclNode()
 {
+	std::map<Decl*, FuncDeclNode*>::iterator it = inlines.find(sem_decl);
+	if (sem_inline && it != inlines.end() && it->second == this)
+		inlines.erase(it);
 	delete params;
 	delete stmts;
 }
@@ -188,7 +222,7 @@ void FuncDeclNode::proto(DeclSeq* d, Environ* e)
 	a_ptr<DeclSeq> decls(new DeclSeq());
 	params->proto(decls, e);
 	sem_type = new FuncType(t, decls.release(), false, false);
-	if (!d->insertDecl(ident, sem_type, DECL_FUNC)) {
+	if (!(sem_decl = d->insertDecl(ident, sem_type, DECL_FUNC))) {
 		delete sem_type;
 		ex("duplicate identifier");
 	}
@@ -197,6 +231,8 @@ void FuncDeclNode::proto(DeclSeq* d, Environ* e)
 
 void FuncDeclNode::semant(Environ* e)
 {
+	beginLabelScope(ident, 0);
+
 	sem_env        = new Environ(genLabel(), sem_type->returnType, 1, e);
 	DeclSeq* decls = sem_env->decls;
 
@@ -207,17 +243,195 @@ void FuncDeclNode::semant(Environ* e)
 			ex("duplicate identifier");
 	}
 
+	Reach::begin(sem_decl);
 	stmts->semant(sem_env);
+	Reach::end();
+
+	for (k = 0; k < sem_env->labels.size(); ++k) {
+		if (sem_env->labels[k]->def < 0)
+			ex("Undefined label", sem_env->labels[k]->ref);
+	}
+
+	sem_labels = endLabelScope();
+
+	//small enough to inline? It has to be just 'Return expr', with no locals and
+	//no params that need cleaning up.
+	ExprNode* x = stmts->returns();
+	if (!x)
+		return;
+	for (k = 0; k < decls->size(); ++k) {
+		Decl* d = decls->decls[k];
+		if (d->kind != DECL_PARAM)
+			return;
+		if (d->type != Type::int_type && d->type != Type::float_type && !d->type->structType())
+			return;
+	}
+	Weight w;
+	if (!x->weigh(w) || w.size > MAX_INLINE)
+		return;
+	sem_inline = x;
+	sem_traps  = w.traps;
+	sem_calls  = w.calls;
+	sem_used.assign(sem_type->params->size(), false);
+	for (k = 0; k < sem_used.size(); ++k)
+		sem_used[k] = std::find(w.reads.begin(), w.reads.end(), decls->decls[k]) != w.reads.end();
+	inlines[sem_decl] = this;
+}
+
+FuncDeclNode* FuncDeclNode::inlined(Decl* d)
+{
+	std::map<Decl*, FuncDeclNode*>::iterator it = inlines.find(d);
+	return it != inlines.end() ? it->second : 0;
+}
+
+ExprNode* FuncDeclNode::arg(Decl* param)
+{
+	if (!param || inlineArgs.empty())
+		return 0;
+	std::map<Decl*, ExprNode*>::iterator it = inlineArgs.find(param);
+	return it != inlineArgs.end() ? it->second : 0;
+}
+
+void FuncDeclNode::inlineFiles(std::set<std::string>& files)
+{
+	std::map<Decl*, FuncDeclNode*>::iterator it;
+	for (it = inlines.begin(); it != inlines.end(); ++it)
+		files.insert(it->second->file);
+}
+
+void FuncDeclNode::clearInlines()
+{
+	inlines.clear();
+}
+
+//a constant, or a local var - the callee can't write to the caller's locals
+static bool unchanging(ExprNode* e)
+{
+	if (CastNode* c = dynamic_cast<CastNode*>(e))
+		return unchanging(c->expr);
+	if (e->constNode())
+		return true;
+	VarExprNode* v = dynamic_cast<VarExprNode*>(e);
+	Decl*        d = v ? v->var->decl() : 0;
+	return d && (d->kind & (DECL_LOCAL | DECL_PARAM));
+}
+
+TNode* FuncDeclNode::expand(Codegen* g, ExprSeqNode* args)
+{
+	//in debug builds, runtime errors have to come from the function's own line
+	if (!sem_inline || (g->debug && sem_traps))
+		return 0;
+
+	//recursion, or too deep?
+	if (expanding.size() >= MAX_INLINE_DEPTH)
+		return 0;
+	if (std::find(expanding.begin(), expanding.end(), this) != expanding.end())
+		return 0;
+
+	//args are evaluated wherever their params are used, maybe more than once, so
+	//they mustn't have side effects. An unused arg isn't evaluated at all, so it
+	//mustn't be able to fail either, and if the body calls a function, which could
+	//change what an arg reads, the arg has to be something no call can change.
+	int n = sem_type->params->size();
+	if (args->size() != n)
+		return 0;
+	for (int k = 0; k < n; ++k) {
+		Weight w;
+		if (!args->exprs[k]->weigh(w) || w.calls || (g->debug && w.traps))
+			return 0;
+		if (w.traps && !sem_used[k])
+			return 0;
+		if (sem_calls && !unchanging(args->exprs[k]))
+			return 0;
+	}
+
+	DeclSeq* params = sem_env->decls;
+	for (int k = 0; k < n; ++k)
+		inlineArgs[params->decls[k]] = args->exprs[k];
+	expanding.push_back(this);
+
+	TNode*             t = 0;
+	std::exception_ptr x;
+	try {
+		t = sem_inline->translate(g);
+	} catch (...) {
+		x = std::current_exception();
+	}
+
+	expanding.pop_back();
+	for (int k = 0; k < n; ++k)
+		inlineArgs.erase(params->decls[k]);
+	if (x)
+		std::rethrow_exception(x);
+	return t;
 }
 
 void FuncDeclNode::translate(Codegen* g)
 {
+	//unchanged since the last build?
+	if (replay(g))
+		return;
+
+	//keep track of the user funcs this function uses
+	std::set<std::string> used;
+	used.swap(usedfuncs);
+
+	translateFunc(g);
+
+	used.swap(usedfuncs);
+	usedfuncs.insert(used.begin(), used.end());
+
+	if (g->cache) {
+		CodeFunc f;
+		if (g->record(f)) {
+			f.usedfuncs.assign(used.begin(), used.end());
+			store(g, f);
+		}
+	}
+}
+
+bool FuncDeclNode::replay(Codegen* g)
+{
+	if (!g->cache)
+		return false;
+	const CodeFunc* f = g->cache->find(file, ident);
+	if (!f || !g->replay(*f))
+		return false;
+	usedfuncs.insert(f->usedfuncs.begin(), f->usedfuncs.end());
+	return true;
+}
+
+void FuncDeclNode::store(Codegen* g, const CodeFunc& f)
+{
+	if (g->cache)
+		g->cache->insert(file, ident, f);
+}
+
+void FuncDeclNode::translateFunc(Codegen* g)
+{
+	beginLabelScope(ident, sem_labels);
+
 	//var offsets
 	int size = enumVars(sem_env);
 
 	//enter function
 	g->enter("_f" + ident, size);
 
+	//store the register params before anything can trash them
+	int pop_sz = 0;
+	for (int k = 0; k < sem_type->params->size(); ++k) {
+		int n = regArg(sem_type->params, k);
+		if (n < 0) {
+			pop_sz += word;
+			continue;
+		}
+		Decl*  d = sem_env->decls->decls[k];
+		TNode* t = move(new TNode(IR_REGARG, 0, 0, n), mem(local(d->offset)));
+		if (d->type == Type::float_type)
+			t->iconst = IR_FLOAT;
+		g->code(t);
+	}
+
 	//initialize locals
 	TNode* t = createVars(sem_env);
 	if (t)
@@ -231,17 +445,19 @@ void FuncDeclNode::translate(Codegen* g)
 	//translate statements
 	stmts->translate(g);
 
-	for (size_t k = 0; k < sem_env->labels.size(); ++k) {
-		if (sem_env->labels[k]->def < 0)
-			ex("Undefined label", sem_env->labels[k]->ref);
-	}
-
 	//leave the function
 	g->label(sem_env->funcLabel + "_leave");
 	t = deleteVars(sem_env);
 	if (g->debug)
 		t = new TNode(IR_SEQ, call("__bbDebugLeave"), t);
-	g->leave(t, sem_type->params->size() * 4);
+	g->leave(t, pop_sz);
+
+	endLabelScope();
+}
+
+bool FuncDeclNode::reached()
+{
+	return Reach::reached(sem_decl);
 }
 
 StructDeclNode::StructDeclNode(const std::string& i, DeclSeqNode* f) : ident(i), fields(f) {}
@@ -268,7 +484,7 @@ void StructDeclNode::semant(Environ* e)
 {
 	fields->proto(sem_type->fields, e);
 	for (int k = 0; k < sem_type->fields->size(); ++k)
-		sem_type->fields->decls[k]->offset = k * 4;
+		sem_type->fields->decls[k]->offset = k * word;
 }
 
 void StructDeclNode::translate(Codegen* g)
@@ -284,11 +500,11 @@ void StructDeclNode::translate(Codegen* g)
 	int k;
 	for (k = 0; k < 2; ++k) {
 		std::string lab = genLabel();
-		g->i_data(0, lab); //fields
+		g->w_data(0, lab); //fields
 		g->p_data(lab);    //next
 		g->p_data(lab);    //prev
-		g->i_data(0);      //type
-		g->i_data(-1);     //ref_cnt
+		g->w_data(0);      //type
+		g->w_data(-1);     //ref_cnt
 	}
 
 	//number of fields
@@ -313,6 +529,11 @@ void StructDeclNode::translate(Codegen* g)
 	}
 }
 
+bool StructDeclNode::reached()
+{
+	return Reach::reached(sem_type);
+}
+
 DataDeclNode::DataDeclNode(ExprNode* e) : expr(e) {}
 
 DataDeclNode::~DataDeclNode()
@@ -348,11 +569,11 @@ void DataDeclNode::transdata(Codegen* g)
 	ConstNode* c = expr->constNode();
 	if (expr->sem_type == Type::int_type) {
 		g->i_data(1);
-		g->i_data(c->intValue());
+		g->w_data(c->intValue());
 	} else if (expr->sem_type == Type::float_type) {
 		float n = c->floatValue();
 		g->i_data(2);
-		g->i_data(*(int*)&n);
+		g->w_data(*(int*)&n);
 	} else {
 		g->i_data(4);
 		g->p_data(str_label);
@@ -376,6 +597,7 @@ void VectorDeclNode::proto(DeclSeq* d, Environ* env)
 	Type* ty = tagType(tag, env);
 	if (!ty)
 		ty = Type::int_type;
+	Reach::type(ty);
 
 	std::vector<int> sizes;
 	for (int k = 0; k < exprs->size(); ++k) {
@@ -422,7 +644,7 @@ void VectorDeclNode::translate(Codegen* g)
 	g->p_data(t);
 
 	if (kind == DECL_GLOBAL)
-		g->i_data(0, "_v" + ident);
+		g->w_data(0, "_v" + ident);
 }
 
 DeclNode::DeclNode() : pos(-1) {}
@@ -434,3 +656,8 @@ void DeclNode::semant(Environ* e) {}
 void DeclNode::translate(Codegen* g) {}
 
 void DeclNode::transdata(Codegen* g) {}
+
+bool DeclNode::reached()
+{
+	return true;
+}
@@ -1,4 +1,5 @@
 #pragma once
+#include <set>
 #include <string>
 #include <vector>
 #include "node.hpp"
@@ -6,6 +7,7 @@
 
 class Codegen;
 class Environ;
+struct CodeFunc;
 struct StmtSeqNode;
 struct DeclVarNode;
 struct ExprNode;
@@ -19,6 +21,7 @@ struct DeclNode : public Node {
 	virtual void semant(Environ* e);
 	virtual void translate(Codegen* g);
 	virtual void transdata(Codegen* g);
+	virtual bool reached(); //false if nothing in the program can reach it
 };
 
 struct DeclSeqNode : public Node {
@@ -40,25 +43,47 @@ struct VarDeclNode : public DeclNode {
 	int          kind;
 	bool         constant;
 	ExprNode*    expr;
+	Decl*        sem_decl;
 	DeclVarNode* sem_var;
 	VarDeclNode(const std::string& i, const std::string& t, int k, bool c, ExprNode* e);
 	~VarDeclNode();
 	void proto(DeclSeq* d, Environ* e);
 	void semant(Environ* e);
 	void translate(Codegen* g);
+	bool reached();
 };
 
 struct FuncDeclNode : public DeclNode {
-	std::string  ident, tag;
-	DeclSeqNode* params;
-	StmtSeqNode* stmts;
-	FuncType*    sem_type;
-	Environ*     sem_env;
+	std::string       ident, tag;
+	DeclSeqNode*      params;
+	StmtSeqNode*      stmts;
+	FuncType*         sem_type;
+	Decl*             sem_decl;
+	Environ*          sem_env;
+	int               sem_labels; //labels used by semant
+	ExprNode*         sem_inline; //the value, if it's small enough to inline
+	bool              sem_traps;  //and if that can raise a runtime error
+	bool              sem_calls;  //or calls a function
+	std::vector<bool> sem_used;   //the params it reads
 	FuncDeclNode(const std::string& i, const std::string& t, DeclSeqNode* p, StmtSeqNode* ss);
 	~FuncDeclNode();
 	void proto(DeclSeq* d, Environ* e);
 	void semant(Environ* e);
 	void translate(Codegen* g);
+	bool reached();
+
+	//the pieces of translate, so it can be spread over threads:
+	bool replay(Codegen* g);                   //emit cached code, if any - main thread only
+	void translateFunc(Codegen* g);            //any thread
+	void store(Codegen* g, const CodeFunc& f); //add to cache - main thread only
+
+	//inlining - a call can be swapped for the function's value, with the call's args
+	//standing in for the params. expand returns 0 if this call can't be.
+	TNode*               expand(Codegen* g, ExprSeqNode* args);
+	static FuncDeclNode* inlined(Decl* d);
+	static ExprNode*     arg(Decl* param);
+	static void          inlineFiles(std::set<std::string>& files);
+	static void          clearInlines(); //forget a previous program's
 };
 
 struct StructDeclNode : public DeclNode {
@@ -70,6 +95,7 @@ struct StructDeclNode : public DeclNode {
 	void proto(DeclSeq* d, Environ* e);
 	void semant(Environ* e);
 	void translate(Codegen* g);
+	bool reached();
 };
 
 struct DataDeclNode : public DeclNode {
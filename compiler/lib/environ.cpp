@@ -3,6 +3,8 @@
 #include "label.hpp"
 #include "type.hpp"
 
+#include <stdutil.hpp>
+
 Environ::Environ(const std::string& f, Type* r, int l, Environ* gs) : funcLabel(f), returnType(r), level(l), globals(gs)
 {
 	decls     = new DeclSeq();
@@ -89,3 +91,67 @@ std::string Environ::setBreak(const std::string& s)
 	breakLabel = s;
 	return t;
 }
+
+static Type* tagType(int c)
+{
+	switch (c) {
+	case '%':
+		return Type::int_type;
+	case '#':
+		return Type::float_type;
+	case '$':
+		return Type::string_type;
+	}
+	return Type::void_type;
+}
+
+Decl* Environ::insertRuntimeFunc(const std::string& s, bool cfunc)
+{
+	size_t start = 0, end, k;
+	Type*  t     = Type::void_type;
+	if (!isalpha(s[0])) {
+		start = 1;
+		t     = tagType(s[0]);
+	}
+	for (k = 1; k < s.size(); ++k, end = k) {
+		if (!isalnum(s[k]) && s[k] != '_')
+			break;
+	}
+	DeclSeq* params = new DeclSeq();
+	std::string n      = s.substr(start, end - start);
+	while (k < s.size()) {
+		Type* t    = tagType(s[k++]);
+		int   from = k;
+		for (; isalnum(s[k]) || s[k] == '_'; ++k) {
+		}
+		std::string str     = s.substr(from, k - from);
+		ConstType* defType = 0;
+		if (s[k] == '=') {
+			int from = ++k;
+			if (s[k] == '\"') {
+				for (++k; s[k] != '\"'; ++k) {
+				}
+				std::string t = s.substr(from + 1, k - from - 1);
+				defType  = new ConstType(t);
+				++k;
+			} else {
+				if (s[k] == '-')
+					++k;
+				for (; isdigit(s[k]); ++k) {
+				}
+				if (t == Type::int_type) {
+					int n   = atoi(s.substr(from, k - from));
+					defType = new ConstType(n);
+				} else {
+					float n = (float)atof(s.substr(from, k - from));
+					defType = new ConstType(n);
+				}
+			}
+		}
+		Decl* d = params->insertDecl(str, t, DECL_PARAM, defType);
+	}
+
+	FuncType* f = new FuncType(t, params, false, cfunc);
+	n           = tolower(n);
+	return funcDecls->insertDecl(n, f, DECL_FUNC);
+}
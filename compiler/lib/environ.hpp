@@ -34,5 +34,9 @@ class Environ {
 	Label* findLabel(const std::string& s);
 	Label* insertLabel(const std::string& s, int def, int src, int sz);
 
+	//a runtime function from its symbol s, like "AppTitle$title$close_prompt=\"\"" - cfunc for one
+	//that was marked with a '!'
+	Decl* insertRuntimeFunc(const std::string& s, bool cfunc);
+
 	std::string setBreak(const std::string& s);
 };
@@ -2,7 +2,10 @@
 #include <cfloat>
 #include <cmath>
 #include "codegen.hpp"
+#include "declnode.hpp"
 #include "environ.hpp"
+#include "ranges.hpp"
+#include "reach.hpp"
 #include "toker.hpp"
 #include "varnode.hpp"
 
@@ -12,6 +15,12 @@ ExprNode::ExprNode() : sem_type(0) {}
 
 ExprNode::ExprNode(Type* t) : sem_type(t) {}
 
+void ExprNode::concat(Codegen* g, std::string& kinds, std::vector<TNode*>& parts)
+{
+	kinds += 's';
+	parts.push_back(translate(g));
+}
+
 //////////////////////////////////
 // Cast an expression to a type //
 //////////////////////////////////
@@ -83,7 +92,7 @@ TNode* CastNode::translate(Codegen* g)
 	}
 	if (expr->sem_type == Type::float_type && sem_type == Type::string_type) {
 		//float->str
-		return call("__bbStrFromFloat", t);
+		return fargs(call("__bbStrFromFloat", t));
 	}
 	if (expr->sem_type->structType() && sem_type == Type::string_type) {
 		//obj->str
@@ -92,6 +101,29 @@ TNode* CastNode::translate(Codegen* g)
 	return t;
 }
 
+bool CastNode::weigh(Weight& w)
+{
+	//to or from a string is a call
+	w.size += 1;
+	if (sem_type == Type::string_type || expr->sem_type == Type::string_type)
+		w.calls = true;
+	return expr->weigh(w);
+}
+
+void CastNode::concat(Codegen* g, std::string& kinds, std::vector<TNode*>& parts)
+{
+	//numbers are formatted straight into the result
+	if (sem_type == Type::string_type && expr->sem_type == Type::int_type) {
+		kinds += 'i';
+		parts.push_back(expr->translate(g));
+	} else if (sem_type == Type::string_type && expr->sem_type == Type::float_type) {
+		kinds += 'f';
+		parts.push_back(expr->translate(g));
+	} else {
+		ExprNode::concat(g, kinds, parts);
+	}
+}
+
 /////////////////////////////
 // Sequence of Expressions //
 /////////////////////////////
@@ -115,9 +147,12 @@ void ExprSeqNode::semant(Environ* e)
 	}
 }
 
-TNode* ExprSeqNode::translate(Codegen* g, bool cfunc)
+TNode* ExprSeqNode::translate(Codegen* g, bool cfunc, DeclSeq* regs)
 {
-	TNode *t = 0, *l = 0;
+	//register args go on the end, after the stack args - those with a temp were evaluated into it
+	//in order
+	TNode *t = 0, *l = 0, *rt = 0, *rl = 0;
+	int    sz = 0;
 	for (int k = 0; k < exprs.size(); ++k) {
 		TNode* q = exprs[k]->translate(g);
 
@@ -132,17 +167,36 @@ TNode* ExprSeqNode::translate(Codegen* g, bool cfunc)
 			}
 		}
 
+		int    n = regs ? regArg(regs, k) : -1;
 		TNode* p;
-		p = new TNode(IR_ARG, 0, 0, k * 4);
-		p = new TNode(IR_MEM, p, 0);
+		if (n >= 0 && k < sem_temps.size() && sem_temps[k]) {
+			int offset = sem_temps[k]->offset;
+			p          = new TNode(IR_SEQ, move(q, mem(local(offset))), 0);
+			(l ? l->r : t) = p;
+			l              = p;
+			q              = mem(local(offset));
+		}
+		if (n >= 0) {
+			p = new TNode(IR_REGARG, 0, 0, n);
+		} else {
+			p = new TNode(IR_ARG, 0, 0, sz);
+			p = new TNode(IR_MEM, p, 0);
+			sz += word;
+		}
 		p = new TNode(IR_MOVE, q, p);
+		if (exprs[k]->sem_type == Type::float_type)
+			p->iconst = IR_FLOAT;
 		p = new TNode(IR_SEQ, p, 0);
-		if (l)
-			l->r = p;
-		else
-			t = p;
-		l = p;
+		if (n >= 0) {
+			(rl ? rl->r : rt) = p;
+			rl                = p;
+		} else {
+			(l ? l->r : t) = p;
+			l              = p;
+		}
 	}
+	if (rt)
+		(l ? l->r : t) = rt;
 	return t;
 }
 
@@ -184,7 +238,32 @@ void ExprSeqNode::castTo(Type* t, Environ* e)
 	}
 }
 
-CallNode::CallNode(const std::string& i, const std::string& t, ExprSeqNode* e) : ident(i), tag(t), exprs(e) {}
+static bool sideEffects(ExprNode* e)
+{
+	Weight w;
+	return !e->weigh(w) || w.calls;
+}
+
+void ExprSeqNode::orderRegArgs(DeclSeq* params, Environ* e)
+{
+	sem_temps.assign(exprs.size(), (Decl*)0);
+	for (int k = 0; k < exprs.size(); ++k) {
+		if (regArg(params, k) < 0)
+			continue;
+		bool calls = sideEffects(exprs[k]);
+		for (int j = k + 1; j < exprs.size(); ++j) {
+			if (regArg(params, j) < 0 && (calls || sideEffects(exprs[j]))) {
+				//just the value - the arg's type would have it cleaned up with the locals
+				sem_temps[k] = e->decls->insertDecl(genLabel(), Type::int_type, DECL_LOCAL);
+				break;
+			}
+		}
+	}
+}
+
+CallNode::CallNode(const std::string& i, const std::string& t, ExprSeqNode* e)
+	: ident(i), tag(t), exprs(e), sem_user(false)
+{}
 
 CallNode::~CallNode()
 {
@@ -206,26 +285,52 @@ ExprNode* CallNode::semant(Environ* e)
 	exprs->semant(e);
 	exprs->castTo(f->params, e, f->cfunc);
 	sem_type = f->returnType;
+
+	//user functions can change anything - the runtime's are the only ones declared
+	//outside of a function label
+	for (Environ* x = e; x; x = x->globals) {
+		if (x->funcDecls->findDecl(ident) == sem_decl) {
+			sem_user = x->funcLabel.size() > 0;
+			if (sem_user) {
+				Ranges::any();
+				Reach::func(sem_decl);
+				exprs->orderRegArgs(f->params, e);
+			}
+			break;
+		}
+	}
 	return this;
 }
 
 TNode* CallNode::translate(Codegen* g)
 {
+	//small functions are inlined
+	if (FuncDeclNode* d = FuncDeclNode::inlined(sem_decl)) {
+		if (TNode* t = d->expand(g, exprs))
+			return t;
+	}
+
 	FuncType* f = sem_decl->type->funcType();
 
 	TNode* t;
 	TNode* l = global("_f" + ident);
-	TNode* r = exprs->translate(g, f->cfunc);
+	TNode* r = exprs->translate(g, f->cfunc, sem_user ? f->params : 0);
 
 	if (f->userlib) {
 		l = new TNode(IR_MEM, l);
 		usedfuncs.insert(ident);
 	}
 
+	int size = 0;
+	for (int k = 0; k < exprs->size(); ++k) {
+		if (!sem_user || regArg(f->params, k) < 0)
+			size += word;
+	}
+
 	if (sem_type == Type::float_type) {
-		t = new TNode(IR_FCALL, l, r, exprs->size() * 4);
+		t = new TNode(IR_FCALL, l, r, size);
 	} else {
-		t = new TNode(IR_CALL, l, r, exprs->size() * 4);
+		t = new TNode(IR_CALL, l, r, size);
 	}
 
 	if (f->returnType->stringType()) {
@@ -236,6 +341,17 @@ TNode* CallNode::translate(Codegen* g)
 	return t;
 }
 
+bool CallNode::weigh(Weight& w)
+{
+	w.size += 3;
+	w.calls = w.traps = true;
+	for (int k = 0; k < exprs->size(); ++k) {
+		if (!exprs->exprs[k]->weigh(w))
+			return false;
+	}
+	return true;
+}
+
 VarExprNode::VarExprNode(VarNode* v) : var(v) {}
 
 VarExprNode::~VarExprNode()
@@ -260,9 +376,40 @@ ExprNode* VarExprNode::semant(Environ* e)
 
 TNode* VarExprNode::translate(Codegen* g)
 {
+	//a param of a function being inlined?
+	if (ExprNode* e = FuncDeclNode::arg(var->decl()))
+		return e->translate(g);
 	return var->load(g);
 }
 
+void VarExprNode::concat(Codegen* g, std::string& kinds, std::vector<TNode*>& parts)
+{
+	//plain string vars are read in place, rather than copied - unless a later part calls
+	//something, see ArithExprNode::translate
+	TNode* t = var->translate(g);
+	if (t->op == IR_GLOBAL || t->op == IR_LOCAL) {
+		kinds += 'v';
+		parts.push_back(t);
+		return;
+	}
+	delete t;
+	ExprNode::concat(g, kinds, parts);
+}
+
+bool VarExprNode::range(Bound& lo, Bound& hi)
+{
+	Decl* d = var->decl();
+	if (!d || sem_type != Type::int_type)
+		return false;
+	lo = hi = Bound(d);
+	return true;
+}
+
+bool VarExprNode::weigh(Weight& w)
+{
+	return var->weigh(w);
+}
+
 //////////////////////
 // Integer constant //
 //////////////////////
@@ -276,6 +423,12 @@ TNode* IntConstNode::translate(Codegen* g)
 	return new TNode(IR_CONST, 0, 0, value);
 }
 
+bool IntConstNode::range(Bound& lo, Bound& hi)
+{
+	lo = hi = Bound(0, value);
+	return true;
+}
+
 int IntConstNode::intValue()
 {
 	return value;
@@ -344,6 +497,14 @@ TNode* StringConstNode::translate(Codegen* g)
 	return call("__bbStrConst", global(lab));
 }
 
+void StringConstNode::concat(Codegen* g, std::string& kinds, std::vector<TNode*>& parts)
+{
+	std::string lab = genLabel();
+	g->s_data(value, lab);
+	kinds += 'c';
+	parts.push_back(global(lab));
+}
+
 int StringConstNode::intValue()
 {
 	return atoi(value);
@@ -438,14 +599,20 @@ TNode* UniExprNode::translate(Codegen* g)
 			n = IR_FNEG;
 			break;
 		case ABS:
-			return fcall("__bbFAbs", l);
+			return fargs(fcall("__bbFAbs", l));
 		case SGN:
-			return fcall("__bbFSgn", l);
+			return fargs(fcall("__bbFSgn", l));
 		}
 	}
 	return new TNode(n, l, 0);
 }
 
+bool UniExprNode::weigh(Weight& w)
+{
+	w.size += op == ABS || op == SGN ? 2 : 1;
+	return expr->weigh(w);
+}
+
 BinExprNode::BinExprNode(int op, ExprNode* lhs, ExprNode* rhs) : op(op), lhs(lhs), rhs(rhs) {}
 
 BinExprNode::~BinExprNode()
@@ -521,6 +688,27 @@ TNode* BinExprNode::translate(Codegen* g)
 	return new TNode(n, l, r);
 }
 
+bool BinExprNode::range(Bound& lo, Bound& hi)
+{
+	//x And c lies in 0...c
+	if (op != AND)
+		return false;
+	ConstNode* c = rhs->constNode();
+	if (!c)
+		c = lhs->constNode();
+	if (!c || c->intValue() < 0)
+		return false;
+	lo = Bound(0, 0);
+	hi = Bound(0, c->intValue());
+	return true;
+}
+
+bool BinExprNode::weigh(Weight& w)
+{
+	w.size += 1;
+	return lhs->weigh(w) && rhs->weigh(w);
+}
+
 ArithExprNode::ArithExprNode(int op, ExprNode* lhs, ExprNode* rhs) : op(op), lhs(lhs), rhs(rhs) {}
 
 ArithExprNode::~ArithExprNode()
@@ -609,13 +797,87 @@ ExprNode* ArithExprNode::semant(Environ* e)
 	return this;
 }
 
+void ArithExprNode::concat(Codegen* g, std::string& kinds, std::vector<TNode*>& parts)
+{
+	lhs->concat(g, kinds, parts);
+	rhs->concat(g, kinds, parts);
+}
+
+bool ArithExprNode::range(Bound& lo, Bound& hi)
+{
+	//x+c, c+x or x-c just moves x's range
+	if (sem_type != Type::int_type || (op != '+' && op != '-'))
+		return false;
+	ExprNode*  x = lhs;
+	ConstNode* c = rhs->constNode();
+	if (!c && op == '+') {
+		x = rhs;
+		c = lhs->constNode();
+	}
+	if (!c || !x->range(lo, hi))
+		return false;
+	long long n = op == '+' ? c->intValue() : -(long long)c->intValue();
+	if (lo.n + n != (int)(lo.n + n) || hi.n + n != (int)(hi.n + n))
+		return false;
+	lo.n += (int)n;
+	hi.n += (int)n;
+	return true;
+}
+
+bool ArithExprNode::weigh(Weight& w)
+{
+	if (sem_type == Type::string_type) {
+		w.size += 3;
+		w.calls = true;
+	} else if (op == MOD || op == '^') {
+		w.size += 2;
+	} else {
+		w.size += 1;
+	}
+	//integer division by 0
+	if (sem_type == Type::int_type && (op == '/' || op == MOD))
+		w.traps = true;
+	return lhs->weigh(w) && rhs->weigh(w);
+}
+
+static bool hasCall(TNode* t)
+{
+	if (!t)
+		return false;
+	if (t->op == IR_CALL || t->op == IR_FCALL || t->op == IR_JSR)
+		return true;
+	return hasCall(t->l) || hasCall(t->r);
+}
+
 TNode* ArithExprNode::translate(Codegen* g)
 {
-	TNode* l = lhs->translate(g);
-	TNode* r = rhs->translate(g);
 	if (sem_type == Type::string_type) {
-		return call("__bbStrConcat", l, r);
+		//the whole chain is one call - varargs, so the caller pops them
+		std::string         kinds;
+		std::vector<TNode*> parts;
+		concat(g, kinds, parts);
+
+		//a var read in place is read when the concat runs, so if a later part calls anything,
+		//which could change it, it's copied in order instead
+		bool calls = false;
+		for (int k = parts.size() - 1; k >= 0; --k) {
+			if (kinds[k] == 'v' && calls) {
+				kinds[k] = 's';
+				parts[k] = call("__bbStrLoad", parts[k]);
+			}
+			calls = calls || hasCall(parts[k]);
+		}
+		std::string lab = genLabel();
+		g->s_data(kinds, lab);
+		TNode* t = move(global(lab), mem(arg(0)));
+		for (int k = 0; k < parts.size(); ++k)
+			t = seq(t, move(parts[k], mem(arg((k + 1) * word))));
+		t         = new TNode(IR_CALL, global("__bbStrConcatN"), t, (parts.size() + 1) * word);
+		t->sconst = "C";
+		return t;
 	}
+	TNode* l = lhs->translate(g);
+	TNode* r = rhs->translate(g);
 	int n = 0;
 	if (sem_type == Type::int_type) {
 		switch (op) {
@@ -649,9 +911,9 @@ TNode* ArithExprNode::translate(Codegen* g)
 			n = IR_FDIV;
 			break;
 		case MOD:
-			return fcall("__bbFMod", l, r);
+			return fargs(fcall("__bbFMod", l, r));
 		case '^':
-			return fcall("__bbFPow", l, r);
+			return fargs(fcall("__bbFPow", l, r));
 		}
 	}
 	return new TNode(n, l, r);
@@ -766,6 +1028,14 @@ TNode* RelExprNode::translate(Codegen* g)
 	return compare(op, l, r, opType);
 }
 
+bool RelExprNode::weigh(Weight& w)
+{
+	w.size += 1;
+	if (opType == Type::string_type)
+		w.calls = true;
+	return lhs->weigh(w) && rhs->weigh(w);
+}
+
 NewNode::NewNode(const std::string& i) : ident(i) {}
 
 ////////////////////
@@ -778,6 +1048,7 @@ ExprNode* NewNode::semant(Environ* e)
 		ex("custom type name not found");
 	if (sem_type->structType() == 0)
 		ex("type is not a custom type");
+	Reach::type(sem_type);
 	return this;
 }
 
@@ -796,6 +1067,7 @@ ExprNode* FirstNode::semant(Environ* e)
 	sem_type = e->findType(ident);
 	if (!sem_type)
 		ex("custom type name name not found");
+	Reach::type(sem_type);
 	return this;
 }
 
@@ -814,6 +1086,7 @@ ExprNode* LastNode::semant(Environ* e)
 	sem_type = e->findType(ident);
 	if (!sem_type)
 		ex("custom type name not found");
+	Reach::type(sem_type);
 	return this;
 }
 
@@ -847,7 +1120,7 @@ TNode* AfterNode::translate(Codegen* g)
 {
 	TNode* t = expr->translate(g);
 	if (g->debug)
-		t = jumpf(t, "__bbNullObjEx");
+		t = jumpnull(t, "__bbNullObjEx");
 	return call("__bbObjNext", t);
 }
 
@@ -876,7 +1149,7 @@ TNode* BeforeNode::translate(Codegen* g)
 {
 	TNode* t = expr->translate(g);
 	if (g->debug)
-		t = jumpf(t, "__bbNullObjEx");
+		t = jumpnull(t, "__bbNullObjEx");
 	return call("__bbObjPrev", t);
 }
 
@@ -894,6 +1167,12 @@ TNode* NullNode::translate(Codegen* g)
 	return new TNode(IR_CONST, 0, 0, 0);
 }
 
+bool NullNode::weigh(Weight& w)
+{
+	w.size += 1;
+	return true;
+}
+
 ObjectCastNode::ObjectCastNode(ExprNode* e, const std::string& t) : expr(e), type_ident(t) {}
 
 ObjectCastNode::~ObjectCastNode()
@@ -913,6 +1192,7 @@ ExprNode* ObjectCastNode::semant(Environ* e)
 		ex("custom type name not found");
 	if (!sem_type->structType())
 		ex("type is not a custom type");
+	Reach::type(sem_type);
 	return this;
 }
 
@@ -957,3 +1237,9 @@ ConstNode* ConstNode::constNode()
 {
 	return this;
 }
+
+bool ConstNode::weigh(Weight& w)
+{
+	w.size += 1;
+	return true;
+}
@@ -11,6 +11,16 @@ struct DeclSeq;
 struct Decl;
 struct ConstNode; //is constant int,float or string
 struct VarNode;
+struct Bound;
+
+//what inlining an expression costs - see FuncDeclNode::expand
+struct Weight {
+	int                size;
+	bool               calls; //calls a function, so may have side effects
+	bool               traps; //can raise a runtime error
+	std::vector<Decl*> reads; //plain vars read
+	Weight() : size(0), calls(false), traps(false) {}
+};
 
 class ExprNode : public Node {
 	std::shared_ptr<Type> sem_type;
@@ -29,10 +39,26 @@ class ExprNode : public Node {
 	{
 		return 0;
 	}
+
+	//adds this expression's part of a$+b$+... - see _bbStrConcatN
+	virtual void concat(Codegen* g, std::string& kinds, std::vector<TNode*>& parts);
+
+	//the range of an int expression's value, if it's known - see ranges.hpp
+	virtual bool range(Bound& lo, Bound& hi)
+	{
+		return false;
+	}
+
+	//adds to w, or returns false if the expression can't be inlined at all
+	virtual bool weigh(Weight& w)
+	{
+		return false;
+	}
 };
 
 class ExprSeqNode : public Node {
 	std::list<std::shared_ptr<ExprNode>> exprs;
+	std::vector<Decl*>                   sem_temps; //see orderRegArgs
 
 	public:
 	~ExprSeqNode();
@@ -43,11 +69,15 @@ class ExprSeqNode : public Node {
 
 	void semant(Environ* e);
 
-	TNode* translate(Codegen* g, bool userlib);
+	TNode* translate(Codegen* g, bool userlib, DeclSeq* regs = 0);
 
 	void castTo(DeclSeq* ds, Environ* e, bool userlib);
 
 	void castTo(Type* t, Environ* e);
+
+	//register args are passed after the stack args, so any that have to be evaluated before
+	//a later stack arg are evaluated into a temp in order
+	void orderRegArgs(DeclSeq* params, Environ* e);
 };
 
 struct CastNode : public ExprNode {
@@ -57,16 +87,20 @@ struct CastNode : public ExprNode {
 	~CastNode();
 	ExprNode* semant(Environ* e);
 	TNode*    translate(Codegen* g);
+	void      concat(Codegen* g, std::string& kinds, std::vector<TNode*>& parts);
+	bool      weigh(Weight& w);
 };
 
 struct CallNode : public ExprNode {
 	std::string  ident, tag;
 	ExprSeqNode* exprs;
 	Decl*        sem_decl;
+	bool         sem_user; //a user function, so takes register args
 	CallNode(const std::string& i, const std::string& t, ExprSeqNode* e);
 	~CallNode();
 	ExprNode* semant(Environ* e);
 	TNode*    translate(Codegen* g);
+	bool      weigh(Weight& w);
 };
 
 struct VarExprNode : public ExprNode {
@@ -75,6 +109,9 @@ struct VarExprNode : public ExprNode {
 	~VarExprNode();
 	ExprNode* semant(Environ* e);
 	TNode*    translate(Codegen* g);
+	void      concat(Codegen* g, std::string& kinds, std::vector<TNode*>& parts);
+	bool      range(Bound& lo, Bound& hi);
+	bool      weigh(Weight& w);
 };
 
 struct ConstNode : public ExprNode {
@@ -83,12 +120,14 @@ struct ConstNode : public ExprNode {
 	virtual int         intValue()    = 0;
 	virtual float       floatValue()  = 0;
 	virtual std::string stringValue() = 0;
+	bool                weigh(Weight& w);
 };
 
 struct IntConstNode : public ConstNode {
 	int value;
 	IntConstNode(int n);
 	TNode*      translate(Codegen* g);
+	bool        range(Bound& lo, Bound& hi);
 	int         intValue();
 	float       floatValue();
 	std::string stringValue();
@@ -107,6 +146,7 @@ struct StringConstNode : public ConstNode {
 	std::string value;
 	StringConstNode(const std::string& s);
 	TNode*      translate(Codegen* g);
+	void        concat(Codegen* g, std::string& kinds, std::vector<TNode*>& parts);
 	int         intValue();
 	float       floatValue();
 	std::string stringValue();
@@ -120,6 +160,7 @@ struct UniExprNode : public ExprNode {
 	ExprNode* constize();
 	ExprNode* semant(Environ* e);
 	TNode*    translate(Codegen* g);
+	bool      weigh(Weight& w);
 };
 
 // and, or, eor, lsl, lsr, asr
@@ -130,6 +171,8 @@ struct BinExprNode : public ExprNode {
 	~BinExprNode();
 	ExprNode* semant(Environ* e);
 	TNode*    translate(Codegen* g);
+	bool      range(Bound& lo, Bound& hi);
+	bool      weigh(Weight& w);
 };
 
 // *,/,Mod,+,-
@@ -140,6 +183,9 @@ struct ArithExprNode : public ExprNode {
 	~ArithExprNode();
 	ExprNode* semant(Environ* e);
 	TNode*    translate(Codegen* g);
+	void      concat(Codegen* g, std::string& kinds, std::vector<TNode*>& parts);
+	bool      range(Bound& lo, Bound& hi);
+	bool      weigh(Weight& w);
 };
 
 //<,=,>,<=,<>,>=
@@ -151,6 +197,7 @@ struct RelExprNode : public ExprNode {
 	~RelExprNode();
 	ExprNode* semant(Environ* e);
 	TNode*    translate(Codegen* g);
+	bool      weigh(Weight& w);
 };
 
 struct NewNode : public ExprNode {
@@ -193,6 +240,7 @@ struct BeforeNode : public ExprNode {
 struct NullNode : public ExprNode {
 	ExprNode* semant(Environ* e);
 	TNode*    translate(Codegen* g);
+	bool      weigh(Weight& w);
 };
 
 struct ObjectCastNode : public ExprNode {
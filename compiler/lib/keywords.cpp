@@ -0,0 +1,91 @@
+//
+//This is generated code - do not modify!!!!!
+//
+
+#include "keywords.hpp"
+#include "toker.hpp"
+
+const Keyword keywords[]={
+{"Dim",DIM},
+{"Goto",GOTO},
+{"Gosub",GOSUB},
+{"Return",RETURN},
+{"Exit",EXIT},
+{"If",IF},
+{"Then",THEN},
+{"Else",ELSE},
+{"EndIf",ENDIF},
+{"End If",ENDIF},
+{"ElseIf",ELSEIF},
+{"Else If",ELSEIF},
+{"While",WHILE},
+{"Wend",WEND},
+{"For",FOR},
+{"To",TO},
+{"Step",STEP},
+{"Next",NEXT},
+{"Function",FUNCTION},
+{"End Function",ENDFUNCTION},
+{"Type",TYPE},
+{"End Type",ENDTYPE},
+{"Each",EACH},
+{"Local",LOCAL},
+{"Global",GLOBAL},
+{"Field",FIELD},
+{"Const",BBCONST},
+{"Select",SELECT},
+{"Case",CASE},
+{"Default",DEFAULT},
+{"End Select",ENDSELECT},
+{"Repeat",REPEAT},
+{"Until",UNTIL},
+{"Forever",FOREVER},
+{"Data",DATA},
+{"Read",READ},
+{"Restore",RESTORE},
+{"Abs",ABS},
+{"Sgn",SGN},
+{"Mod",MOD},
+{"Pi",PI},
+{"True",BBTRUE},
+{"False",BBFALSE},
+{"Int",BBINT},
+{"Float",BBFLOAT},
+{"Str",BBSTR},
+{"Include",INCLUDE},
+{"New",BBNEW},
+{"Delete",BBDELETE},
+{"First",FIRST},
+{"Last",LAST},
+{"Insert",INSERT},
+{"Before",BEFORE},
+{"After",AFTER},
+{"Null",BBNULL},
+{"Object",OBJECT},
+{"Handle",BBHANDLE},
+{"And",AND},
+{"Or",OR},
+{"Xor",XOR},
+{"Not",NOT},
+{"Shl",SHL},
+{"Shr",SHR},
+{"Sar",SAR},
+};
+
+const int keywordCount=64;
+
+const int keywordHashBuckets=33,keywordHashSlots=80;
+
+const unsigned short keywordHashDisp[]={
+2,3,4,2,1,0,6,5,3,0,2,3,2,1,4,1,
+1,2,4,23,0,2,1,1,1,2,2,5,1,1,11,4,
+12,
+};
+
+const short keywordHashTable[]={
+12,53,24,14,54,38,6,32,-1,15,18,46,-1,59,5,35,
+47,49,10,25,27,45,41,48,-1,60,62,9,4,19,-1,1,
+21,-1,56,51,20,17,57,33,-1,26,0,8,11,-1,-1,28,
+43,39,55,37,61,34,50,22,-1,29,30,40,-1,63,52,58,
+3,36,13,23,-1,7,2,-1,-1,-1,-1,31,42,-1,44,16,
+};
@@ -0,0 +1,39 @@
+#pragma once
+#include <cctype>
+
+//a Blitz keyword - two word ones like "End If" have a single space in them
+struct Keyword {
+	const char* name;
+	int         toke;
+};
+
+//keyword table and a perfect hash over the lowercased names, built by compiler/gen
+extern const Keyword        keywords[];
+extern const int            keywordCount;
+extern const int            keywordHashBuckets, keywordHashSlots;
+extern const unsigned short keywordHashDisp[];
+extern const short          keywordHashTable[];
+
+//must match instHash() in compiler/gen/main.cpp, over lowercased names
+inline unsigned keywordHash(const char* p, int n, unsigned seed)
+{
+	unsigned h = 2166136261u ^ (seed * 0x9e3779b9u);
+	while (n--)
+		h = (h ^ (unsigned char)tolower(*p++)) * 16777619u;
+	return h ^ (h >> 15);
+}
+
+//the token for the keyword at p, in any case, or -1
+inline int findKeyword(const char* p, int n)
+{
+	unsigned b = keywordHash(p, n, 0) % keywordHashBuckets;
+	int      k = keywordHashTable[keywordHash(p, n, keywordHashDisp[b]) % keywordHashSlots];
+	if (k < 0)
+		return -1;
+	const char* t = keywords[k].name;
+	for (int i = 0; i < n; ++i) {
+		if (tolower(t[i]) != tolower(p[i]))
+			return -1;
+	}
+	return t[n] ? -1 : keywords[k].toke;
+}
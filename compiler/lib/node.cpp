@@ -11,7 +11,53 @@
 
 #include <stdutil.hpp>
 
-std::set<std::string> Node::usedfuncs;
+thread_local std::set<std::string> Node::usedfuncs;
+
+int Node::word = 4;
+
+//-stats counts, added up as threads end
+static std::atomic<int>  nodesMade, tnodesMade;
+thread_local ThreadCount Node::created(nodesMade), TNode::created(tnodesMade);
+
+static thread_local sizedpool<256> nodePool;
+static thread_local pool<TNode>    tnodePool;
+
+void* Node::operator new(size_t sz)
+{
+	return nodePool.allocate(sz);
+}
+
+void Node::operator delete(void* p, size_t sz)
+{
+	if (p)
+		nodePool.deallocate(p, sz);
+}
+
+void Node::resetPool()
+{
+	nodePool.reset();
+}
+
+void* TNode::operator new(size_t sz)
+{
+	return tnodePool.allocate();
+}
+
+void TNode::operator delete(void* p)
+{
+	if (p)
+		tnodePool.deallocate(p);
+}
+
+bool TNode::releasePool()
+{
+	return tnodePool.clear();
+}
+
+void TNode::resetPool()
+{
+	tnodePool.reset();
+}
 
 ///////////////////////////////
 // generic exception thrower //
@@ -71,17 +117,37 @@ int Node::enumVars(Environ* e)
 	int p_size = 0, l_size = 0;
 	for (int k = 0; k < e->decls->size(); ++k) {
 		Decl* d = e->decls->decls[k];
-		if (d->kind & DECL_PARAM) {
+		if ((d->kind & DECL_PARAM) && regArg(e->decls, k) >= 0) {
+			//passed in a register - stored with the locals on entry
+			d->offset = -word - l_size;
+			l_size += word;
+		} else if (d->kind & DECL_PARAM) {
 			d->offset = p_size + 20;
-			p_size += 4;
+			p_size += word;
 		} else if (d->kind & DECL_LOCAL) {
-			d->offset = -4 - l_size;
-			l_size += 4;
+			d->offset = -word - l_size;
+			l_size += word;
 		}
 	}
 	return l_size;
 }
 
+//which register param k of a user function is passed in, or -1 if it's on the stack
+int Node::regArg(DeclSeq* params, int k)
+{
+	//64 bit targets pass them all as the C ABI does, so just say which one it is
+	if (word == 8)
+		return k;
+	if (params->decls[k]->type == Type::float_type)
+		return -1;
+	int n = 0;
+	for (int j = 0; j < k; ++j) {
+		if (params->decls[j]->type != Type::float_type)
+			++n;
+	}
+	return n < REG_ARGS ? n : -1;
+}
+
 //////////////////////////////
 // initialize all vars to 0 //
 //////////////////////////////
@@ -236,10 +302,32 @@ Type* Node::tagType(const std::string& tag, Environ* e)
 ////////////////////////////////
 // Generate a fresh ASM label //
 ////////////////////////////////
+static int                      labelCnt;
+static thread_local int         scopeCnt;
+static thread_local std::string labelScope;
+
 std::string Node::genLabel()
 {
-	static int cnt;
-	return "_" + itoa(++cnt & 0x7fffffff);
+	if (labelScope.size())
+		return labelScope + itoa(++scopeCnt & 0x7fffffff);
+	return "_" + itoa(++labelCnt & 0x7fffffff);
+}
+
+//////////////////////////////////////////////////////////////
+// Labels generated inside a function are numbered from the //
+// function's own scope, so its code doesn't depend on what //
+// was compiled before it.                                  //
+//////////////////////////////////////////////////////////////
+void Node::beginLabelScope(const std::string& scope, int cnt)
+{
+	labelScope = "_L" + scope + "_";
+	scopeCnt   = cnt;
+}
+
+int Node::endLabelScope()
+{
+	labelScope.clear();
+	return scopeCnt;
 }
 
 //////////////////////////////////////////////////////
@@ -251,13 +339,13 @@ TNode* Node::call(const std::string& func, TNode* a0, TNode* a1, TNode* a2)
 	TNode* t    = 0;
 	if (a0) {
 		t = move(a0, mem(arg(0)));
-		size += 4;
+		size += word;
 		if (a1) {
-			t = seq(t, move(a1, mem(arg(4))));
-			size += 4;
+			t = seq(t, move(a1, mem(arg(word))));
+			size += word;
 			if (a2) {
-				t = seq(t, move(a2, mem(arg(8))));
-				size += 4;
+				t = seq(t, move(a2, mem(arg(word * 2))));
+				size += word;
 			}
 		}
 	}
@@ -274,13 +362,13 @@ TNode* Node::fcall(const std::string& func, TNode* a0, TNode* a1, TNode* a2)
 	TNode* t    = 0;
 	if (a0) {
 		t = move(a0, mem(arg(0)));
-		size += 4;
+		size += word;
 		if (a1) {
-			t = seq(t, move(a1, mem(arg(4))));
-			size += 4;
+			t = seq(t, move(a1, mem(arg(word))));
+			size += word;
 			if (a2) {
-				t = seq(t, move(a2, mem(arg(8))));
-				size += 4;
+				t = seq(t, move(a2, mem(arg(word * 2))));
+				size += word;
 			}
 		}
 	}
@@ -288,6 +376,27 @@ TNode* Node::fcall(const std::string& func, TNode* a0, TNode* a1, TNode* a2)
 	return new TNode(IR_FCALL, l, t, size);
 }
 
+///////////////////////////////////////////////////////
+// mark the args of a call to a runtime func as floats //
+///////////////////////////////////////////////////////
+static void floatArgs(TNode* t)
+{
+	if (!t)
+		return;
+	if (t->op == IR_MOVE) {
+		t->iconst = IR_FLOAT;
+		return;
+	}
+	floatArgs(t->l);
+	floatArgs(t->r);
+}
+
+TNode* Node::fargs(TNode* call)
+{
+	floatArgs(call->r);
+	return call;
+}
+
 TNode* Node::seq(TNode* l, TNode* r)
 {
 	return new TNode(IR_SEQ, l, r);
@@ -323,6 +432,11 @@ TNode* Node::add(TNode* l, TNode* r)
 	return new TNode(IR_ADD, l, r);
 }
 
+TNode* Node::addr(TNode* base, TNode* offset)
+{
+	return new TNode(IR_ADD, base, offset, IR_ADDR);
+}
+
 TNode* Node::mul(TNode* l, TNode* r)
 {
 	return new TNode(IR_MUL, l, r);
@@ -358,7 +472,19 @@ TNode* Node::jumpf(TNode* expr, const std::string& s)
 	return new TNode(IR_JUMPF, expr, 0, s);
 }
 
+TNode* Node::jumpnull(TNode* ptr, const std::string& s)
+{
+	TNode* t  = new TNode(IR_JUMPF, ptr, 0, s);
+	t->iconst = IR_ADDR;
+	return t;
+}
+
 TNode* Node::jumpge(TNode* l, TNode* r, const std::string& s)
 {
 	return new TNode(IR_JUMPGE, l, r, s);
 }
+
+TNode* Node::jumptable(TNode* index, const std::string& table)
+{
+	return new TNode(IR_JUMPTABLE, index, 0, table);
+}
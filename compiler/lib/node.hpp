@@ -1,6 +1,7 @@
 #pragma once
 #include <set>
 #include <string>
+#include "counter.hpp"
 #include "type.hpp"
 
 struct VarNode;
@@ -10,11 +11,26 @@ struct TNode;
 
 class Node {
 	public:
+	Node() { ++created; }
 	virtual ~Node() {}
 
 	public:
-	//used user funcs...
-	static std::set<std::string> usedfuncs;
+	//used user funcs - per thread, as functions can be translated in parallel
+	static thread_local std::set<std::string> usedfuncs;
+
+	//bytes in a var, field or array element - a pointer's size on the target
+	static int word;
+
+	//nodes made, for -stats
+	static thread_local ThreadCount created;
+
+	//nodes are made by parse and semant, and none outlive the compile, so they come from a pool
+	//that resetPool() frees all at once when it's done - even the ones a failed compile didn't
+	//delete. Per thread, like TNodes, though it's only the compiling thread that makes them. Nodes
+	//from make_shared are allocated with their count, and don't come from it.
+	static void* operator new(size_t sz);
+	static void  operator delete(void* p, size_t sz);
+	static void  resetPool();
 
 	//helper funcs
 	static void ex();
@@ -23,12 +39,15 @@ class Node {
 	static void ex(const std::string& e, int pos, const std::string& f);
 
 	static std::string genLabel();
+	static void        beginLabelScope(const std::string& scope, int cnt);
+	static int         endLabelScope();
 	static VarNode* genLocal(Environ* e, Type* ty);
 
 	static TNode*     compare(int op, TNode* l, TNode* r, Type* ty);
 	static ConstNode* constValue(Type* ty);
 
 	static int   enumVars(Environ* e);
+	static int   regArg(DeclSeq* params, int k);
 	static Type* tagType(const std::string& s, Environ* e);
 
 	static TNode* createVars(Environ* e);
@@ -41,6 +60,7 @@ class Node {
 	static TNode* arg(int offset);
 	static TNode* mem(TNode* ref);
 	static TNode* add(TNode* l, TNode* r);
+	static TNode* addr(TNode* base, TNode* offset);
 	static TNode* mul(TNode* l, TNode* r);
 	static TNode* iconst(int n);
 	static TNode* ret();
@@ -48,7 +68,10 @@ class Node {
 	static TNode* jump(const std::string& s);
 	static TNode* jumpt(TNode* cond, const std::string& s);
 	static TNode* jumpf(TNode* cond, const std::string& s);
+	static TNode* jumpnull(TNode* ptr, const std::string& s);
 	static TNode* jumpge(TNode* l, TNode* r, const std::string& s);
+	static TNode* jumptable(TNode* index, const std::string& table);
 	static TNode* call(const std::string& func, TNode* a0 = 0, TNode* a1 = 0, TNode* a2 = 0);
 	static TNode* fcall(const std::string& func, TNode* a0 = 0, TNode* a1 = 0, TNode* a2 = 0);
+	static TNode* fargs(TNode* call);
 };
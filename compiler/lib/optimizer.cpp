@@ -0,0 +1,1589 @@
+#include "optimizer.hpp"
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <iomanip>
+#include <map>
+#include <set>
+
+#include <stdutil.hpp>
+
+OptFunc::~OptFunc()
+{
+	for (int k = 0; k < stmts.size(); ++k)
+		delete stmts[k].t;
+	delete cleanup;
+}
+
+int OptFunc::newTemp()
+{
+	frameSize += 4;
+	return -frameSize;
+}
+
+/////////////
+// Helpers //
+/////////////
+static TNode* iconst(int n)
+{
+	return new TNode(IR_CONST, 0, 0, n);
+}
+
+static TNode* local(int offset)
+{
+	return new TNode(IR_MEM, new TNode(IR_LOCAL, 0, 0, offset));
+}
+
+static TNode* copy(TNode* t)
+{
+	if (!t)
+		return 0;
+	TNode* c = new TNode(t->op, copy(t->l), copy(t->r), t->sconst);
+	c->iconst = t->iconst;
+	return c;
+}
+
+//replace t with one of its children
+static TNode* keep(TNode* t, TNode*& child)
+{
+	TNode* c = child;
+	child    = 0;
+	delete t;
+	return c;
+}
+
+static int countNodes(TNode* t)
+{
+	return t ? 1 + countNodes(t->l) + countNodes(t->r) : 0;
+}
+
+static bool same(TNode* t1, TNode* t2)
+{
+	if (!t1 || !t2)
+		return t1 == t2;
+	return t1->op == t2->op && t1->iconst == t2->iconst && t1->sconst == t2->sconst && same(t1->l, t2->l) &&
+		   same(t1->r, t2->r);
+}
+
+static std::string key(TNode* t)
+{
+	if (!t)
+		return "-";
+	return itoa(t->op) + ':' + itoa(t->iconst) + ':' + t->sconst + '(' + key(t->l) + ',' + key(t->r) + ')';
+}
+
+static bool isConst(TNode* t, int n)
+{
+	return t->op == IR_CONST && t->iconst == n;
+}
+
+static bool getShift(int n, int& shift)
+{
+	for (shift = 0; shift < 31; ++shift) {
+		if ((1 << shift) == n)
+			return true;
+	}
+	return false;
+}
+
+//cheap enough to evaluate more than once
+static bool isSimple(TNode* t)
+{
+	return t->op == IR_CONST || (t->op == IR_MEM && (t->l->op == IR_LOCAL || t->l->op == IR_GLOBAL));
+}
+
+//no side effects - can be removed, copied, or moved within a block
+static bool isPure(TNode* t)
+{
+	if (!t)
+		return true;
+	switch (t->op) {
+	case IR_CONST:
+	case IR_GLOBAL:
+	case IR_LOCAL:
+		return true;
+	case IR_MEM:
+		return t->l->op != IR_ARG && isPure(t->l);
+	case IR_ADD:
+	case IR_SUB:
+	case IR_MUL:
+	case IR_MULHI:
+	case IR_AND:
+	case IR_OR:
+	case IR_XOR:
+	case IR_SHL:
+	case IR_SHR:
+	case IR_SAR:
+	case IR_NEG:
+	case IR_SETEQ:
+	case IR_SETNE:
+	case IR_SETLT:
+	case IR_SETGT:
+	case IR_SETLE:
+	case IR_SETGE:
+	case IR_CAST:
+	case IR_FCAST:
+	case IR_FNEG:
+	case IR_FADD:
+	case IR_FSUB:
+	case IR_FMUL:
+	case IR_FDIV:
+	case IR_FSETEQ:
+	case IR_FSETNE:
+	case IR_FSETLT:
+	case IR_FSETGT:
+	case IR_FSETLE:
+	case IR_FSETGE:
+		return isPure(t->l) && isPure(t->r);
+	}
+	return false;
+}
+
+//rough number of instructions/cycles the tiler will spend on t
+static int cost(TNode* t)
+{
+	if (!t)
+		return 0;
+	int c = cost(t->l) + cost(t->r), shift;
+	switch (t->op) {
+	case IR_CONST:
+	case IR_GLOBAL:
+	case IR_LOCAL:
+	case IR_ARG:
+		return c;
+	case IR_MEM:
+		return c + 2;
+	case IR_MUL:
+		return c + (t->r->op == IR_CONST && getShift(t->r->iconst, shift) ? 1 : 3);
+	case IR_MULHI:
+		return c + 4;
+	case IR_DIV:
+		return c + 20;
+	case IR_CAST:
+	case IR_FCAST:
+	case IR_FADD:
+	case IR_FSUB:
+	case IR_FMUL:
+	case IR_FDIV:
+		return c + 3;
+	}
+	return c + 1;
+}
+
+///////////////////////////////////////////////////////////////
+// What a tree reads and writes. Locals whose address is     //
+// passed around (strings, objects) count as general memory. //
+///////////////////////////////////////////////////////////////
+struct Effects {
+	std::set<int> locals; //locals stored to
+	bool          memory; //stores to anything else, or calls
+	bool          all;    //Gosub - anything at all
+	bool          jumps;
+	Effects() : memory(false), all(false), jumps(false) {}
+};
+
+struct Reads {
+	std::set<int> locals;
+	bool          memory, all;
+	Reads() : memory(false), all(false) {}
+};
+
+static void takenLocals(TNode* t, TNode* parent, std::set<int>& taken)
+{
+	if (!t)
+		return;
+	if (t->op == IR_LOCAL && (!parent || parent->op != IR_MEM))
+		taken.insert(t->iconst);
+	takenLocals(t->l, t, taken);
+	takenLocals(t->r, t, taken);
+}
+
+static std::set<int> takenLocals(OptFunc& f)
+{
+	std::set<int> taken;
+	for (int k = 0; k < f.stmts.size(); ++k)
+		takenLocals(f.stmts[k].t, 0, taken);
+	takenLocals(f.cleanup, 0, taken);
+	return taken;
+}
+
+static void storeEffects(TNode* dest, const std::set<int>& taken, Effects& e)
+{
+	if (dest->op != IR_MEM)
+		return;
+	TNode* a = dest->l;
+	if (a->op == IR_LOCAL && !taken.count(a->iconst))
+		e.locals.insert(a->iconst);
+	else if (a->op != IR_ARG)
+		e.memory = true;
+}
+
+static void effects(TNode* t, const std::set<int>& taken, Effects& e)
+{
+	if (!t)
+		return;
+	switch (t->op) {
+	case IR_MOVE:
+		storeEffects(t->r, taken, e);
+		break;
+	case IR_CALL:
+	case IR_FCALL:
+		e.memory = true;
+		break;
+	case IR_JSR:
+		e.memory = e.all = true;
+		break;
+	case IR_JUMP:
+	case IR_JUMPT:
+	case IR_JUMPF:
+	case IR_JUMPGE:
+	case IR_JUMPTABLE:
+	case IR_RET:
+	case IR_RETURN:
+	case IR_FRETURN:
+		e.jumps = true;
+		break;
+	}
+	effects(t->l, taken, e);
+	effects(t->r, taken, e);
+}
+
+//effects of a statement up to, but not including, its final store
+static void innerEffects(TNode* t, const std::set<int>& taken, Effects& e)
+{
+	if (t->op == IR_MOVE && t->r->op == IR_MEM) {
+		effects(t->l, taken, e);
+		effects(t->r->l, taken, e);
+	} else {
+		effects(t, taken, e);
+	}
+}
+
+static void reads(TNode* t, const std::set<int>& taken, Reads& r)
+{
+	if (!t)
+		return;
+	switch (t->op) {
+	case IR_MEM:
+		if (t->l->op == IR_LOCAL && !taken.count(t->l->iconst))
+			r.locals.insert(t->l->iconst);
+		else if (t->l->op != IR_ARG)
+			r.memory = true;
+		break;
+	case IR_MOVE:
+		reads(t->l, taken, r);
+		if (t->r->op == IR_MEM)
+			reads(t->r->l, taken, r);
+		else
+			reads(t->r, taken, r);
+		return;
+	case IR_CALL:
+	case IR_FCALL:
+		r.memory = true;
+		break;
+	case IR_JSR:
+		r.memory = r.all = true;
+		break;
+	}
+	reads(t->l, taken, r);
+	reads(t->r, taken, r);
+}
+
+static bool clobbers(const Effects& e, const Reads& r)
+{
+	if (e.all || (e.memory && r.memory))
+		return true;
+	std::set<int>::const_iterator it;
+	for (it = r.locals.begin(); it != r.locals.end(); ++it) {
+		if (e.locals.count(*it))
+			return true;
+	}
+	return false;
+}
+
+/////////////////////////////////////////////////////
+// Division by a constant - Hacker's Delight, 10-1 //
+/////////////////////////////////////////////////////
+static void magic(int d, int& m, int& s)
+{
+	const unsigned two31 = 0x80000000u;
+
+	unsigned ad = d, anc = two31 - 1 - two31 % ad;
+	unsigned q1 = two31 / anc, r1 = two31 - q1 * anc;
+	unsigned q2 = two31 / ad, r2 = two31 - q2 * ad, delta;
+	int      p = 31;
+	do {
+		++p;
+		q1 *= 2;
+		r1 *= 2;
+		if (r1 >= anc) {
+			++q1;
+			r1 -= anc;
+		}
+		q2 *= 2;
+		r2 *= 2;
+		if (r2 >= ad) {
+			++q2;
+			r2 -= ad;
+		}
+		delta = ad - r2;
+	} while (q1 < delta || (q1 == delta && r1 == 0));
+
+	m = q2 + 1;
+	s = p - 32;
+}
+
+//what to add to n before shifting right, so it rounds towards 0 like idiv
+static TNode* roundBias(TNode* n, int shift)
+{
+	TNode* sign = shift == 1 ? copy(n) : new TNode(IR_SAR, copy(n), iconst(31));
+	return new TNode(IR_SHR, sign, iconst(32 - shift));
+}
+
+//n/d, rounding towards 0. n must be simple, d>=2.
+static TNode* divConst(TNode* n, int d)
+{
+	int shift;
+	if (getShift(d, shift))
+		return new TNode(IR_SAR, new TNode(IR_ADD, n, roundBias(n, shift)), iconst(shift));
+
+	int m, s;
+	magic(d, m, s);
+	TNode* q = new TNode(IR_MULHI, copy(n), iconst(m));
+	if (m < 0)
+		q = new TNode(IR_ADD, q, copy(n));
+	if (s)
+		q = new TNode(IR_SAR, q, iconst(s));
+	return new TNode(IR_ADD, q, new TNode(IR_SHR, n, iconst(31)));
+}
+
+//n%d, with the sign of n like C. n must be simple, d>=2.
+static TNode* modConst(TNode* n, int d)
+{
+	int shift;
+	if (getShift(d, shift)) {
+		TNode* t = new TNode(IR_ADD, copy(n), roundBias(n, shift));
+		return new TNode(IR_SUB, n, new TNode(IR_AND, t, iconst(-d)));
+	}
+	return new TNode(IR_SUB, n, new TNode(IR_MUL, divConst(copy(n), d), iconst(d)));
+}
+
+////////////////////////////////////////////////
+// Constant folding, algebraic simplification //
+////////////////////////////////////////////////
+static bool foldInt(int op, int x, int y, int& v)
+{
+	switch (op) {
+	case IR_ADD:
+		v = (int)((unsigned)x + (unsigned)y);
+		return true;
+	case IR_SUB:
+		v = (int)((unsigned)x - (unsigned)y);
+		return true;
+	case IR_MUL:
+		v = (int)((unsigned)x * (unsigned)y);
+		return true;
+	case IR_MULHI:
+		v = (int)(((long long)x * y) >> 32);
+		return true;
+	case IR_DIV:
+		if (!y || (x == INT_MIN && y == -1))
+			return false;
+		v = x / y;
+		return true;
+	case IR_AND:
+		v = x & y;
+		return true;
+	case IR_OR:
+		v = x | y;
+		return true;
+	case IR_XOR:
+		v = x ^ y;
+		return true;
+	case IR_SHL:
+		v = (int)((unsigned)x << (y & 31));
+		return true;
+	case IR_SHR:
+		v = (int)((unsigned)x >> (y & 31));
+		return true;
+	case IR_SAR:
+		v = x >> (y & 31);
+		return true;
+	case IR_SETEQ:
+		v = x == y;
+		return true;
+	case IR_SETNE:
+		v = x != y;
+		return true;
+	case IR_SETLT:
+		v = x < y;
+		return true;
+	case IR_SETGT:
+		v = x > y;
+		return true;
+	case IR_SETLE:
+		v = x <= y;
+		return true;
+	case IR_SETGE:
+		v = x >= y;
+		return true;
+	}
+	return false;
+}
+
+//the 2 args of a call made by Node::call
+static bool callArgs(TNode* t, TNode**& a0, TNode**& a1)
+{
+	TNode* s = t->r;
+	if (!s || s->op != IR_SEQ || !s->l || !s->r || s->l->op != IR_MOVE || s->r->op != IR_MOVE)
+		return false;
+	a0 = &s->l->l;
+	a1 = &s->r->l;
+	return true;
+}
+
+static TNode* simplify(TNode* t, int& n)
+{
+	TNode *l = t->l, *r = t->r;
+	int    v;
+
+	if (l && r && l->op == IR_CONST && r->op == IR_CONST && foldInt(t->op, l->iconst, r->iconst, v)) {
+		delete t;
+		++n;
+		return iconst(v);
+	}
+
+	switch (t->op) {
+	case IR_ADD:
+	case IR_MUL:
+	case IR_AND:
+	case IR_OR:
+	case IR_XOR:
+		//constants on the right
+		if (l->op == IR_CONST && r->op != IR_CONST) {
+			t->l = r;
+			t->r = l;
+			l    = t->l;
+			r    = t->r;
+		}
+		break;
+	}
+
+	switch (t->op) {
+	case IR_NEG:
+		if (l->op == IR_CONST) {
+			++n;
+			v = (int)(0u - (unsigned)l->iconst);
+			delete t;
+			return iconst(v);
+		}
+		if (l->op == IR_NEG) {
+			++n;
+			TNode* p = keep(t, t->l);
+			return keep(p, p->l);
+		}
+		break;
+	case IR_ADD:
+		if (r->op != IR_CONST)
+			break;
+		if (!r->iconst) {
+			++n;
+			return keep(t, t->l);
+		}
+		if (l->op == IR_ADD && l->r->op == IR_CONST) {
+			++n;
+			l->r->iconst = (int)((unsigned)l->r->iconst + (unsigned)r->iconst);
+			return simplify(keep(t, t->l), n);
+		}
+		break;
+	case IR_SUB:
+		if (r->op == IR_CONST && r->iconst != INT_MIN) {
+			++n;
+			t->op     = IR_ADD;
+			r->iconst = -r->iconst;
+			return simplify(t, n);
+		}
+		if (isConst(l, 0)) {
+			++n;
+			return simplify(new TNode(IR_NEG, keep(t, t->r)), n);
+		}
+		if (isPure(l) && same(l, r)) {
+			++n;
+			delete t;
+			return iconst(0);
+		}
+		break;
+	case IR_MUL:
+		if (r->op != IR_CONST)
+			break;
+		if (!r->iconst && isPure(l)) {
+			++n;
+			delete t;
+			return iconst(0);
+		}
+		if (r->iconst == 1) {
+			++n;
+			return keep(t, t->l);
+		}
+		if (r->iconst == -1) {
+			++n;
+			return simplify(new TNode(IR_NEG, keep(t, t->l)), n);
+		}
+		if (l->op == IR_MUL && l->r->op == IR_CONST) {
+			++n;
+			l->r->iconst = (int)((unsigned)l->r->iconst * (unsigned)r->iconst);
+			return simplify(keep(t, t->l), n);
+		}
+		break;
+	case IR_DIV:
+		if (r->op != IR_CONST)
+			break;
+		if (r->iconst == 1) {
+			++n;
+			return keep(t, t->l);
+		}
+		if (r->iconst == -1) {
+			++n;
+			return simplify(new TNode(IR_NEG, keep(t, t->l)), n);
+		}
+		if (r->iconst != 0 && r->iconst != INT_MIN && isSimple(l)) {
+			++n;
+			int d = r->iconst;
+			TNode* q = divConst(keep(t, t->l), d < 0 ? -d : d);
+			return d < 0 ? new TNode(IR_NEG, q) : q;
+		}
+		break;
+	case IR_AND:
+		if (r->op != IR_CONST)
+			break;
+		if (!r->iconst && isPure(l)) {
+			++n;
+			delete t;
+			return iconst(0);
+		}
+		if (r->iconst == -1) {
+			++n;
+			return keep(t, t->l);
+		}
+		break;
+	case IR_OR:
+	case IR_XOR:
+		if (isConst(r, 0)) {
+			++n;
+			return keep(t, t->l);
+		}
+		break;
+	case IR_SHL:
+	case IR_SHR:
+	case IR_SAR:
+		if (r->op == IR_CONST && !(r->iconst & 31)) {
+			++n;
+			return keep(t, t->l);
+		}
+		break;
+	case IR_CALL:
+		//Mod is a runtime call
+		if (l->op == IR_GLOBAL && l->sconst == "__bbMod") {
+			TNode **a0, **a1;
+			if (!callArgs(t, a0, a1) || (*a1)->op != IR_CONST)
+				break;
+			int d = (*a1)->iconst;
+			if ((*a0)->op == IR_CONST && foldInt(IR_DIV, (*a0)->iconst, d, v)) {
+				++n;
+				v = (*a0)->iconst % d;
+				delete t;
+				return iconst(v);
+			}
+			if (d == 0 || d == INT_MIN || !isSimple(*a0))
+				break;
+			++n;
+			if (d == 1 || d == -1) {
+				delete t;
+				return iconst(0);
+			}
+			return modConst(keep(t, *a0), d < 0 ? -d : d);
+		}
+		break;
+	}
+	return t;
+}
+
+static TNode* fold(TNode* t, int& n)
+{
+	if (!t)
+		return 0;
+	t->l = fold(t->l, n);
+	t->r = fold(t->r, n);
+	return simplify(t, n);
+}
+
+//fold a statement - returns false if it's gone
+static bool foldStmt(TNode*& t, int& n)
+{
+	t = fold(t, n);
+	if ((t->op == IR_JUMPT || t->op == IR_JUMPF) && t->l->op == IR_CONST) {
+		++n;
+		if ((t->l->iconst != 0) == (t->op == IR_JUMPT)) {
+			TNode* j = new TNode(IR_JUMP, 0, 0, t->sconst);
+			delete t;
+			t = j;
+		} else {
+			delete t;
+			t = 0;
+			return false;
+		}
+	}
+	return true;
+}
+
+class FoldPass : public OptPass {
+	public:
+	FoldPass() : OptPass("fold") {}
+
+	int run(OptFunc& f)
+	{
+		int n = 0;
+		for (int k = 0; k < f.stmts.size(); ++k) {
+			if (f.stmts[k].t && !foldStmt(f.stmts[k].t, n))
+				f.stmts.erase(f.stmts.begin() + k--);
+		}
+		f.cleanup = fold(f.cleanup, n);
+		return n;
+	}
+};
+
+///////////////////////////////////////////////////////////
+// Constant propagation - locals holding known constants //
+///////////////////////////////////////////////////////////
+static int propagate(TNode*& t, const std::map<int, int>& consts)
+{
+	if (!t)
+		return 0;
+	if (t->op == IR_MEM && t->l->op == IR_LOCAL) {
+		std::map<int, int>::const_iterator it = consts.find(t->l->iconst);
+		if (it == consts.end())
+			return 0;
+		delete t;
+		t = iconst(it->second);
+		return 1;
+	}
+	if (t->op == IR_MOVE && t->r->op == IR_MEM)
+		return propagate(t->l, consts) + propagate(t->r->l, consts);
+	return propagate(t->l, consts) + propagate(t->r, consts);
+}
+
+//a=b=...=const
+static void learn(TNode* t, std::map<int, int>& consts, const std::set<int>& taken)
+{
+	TNode* v = t;
+	while (v->op == IR_MOVE)
+		v = v->l;
+	if (v->op != IR_CONST)
+		return;
+	for (; t->op == IR_MOVE; t = t->l) {
+		if (t->r->op == IR_MEM && t->r->l->op == IR_LOCAL && !taken.count(t->r->l->iconst))
+			consts[t->r->l->iconst] = v->iconst;
+	}
+}
+
+class ConstPropPass : public OptPass {
+	public:
+	ConstPropPass() : OptPass("constprop") {}
+
+	int run(OptFunc& f)
+	{
+		std::set<int>      taken = takenLocals(f);
+		std::map<int, int> consts;
+
+		int n = 0;
+		for (int k = 0; k < f.stmts.size(); ++k) {
+			TNode*& t = f.stmts[k].t;
+			if (!t) {
+				consts.clear();
+				continue;
+			}
+
+			//only what's known before the statement and not changed by it
+			Effects e;
+			innerEffects(t, taken, e);
+			std::map<int, int> in;
+			if (!e.all) {
+				std::map<int, int>::iterator it;
+				for (it = consts.begin(); it != consts.end(); ++it) {
+					if (!e.locals.count(it->first))
+						in.insert(*it);
+				}
+			}
+			if (propagate(t, in)) {
+				++n;
+				if (!foldStmt(t, n)) {
+					f.stmts.erase(f.stmts.begin() + k--);
+					continue;
+				}
+			}
+
+			e = Effects();
+			effects(t, taken, e);
+			if (e.all) {
+				consts.clear();
+			} else {
+				std::set<int>::iterator it;
+				for (it = e.locals.begin(); it != e.locals.end(); ++it)
+					consts.erase(*it);
+			}
+			learn(t, consts, taken);
+		}
+		return n;
+	}
+};
+
+///////////////////////////////////////////////////////////////
+// Common subexpressions - within a block, expressions worth //
+// more than a store and a load are kept in a temp.          //
+///////////////////////////////////////////////////////////////
+struct Occurence {
+	int     stmt;
+	TNode** slot;
+};
+
+struct CSEGroup {
+	TNode*                 expr;
+	Reads                  deps;
+	int                    cost;
+	std::vector<Occurence> occurs;
+
+	int savings() const
+	{
+		int n = occurs.size();
+		return (n - 1) * cost - 2 - n * 2;
+	}
+};
+
+static void collect(TNode** slot, int stmt, std::vector<Occurence>& out)
+{
+	TNode* t = *slot;
+	if (!t)
+		return;
+	if (t->op == IR_MOVE && t->r->op == IR_MEM) {
+		collect(&t->l, stmt, out);
+		collect(&t->r->l, stmt, out);
+		return;
+	}
+	if (cost(t) > 2 && isPure(t)) {
+		Occurence o = {stmt, slot};
+		out.push_back(o);
+	}
+	collect(&t->l, stmt, out);
+	collect(&t->r, stmt, out);
+}
+
+class CSEPass : public OptPass {
+	public:
+	CSEPass() : OptPass("cse") {}
+
+	int run(OptFunc& f)
+	{
+		std::set<int> taken = takenLocals(f);
+
+		int n = 0;
+		for (int begin = 0; begin < f.stmts.size();) {
+			int end = begin + 1;
+			while (end < f.stmts.size() && f.stmts[end].t)
+				++end;
+			for (int tries = 0; tries < 16 && cseBlock(f, begin, end, taken); ++tries) {
+				++end;
+				++n;
+			}
+			begin = end;
+		}
+		return n;
+	}
+
+	private:
+	bool cseBlock(OptFunc& f, int begin, int end, const std::set<int>& taken)
+	{
+		std::map<std::string, CSEGroup>           open;
+		std::vector<CSEGroup>                     done;
+		std::map<std::string, CSEGroup>::iterator it;
+
+		for (int k = begin; k < end; ++k) {
+			TNode* t = f.stmts[k].t;
+			if (!t)
+				continue;
+
+			Effects inner, all;
+			innerEffects(t, taken, inner);
+			effects(t, taken, all);
+
+			std::vector<Occurence> occs;
+			collect(&f.stmts[k].t, k, occs);
+			for (int j = 0; j < occs.size(); ++j) {
+				TNode* e = *occs[j].slot;
+				Reads  r;
+				reads(e, taken, r);
+				if (clobbers(inner, r))
+					continue;
+				CSEGroup& g = open[key(e)];
+				if (g.occurs.empty()) {
+					g.expr = e;
+					g.deps = r;
+					g.cost = cost(e);
+				}
+				g.occurs.push_back(occs[j]);
+			}
+
+			for (it = open.begin(); it != open.end();) {
+				if (clobbers(all, it->second.deps)) {
+					done.push_back(it->second);
+					open.erase(it++);
+				} else {
+					++it;
+				}
+			}
+		}
+		for (it = open.begin(); it != open.end(); ++it)
+			done.push_back(it->second);
+
+		CSEGroup* best = 0;
+		for (int k = 0; k < done.size(); ++k) {
+			if (done[k].savings() > 0 && (!best || done[k].savings() > best->savings()))
+				best = &done[k];
+		}
+		if (!best)
+			return false;
+
+		int    temp = f.newTemp();
+		TNode* init = new TNode(IR_MOVE, copy(best->expr), local(temp));
+		for (int k = 0; k < best->occurs.size(); ++k) {
+			TNode** slot = best->occurs[k].slot;
+			delete *slot;
+			*slot = local(temp);
+		}
+		OptFunc::Stmt s;
+		s.t = init;
+		f.stmts.insert(f.stmts.begin() + best->occurs[0].stmt, s);
+		return true;
+	}
+};
+
+//////////////////////////////////////////////////////////////
+// Dead stores - to locals that are never read, or that are //
+// stored to again before they're read.                     //
+//////////////////////////////////////////////////////////////
+static int storedLocal(TNode* t, const std::set<int>& taken)
+{
+	if (t->op != IR_MOVE || t->r->op != IR_MEM || t->r->l->op != IR_LOCAL)
+		return 0;
+	int offset = t->r->l->iconst;
+	return taken.count(offset) ? 0 : offset;
+}
+
+class DSEPass : public OptPass {
+	public:
+	DSEPass() : OptPass("dse") {}
+
+	int run(OptFunc& f)
+	{
+		std::set<int> taken = takenLocals(f);
+
+		//Gosubs only read what's in the function anyway
+		Reads used;
+		for (int k = 0; k < f.stmts.size(); ++k)
+			reads(f.stmts[k].t, taken, used);
+		reads(f.cleanup, taken, used);
+
+		int n = 0;
+		for (int k = 0; k < f.stmts.size(); ++k) {
+			TNode*& t      = f.stmts[k].t;
+			int     offset = t ? storedLocal(t, taken) : 0;
+			if (!offset)
+				continue;
+			if (used.locals.count(offset) && (!isPure(t->l) || !overwritten(f, k, offset, taken)))
+				continue;
+			++n;
+			if (isPure(t->l)) {
+				delete t;
+				f.stmts.erase(f.stmts.begin() + k--);
+			} else {
+				t = keep(t, t->l);
+			}
+		}
+		return n;
+	}
+
+	private:
+	bool overwritten(OptFunc& f, int k, int offset, const std::set<int>& taken)
+	{
+		while (++k < f.stmts.size()) {
+			TNode* t = f.stmts[k].t;
+			if (!t)
+				return false;
+			Reads r;
+			reads(t, taken, r);
+			if (r.all || r.locals.count(offset))
+				return false;
+			if (storedLocal(t, taken) == offset)
+				return true;
+			Effects e;
+			effects(t, taken, e);
+			if (e.jumps)
+				return false;
+		}
+		return false;
+	}
+};
+
+///////////////////////////////////////////////////////////////
+// Loops - invariant expressions are hoisted out, multiplies //
+// by an induction var become pointer increments, and short  //
+// constant For loops are unrolled.                          //
+///////////////////////////////////////////////////////////////
+static const int MAX_UNROLL       = 8;   //iterations
+static const int MAX_UNROLL_NODES = 160; //IR nodes, once unrolled
+static const int MIN_HOIST        = 3;   //cost worth a temp
+
+//what a loop writes - finer than Effects, so the headers of arrays whose
+//elements are written can still be seen to be invariant
+struct LoopWrites {
+	std::set<int>         locals;
+	std::set<std::string> globals; //vars, arrays and vectors
+	bool                  heap;    //through pointers, or to taken locals
+	bool                  allGlobals, all;
+	LoopWrites() : heap(false), allGlobals(false), all(false) {}
+};
+
+//the global an address is in, if it's in one
+static const std::string* globalOf(TNode* a)
+{
+	if (a->op == IR_ADD && a->l->op == IR_GLOBAL)
+		a = a->l;
+	return a->op == IR_GLOBAL ? &a->sconst : 0;
+}
+
+//globals whose address is passed to a call
+static void passedGlobals(TNode* t, bool deref, LoopWrites& w)
+{
+	if (!t)
+		return;
+	if (t->op == IR_GLOBAL && !deref)
+		w.globals.insert(t->sconst);
+	bool d = t->op == IR_MEM || (deref && (t->op == IR_ADD || t->op == IR_SUB));
+	passedGlobals(t->l, d, w);
+	passedGlobals(t->r, d, w);
+}
+
+static void loopWrites(TNode* t, const std::set<int>& taken, LoopWrites& w)
+{
+	if (!t)
+		return;
+	switch (t->op) {
+	case IR_MOVE:
+		if (t->r->op == IR_MEM) {
+			TNode* a = t->r->l;
+			if (a->op == IR_LOCAL && !taken.count(a->iconst))
+				w.locals.insert(a->iconst);
+			else if (const std::string* g = globalOf(a))
+				w.globals.insert(*g);
+			else if (a->op != IR_ARG)
+				w.heap = true;
+		}
+		break;
+	case IR_CALL:
+	case IR_FCALL:
+		//user functions can write any global, the runtime only those passed to it
+		w.heap = true;
+		if (t->l->op != IR_GLOBAL || !t->l->sconst.compare(0, 2, "_f"))
+			w.allGlobals = true;
+		passedGlobals(t->r, false, w);
+		break;
+	case IR_JSR:
+		w.all = true;
+		break;
+	}
+	loopWrites(t->l, taken, w);
+	loopWrites(t->r, taken, w);
+}
+
+static bool invariant(TNode* t, const LoopWrites& w, const std::set<int>& taken)
+{
+	if (!t)
+		return true;
+	if (w.all)
+		return false;
+	if (t->op == IR_MEM) {
+		TNode* a = t->l;
+		if (a->op == IR_LOCAL)
+			return taken.count(a->iconst) ? !w.heap : !w.locals.count(a->iconst);
+		if (const std::string* g = globalOf(a)) {
+			if (w.allGlobals || w.globals.count(*g))
+				return false;
+		} else if (a->op == IR_ARG || w.heap) {
+			return false;
+		}
+	}
+	return invariant(t->l, w, taken) && invariant(t->r, w, taken);
+}
+
+//can be evaluated before the loop, even if the loop wouldn't have - no loads
+//through pointers that might be null, and no divides
+static bool isSafe(TNode* t)
+{
+	if (!t)
+		return true;
+	if (t->op == IR_DIV)
+		return false;
+	if (t->op == IR_MEM) {
+		TNode* a = t->l;
+		if (a->op != IR_LOCAL && a->op != IR_GLOBAL &&
+			!(a->op == IR_ADD && a->l->op == IR_GLOBAL && a->r->op == IR_CONST))
+			return false;
+	}
+	return isSafe(t->l) && isSafe(t->r);
+}
+
+static bool isLocal(TNode* t, int o)
+{
+	return t->op == IR_MEM && t->l->op == IR_LOCAL && t->l->iconst == o;
+}
+
+static bool mentions(TNode* t, int o)
+{
+	return t && (isLocal(t, o) || mentions(t->l, o) || mentions(t->r, o));
+}
+
+//o is multiplied by something in t
+static bool scales(TNode* t, int o)
+{
+	if (!t)
+		return false;
+	if ((t->op == IR_MUL || t->op == IR_SHL) && (mentions(t->l, o) || mentions(t->r, o)))
+		return true;
+	return scales(t->l, o) || scales(t->r, o);
+}
+
+static TNode* arith(int op, TNode* l, TNode* r)
+{
+	int v;
+	if (l->op == IR_CONST && r->op == IR_CONST && foldInt(op, l->iconst, r->iconst, v)) {
+		delete l;
+		delete r;
+		return iconst(v);
+	}
+	if ((op == IR_MUL && isConst(r, 1)) || ((op == IR_ADD || op == IR_SUB) && isConst(r, 0))) {
+		delete r;
+		return l;
+	}
+	if ((op == IR_MUL && isConst(l, 1)) || (op == IR_ADD && isConst(l, 0))) {
+		delete l;
+		return r;
+	}
+	return new TNode(op, l, r);
+}
+
+//t is x+o*s, with x and s invariant - returns s, or 0 if t isn't like that
+static TNode* stride(TNode* t, int o, const LoopWrites& w, const std::set<int>& taken)
+{
+	if (isLocal(t, o))
+		return iconst(1);
+	if (!mentions(t, o))
+		return isPure(t) && invariant(t, w, taken) ? iconst(0) : 0;
+
+	TNode *a, *b;
+	switch (t->op) {
+	case IR_ADD:
+	case IR_SUB:
+		if (!(a = stride(t->l, o, w, taken)))
+			return 0;
+		if (!(b = stride(t->r, o, w, taken))) {
+			delete a;
+			return 0;
+		}
+		return arith(t->op, a, b);
+	case IR_MUL:
+		b = mentions(t->l, o) ? t->r : t->l;
+		if (mentions(b, o) || !isPure(b) || !invariant(b, w, taken))
+			return 0;
+		if (!(a = stride(b == t->r ? t->l : t->r, o, w, taken)))
+			return 0;
+		return arith(IR_MUL, a, copy(b));
+	case IR_SHL:
+		if (t->r->op != IR_CONST || !(a = stride(t->l, o, w, taken)))
+			return 0;
+		return arith(IR_MUL, a, iconst(1 << (t->r->iconst & 31)));
+	}
+	return 0;
+}
+
+class LoopPass : public OptPass {
+	public:
+	LoopPass() : OptPass("loops") {}
+
+	int run(OptFunc& f)
+	{
+		int                   n = 0;
+		std::set<std::string> done;
+		for (;;) {
+			//innermost loops first, so what they hoist can be hoisted again
+			int head, back, pre, best = INT_MAX;
+			findLabels(f);
+			for (int k = 0; k < f.stmts.size(); ++k) {
+				TNode* t = f.stmts[k].t;
+				int    h;
+				if (!t || !isJump(t->op) || (h = target(t)) < 0 || h >= k || done.count(f.stmts[h].label))
+					continue;
+				int b = k;
+				for (int j = k + 1; j < f.stmts.size(); ++j) {
+					if (f.stmts[j].t && isJump(f.stmts[j].t->op) && target(f.stmts[j].t) == h)
+						b = j;
+				}
+				if (b - h < best) {
+					best = b - h;
+					head = h;
+					back = b;
+				}
+			}
+			if (best == INT_MAX)
+				break;
+			done.insert(f.stmts[head].label);
+			if (!entry(f, head, back, pre))
+				continue;
+			if (int u = unroll(f, head, back, pre)) {
+				n += u;
+				continue;
+			}
+			n += optimize(f, head, back, pre);
+		}
+		return n;
+	}
+
+	private:
+	std::map<std::string, int> labels;
+
+	static bool isJump(int op)
+	{
+		return op == IR_JUMP || op == IR_JUMPT || op == IR_JUMPF || op == IR_JUMPGE || op == IR_JSR;
+	}
+
+	void findLabels(OptFunc& f)
+	{
+		labels.clear();
+		for (int k = 0; k < f.stmts.size(); ++k) {
+			if (!f.stmts[k].t)
+				labels[f.stmts[k].label] = k;
+		}
+	}
+
+	int target(TNode* t)
+	{
+		std::map<std::string, int>::iterator it = labels.find(t->sconst);
+		return it == labels.end() ? -1 : it->second;
+	}
+
+	//the loop can only be entered at the top, or by a jump just before it -
+	//pre is where code to run once on the way in goes.
+	bool entry(OptFunc& f, int head, int back, int& pre)
+	{
+		pre = head;
+		for (int k = 0; k < f.stmts.size(); ++k) {
+			TNode* t = f.stmts[k].t;
+			if (k == head || (k > head && k <= back) || !t || !isJump(t->op))
+				continue;
+			int j = target(t);
+			if (j < head || j > back)
+				continue;
+			if (k != head - 1 || t->op != IR_JUMP)
+				return false;
+			pre = k;
+		}
+		if (pre == head && head > 0) {
+			TNode* t = f.stmts[head - 1].t;
+			if (t && (t->op == IR_JUMP || t->op == IR_RETURN || t->op == IR_FRETURN || t->op == IR_RET))
+				return false;
+		}
+		return true;
+	}
+
+	//For v=from To to Step step, with a constant trip count and a body with no
+	//control flow of its own
+	int unroll(OptFunc& f, int head, int back, int pre)
+	{
+		std::set<int> taken = takenLocals(f);
+		if (pre != head - 1 || pre < 1 || back - head < 3)
+			return 0;
+		TNode *init = f.stmts[pre - 1].t, *inc = f.stmts[back - 2].t, *test = f.stmts[back].t;
+		if (!init || !inc || f.stmts[back - 1].t || f.stmts[back - 1].label != f.stmts[pre].t->sconst)
+			return 0;
+		if (test->op != IR_JUMPF || (test->l->op != IR_SETGT && test->l->op != IR_SETLT))
+			return 0;
+		TNode* v = test->l->l;
+		if (v->op != IR_MEM || v->l->op != IR_LOCAL || taken.count(v->l->iconst) || test->l->r->op != IR_CONST)
+			return 0;
+		int o = v->l->iconst;
+		if (init->op != IR_MOVE || !isLocal(init->r, o) || init->l->op != IR_CONST)
+			return 0;
+		if (inc->op != IR_MOVE || !isLocal(inc->r, o) || inc->l->op != IR_ADD || !isLocal(inc->l->l, o) ||
+			inc->l->r->op != IR_CONST)
+			return 0;
+
+		long long from = init->l->iconst, to = test->l->r->iconst, step = inc->l->r->iconst, trips;
+		if (step > 0 && test->l->op == IR_SETGT)
+			trips = from > to ? 0 : (to - from) / step + 1;
+		else if (step < 0 && test->l->op == IR_SETLT)
+			trips = from < to ? 0 : (from - to) / -step + 1;
+		else
+			return 0;
+
+		int nodes = 0;
+		for (int k = head + 1; k < back - 2; ++k) {
+			TNode* t = f.stmts[k].t;
+			Effects e;
+			if (!t)
+				return 0;
+			effects(t, taken, e);
+			if (e.jumps || e.all || e.locals.count(o))
+				return 0;
+			nodes += countNodes(t);
+		}
+		if (trips > MAX_UNROLL || trips * nodes > MAX_UNROLL_NODES)
+			return 0;
+
+		std::vector<OptFunc::Stmt> body;
+		for (int i = 0; i < trips; ++i) {
+			for (int k = head + 1; k < back - 2; ++k) {
+				OptFunc::Stmt s;
+				s.t = copy(f.stmts[k].t);
+				body.push_back(s);
+			}
+			OptFunc::Stmt s;
+			s.t = new TNode(IR_MOVE, iconst((int)(unsigned)(from + (i + 1) * step)), local(o));
+			body.push_back(s);
+		}
+		for (int k = pre; k <= back; ++k)
+			delete f.stmts[k].t;
+		f.stmts.erase(f.stmts.begin() + pre, f.stmts.begin() + back + 1);
+		f.stmts.insert(f.stmts.begin() + pre, body.begin(), body.end());
+		return 1;
+	}
+
+	struct Hoisted {
+		std::map<std::string, int> temps;
+		std::vector<TNode*>        init;
+	};
+
+	int optimize(OptFunc& f, int head, int back, int pre)
+	{
+		std::set<int> taken = takenLocals(f);
+		LoopWrites    w;
+		for (int k = head; k <= back; ++k)
+			loopWrites(f.stmts[k].t, taken, w);
+		if (w.all)
+			return 0;
+
+		//induction vars - locals only changed by a constant step
+		std::map<int, int> stores, steps, incs;
+		for (int k = head; k <= back; ++k) {
+			TNode* t = f.stmts[k].t;
+			Effects e;
+			if (!t)
+				continue;
+			effects(t, taken, e);
+			std::set<int>::iterator it;
+			for (it = e.locals.begin(); it != e.locals.end(); ++it)
+				++stores[*it];
+			if (t->op == IR_MOVE && t->r->op == IR_MEM && t->r->l->op == IR_LOCAL && t->l->op == IR_ADD &&
+				isLocal(t->l->l, t->r->l->iconst) && t->l->r->op == IR_CONST) {
+				steps[t->r->l->iconst] = t->l->r->iconst;
+				incs[t->r->l->iconst]  = k;
+			}
+		}
+
+		int     n = 0;
+		Hoisted h;
+		std::vector<std::pair<int, TNode*> > after; //pointer increments, after the induction var's
+		std::map<int, int>::iterator it;
+		for (it = incs.begin(); it != incs.end(); ++it) {
+			if (stores[it->first] != 1 || taken.count(it->first))
+				continue;
+			int o = it->first;
+			std::map<std::string, int> ptrs;
+			for (int k = head; k <= back; ++k) {
+				if (k != it->second)
+					n += reduce(f, f.stmts[k].t, o, steps[o], it->second, pre, w, taken, ptrs, h, after);
+			}
+		}
+		for (int k = head; k <= back; ++k)
+			n += hoist(f, f.stmts[k].t, w, taken, h);
+
+		//increments go in from the back, so the indices stay good
+		std::stable_sort(after.begin(), after.end());
+		for (int k = after.size() - 1; k >= 0; --k) {
+			OptFunc::Stmt s;
+			s.t = after[k].second;
+			f.stmts.insert(f.stmts.begin() + after[k].first + 1, s);
+		}
+		for (int k = h.init.size() - 1; k >= 0; --k) {
+			OptFunc::Stmt s;
+			s.t = h.init[k];
+			f.stmts.insert(f.stmts.begin() + pre, s);
+		}
+		return n;
+	}
+
+	//a copy of t for the preheader - the store just before it is known to
+	//have happened, eg: the For var's initial value
+	TNode* preCopy(OptFunc& f, TNode* t, int pre, const std::set<int>& taken)
+	{
+		TNode* c = copy(t);
+		TNode* s = pre > 0 ? f.stmts[pre - 1].t : 0;
+		if (s && s->op == IR_MOVE && s->l->op == IR_CONST && s->r->op == IR_MEM && s->r->l->op == IR_LOCAL &&
+			!taken.count(s->r->l->iconst)) {
+			std::map<int, int> known;
+			known[s->r->l->iconst] = s->l->iconst;
+			if (propagate(c, known)) {
+				int n;
+				c = fold(c, n);
+			}
+		}
+		return c;
+	}
+
+	//replaces expressions like base+o*scale with a pointer that's stepped along with o
+	int reduce(OptFunc& f, TNode*& t, int o, int step, int inc, int pre, LoopWrites& w,
+			   const std::set<int>& taken, std::map<std::string, int>& ptrs, Hoisted& h,
+			   std::vector<std::pair<int, TNode*> >& after)
+	{
+		if (!t || !mentions(t, o))
+			return 0;
+		if (t->op == IR_MOVE && t->r->op == IR_MEM)
+			return reduce(f, t->l, o, step, inc, pre, w, taken, ptrs, h, after) +
+				   reduce(f, t->r->l, o, step, inc, pre, w, taken, ptrs, h, after);
+
+		//the pointer starts out in the preheader, so like anything hoisted its base
+		//has to be safe to evaluate even if the loop doesn't run
+		TNode* s;
+		if (t->op != IR_MEM && scales(t, o) && isSafe(t) && (s = stride(t, o, w, taken))) {
+			if (isConst(s, 0)) {
+				delete s;
+				return 0;
+			}
+			std::string k = key(t);
+			if (!ptrs.count(k)) {
+				int p   = f.newTemp();
+				ptrs[k] = p;
+				w.locals.insert(p);
+				h.init.push_back(new TNode(IR_MOVE, preCopy(f, t, pre, taken), local(p)));
+
+				//p+=step*s
+				TNode* d = arith(IR_MUL, s, iconst(step));
+				if (d->op != IR_CONST) {
+					int q = f.newTemp();
+					h.init.push_back(new TNode(IR_MOVE, d, local(q)));
+					d = local(q);
+				}
+				after.push_back(std::make_pair(inc, new TNode(IR_MOVE, new TNode(IR_ADD, local(p), d), local(p))));
+			} else {
+				delete s;
+			}
+			delete t;
+			t = local(ptrs[k]);
+			return 1;
+		}
+		return reduce(f, t->l, o, step, inc, pre, w, taken, ptrs, h, after) +
+			   reduce(f, t->r, o, step, inc, pre, w, taken, ptrs, h, after);
+	}
+
+	int hoist(OptFunc& f, TNode*& t, const LoopWrites& w, const std::set<int>& taken, Hoisted& h)
+	{
+		if (!t)
+			return 0;
+		if (t->op == IR_MOVE && t->r->op == IR_MEM)
+			return hoist(f, t->l, w, taken, h) + hoist(f, t->r->l, w, taken, h);
+
+		if (t->op != IR_CONST && !isSimple(t) && cost(t) >= MIN_HOIST && isPure(t) && isSafe(t) &&
+			invariant(t, w, taken)) {
+			std::string k = key(t);
+			if (!h.temps.count(k)) {
+				int p      = f.newTemp();
+				h.temps[k] = p;
+				h.init.push_back(new TNode(IR_MOVE, copy(t), local(p)));
+			}
+			delete t;
+			t = local(h.temps[k]);
+			return 1;
+		}
+		return hoist(f, t->l, w, taken, h) + hoist(f, t->r, w, taken, h);
+	}
+};
+
+//////////////////////
+// The pass manager //
+//////////////////////
+Optimizer::Optimizer() : funcs(0), nodesIn(0), nodesOut(0)
+{
+	passes.push_back(new FoldPass());
+	passes.push_back(new LoopPass());
+	passes.push_back(new ConstPropPass());
+	passes.push_back(new CSEPass());
+	passes.push_back(new DSEPass());
+
+	//fold, loops, constprop, cse, dse, then fold what dse left behind
+	for (int k = 0; k < passes.size(); ++k)
+		order.push_back(k);
+	order.push_back(0);
+}
+
+Optimizer::~Optimizer()
+{
+	for (int k = 0; k < passes.size(); ++k)
+		delete passes[k];
+}
+
+static int countNodes(OptFunc& f)
+{
+	int n = countNodes(f.cleanup);
+	for (int k = 0; k < f.stmts.size(); ++k)
+		n += countNodes(f.stmts[k].t);
+	return n;
+}
+
+void Optimizer::optimize(OptFunc& f)
+{
+	++funcs;
+	nodesIn += countNodes(f);
+	for (int k = 0; k < order.size(); ++k) {
+		OptPass* p = passes[order[k]];
+
+		std::chrono::high_resolution_clock::time_point t0 = std::chrono::high_resolution_clock::now();
+		p->changes += p->run(f);
+		p->micros += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - t0)
+						 .count();
+	}
+	nodesOut += countNodes(f);
+}
+
+void Optimizer::report(std::ostream& out)
+{
+	out << "Optimized " << funcs << " functions, " << nodesIn << " -> " << nodesOut << " IR nodes" << std::endl;
+	for (int k = 0; k < passes.size(); ++k) {
+		OptPass* p = passes[k];
+		out << "  " << std::left << std::setw(10) << p->name << std::right << std::setw(8) << p->changes << " changes "
+			<< std::setw(8) << std::fixed << std::setprecision(2) << p->micros / 1000.0 << "ms" << std::endl;
+	}
+}
+
+////////////////////////////////////////////////////////
+// The codegen - buffers each function, passes it on. //
+////////////////////////////////////////////////////////
+OptCodegen::OptCodegen(Codegen* g, Optimizer* opt)
+	: Codegen(g->out, g->debug), g(g), opt(opt), owner(false), inCode(false), func(0)
+{}
+
+OptCodegen::~OptCodegen()
+{
+	delete func;
+	if (owner)
+		delete g;
+}
+
+Codegen* OptCodegen::fork()
+{
+	Codegen* w = g->fork();
+	if (!w)
+		return 0;
+	OptCodegen* o = new OptCodegen(w, opt);
+	o->owner      = true;
+	return o;
+}
+
+void OptCodegen::enter(const std::string& l, int frameSize)
+{
+	inCode          = true;
+	funcLabel       = l;
+	func            = new OptFunc();
+	func->frameSize = frameSize;
+}
+
+void OptCodegen::code(TNode* code)
+{
+	if (!inCode) {
+		g->code(code);
+		return;
+	}
+	OptFunc::Stmt s;
+	s.t = code;
+	func->stmts.push_back(s);
+}
+
+void OptCodegen::leave(TNode* cleanup, int pop_sz)
+{
+	func->cleanup = cleanup;
+	opt->optimize(*func);
+
+	g->enter(funcLabel, func->frameSize);
+	for (int k = 0; k < func->stmts.size(); ++k) {
+		OptFunc::Stmt& s = func->stmts[k];
+		if (s.t)
+			g->code(s.t);
+		else
+			g->label(s.label);
+		s.t = 0;
+	}
+	g->leave(func->cleanup, pop_sz);
+	func->cleanup = 0;
+
+	delete func;
+	func   = 0;
+	inCode = false;
+}
+
+void OptCodegen::label(const std::string& l)
+{
+	if (!inCode) {
+		g->label(l);
+		return;
+	}
+	OptFunc::Stmt s;
+	s.t     = 0;
+	s.label = l;
+	func->stmts.push_back(s);
+}
+
+void OptCodegen::i_data(int i, const std::string& l)
+{
+	g->i_data(i, l);
+}
+
+void OptCodegen::s_data(const std::string& s, const std::string& l)
+{
+	g->s_data(s, l);
+}
+
+void OptCodegen::p_data(const std::string& p, const std::string& l)
+{
+	g->p_data(p, l);
+}
+
+void OptCodegen::w_data(int i, const std::string& l)
+{
+	g->w_data(i, l);
+}
+
+void OptCodegen::align_data(int n)
+{
+	g->align_data(n);
+}
+
+void OptCodegen::flush()
+{
+	g->flush();
+}
+
+bool OptCodegen::record(CodeFunc& f)
+{
+	return g->record(f);
+}
+
+bool OptCodegen::replay(const CodeFunc& f)
+{
+	return g->replay(f);
+}
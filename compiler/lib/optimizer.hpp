@@ -0,0 +1,91 @@
+/*
+
+  The optimizer sits between translate and a real codegen. It holds on to each function's
+  statements until the function is left, runs its passes over them and then hands the
+  result on.
+
+  Passes work on one basic block at a time - labels, jumps and Gosubs end a block - except
+  the loop pass, which works on whole loops.
+
+*/
+
+#pragma once
+#include <atomic>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "codegen.hpp"
+
+//a function on its way through the passes
+struct OptFunc {
+	struct Stmt {
+		TNode*      t; //0 for a label
+		std::string label;
+	};
+
+	std::vector<Stmt> stmts;
+	TNode*            cleanup;
+	int               frameSize; //locals, then any temps the passes add
+
+	OptFunc() : cleanup(0), frameSize(0) {}
+	~OptFunc();
+
+	int newTemp(); //offset of a new local
+};
+
+class OptPass {
+	public:
+	const char*            name;
+	std::atomic<int>       changes; //over all functions
+	std::atomic<long long> micros;
+
+	OptPass(const char* name) : name(name), changes(0), micros(0) {}
+	virtual ~OptPass() {}
+
+	//returns the number of changes made
+	virtual int run(OptFunc& f) = 0;
+};
+
+//the pass manager - shared by all the codegens forked for one build
+class Optimizer {
+	public:
+	Optimizer();
+	~Optimizer();
+
+	void optimize(OptFunc& f);
+	void report(std::ostream& out);
+
+	private:
+	std::vector<OptPass*> passes;
+	std::vector<int>      order; //passes can run more than once
+	std::atomic<int>      funcs, nodesIn, nodesOut;
+};
+
+class OptCodegen : public Codegen {
+	public:
+	OptCodegen(Codegen* g, Optimizer* opt);
+	~OptCodegen();
+
+	virtual void enter(const std::string& l, int frameSize);
+	virtual void code(TNode* code);
+	virtual void leave(TNode* cleanup, int pop_sz);
+	virtual void label(const std::string& l);
+	virtual void i_data(int i, const std::string& l);
+	virtual void s_data(const std::string& s, const std::string& l);
+	virtual void p_data(const std::string& p, const std::string& l);
+	virtual void w_data(int i, const std::string& l);
+	virtual void align_data(int n);
+	virtual void flush();
+
+	virtual bool     record(CodeFunc& f);
+	virtual bool     replay(const CodeFunc& f);
+	virtual Codegen* fork();
+
+	private:
+	Codegen*    g;
+	Optimizer*  opt;
+	bool        owner; //forked, so g is ours
+	bool        inCode;
+	std::string funcLabel;
+	OptFunc*    func;
+};
@@ -1,13 +1,18 @@
 #include "parser.hpp"
 #include <cstdlib>
 #include <fstream>
+#include <iterator>
+#include <sys/stat.h>
 #include "ex.hpp"
 
 #include "varnode.hpp"
 
-#include <Windows.h>
 #include <stdutil.hpp>
 
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
 static const int TEXTLIMIT = 1024 * 1024 - 1;
 
 enum { STMTS_PROG, STMTS_BLOCK, STMTS_LINE };
@@ -17,6 +22,62 @@ static bool isTerm(int c)
 	return c == ':' || c == '\n';
 }
 
+////////////////////////////////////////////////////////
+// Include files are kept between compiles, so a      //
+// compile server only rereads the ones that changed. //
+// Only their text is kept - they're parsed again on  //
+// every compile, see codecache.hpp.                  //
+////////////////////////////////////////////////////////
+struct IncludeFile {
+	time_t      mtime;
+	off_t       size;
+	std::string text;
+};
+
+//keyed by fullPath
+static std::map<std::string, IncludeFile> includeCache;
+
+//the absolute path of an include, so it's only included once however it's named -
+//lower case on Windows, where names aren't case sensitive
+static std::string fullPath(const std::string& file)
+{
+#ifdef _WIN32
+	char buff[MAX_PATH], *p;
+	if (!GetFullPathName(file.c_str(), MAX_PATH, buff, &p))
+		return tolower(file);
+	return tolower(buff);
+#else
+	char* t = realpath(file.c_str(), 0);
+	if (!t)
+		return file;
+	std::string s = t;
+	free(t);
+	return s;
+#endif
+}
+
+static const std::string* includeText(const std::string& file)
+{
+	struct stat st;
+	if (stat(file.c_str(), &st))
+		return 0;
+
+	std::map<std::string, IncludeFile>::iterator it = includeCache.find(file);
+	if (it != includeCache.end() && it->second.mtime == st.st_mtime && it->second.size == st.st_size)
+		return &it->second.text;
+
+	std::ifstream in(file.c_str());
+	if (!in.good())
+		return 0;
+	IncludeFile& f = includeCache[file];
+	f.mtime        = st.st_mtime;
+	f.size         = st.st_size;
+	f.text.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+	if (f.text.size() && f.text[f.text.size() - 1] != '\n')
+		f.text += '\n'; //so the Toker can scan it in place
+	return &f.text;
+}
+
 Parser::Parser(Toker& t) : toker(&t), main_toker(&t) {}
 
 std::shared_ptr<ProgNode> Parser::parse(const std::string& main)
@@ -110,22 +171,18 @@ void Parser::parseStmtSeq(std::shared_ptr<StmtSeqNode> stmts, int scope)
 			toker->next();
 			inc = inc.substr(1, inc.size() - 2);
 
-			//WIN32 KLUDGE//
-			char buff[MAX_PATH], *p;
-			if (GetFullPathName(inc.c_str(), MAX_PATH, buff, &p))
-				inc = buff;
-			inc = tolower(inc);
+			inc = fullPath(inc);
 
 			if (included.find(inc) != included.end())
 				break;
 
-			std::ifstream i_stream(inc.c_str());
-			if (!i_stream.good())
+			const std::string* text = includeText(inc);
+			if (!text)
 				ex("Unable to open include file");
 
 			std::swap(this->incfile, inc);
 
-			std::shared_ptr<Toker> i_toker = std::make_shared<Toker>(i_stream);
+			std::shared_ptr<Toker> i_toker = std::make_shared<Toker>(*text);
 			std::swap(this->toker, i_toker);
 
 			included.insert(incfile);
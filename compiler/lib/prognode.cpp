@@ -1,9 +1,15 @@
 #include "prognode.hpp"
+#include <atomic>
+#include <exception>
 #include <map>
+#include <thread>
+#include "codecache.hpp"
 #include "codegen.hpp"
 #include "declnode.hpp"
 #include "environ.hpp"
+#include "ex.hpp"
 #include "label.hpp"
+#include "reach.hpp"
 #include "stmtnode.hpp"
 
 #include <stdutil.hpp>
@@ -29,6 +35,8 @@ ProgNode::~ProgNode()
 std::shared_ptr<Environ> ProgNode::semant(Environ* e)
 {
 	file_lab = genLabel();
+	Reach::clear();
+	FuncDeclNode::clearInlines();
 
 	StmtSeqNode::reset(stmts->file, file_lab);
 
@@ -38,7 +46,9 @@ std::shared_ptr<Environ> ProgNode::semant(Environ* e)
 	structs->proto(env->typeDecls, env);
 	structs->semant(env);
 	funcs->proto(env->funcDecls, env);
+	Reach::begin(0);
 	stmts->semant(env);
+	Reach::end();
 	funcs->semant(env);
 	datas->proto(env->decls, env);
 	datas->semant(env);
@@ -47,13 +57,108 @@ std::shared_ptr<Environ> ProgNode::semant(Environ* e)
 	return env;
 }
 
-void ProgNode::translate(Codegen* g, const std::vector<UserFunc>& usrfuncs)
+///////////////////////////////////////////////////////////////////
+// Translate user functions on 'jobs' threads, each with its own //
+// forked codegen. The code is emitted afterwards in source      //
+// order, so the output is the same as a serial build.           //
+///////////////////////////////////////////////////////////////////
+static void translateFuncs(DeclSeqNode* funcs, Codegen* g, int jobs)
+{
+	int n = funcs->decls.size();
+	if (jobs > n)
+		jobs = n;
+
+	std::vector<Codegen*> workers;
+	for (int k = 0; k < jobs; ++k) {
+		Codegen* w = g->fork();
+		if (!w)
+			break;
+		workers.push_back(w);
+	}
+	if (workers.size() < 2) {
+		for (int k = 0; k < workers.size(); ++k)
+			delete workers[k];
+		funcs->translate(g);
+		return;
+	}
+
+	//funcs only ever holds FuncDeclNodes
+	std::vector<FuncDeclNode*> decls;
+	for (int k = 0; k < n; ++k) {
+		if (funcs->decls[k]->reached())
+			decls.push_back((FuncDeclNode*)funcs->decls[k]);
+	}
+	n = decls.size();
+
+	//cache lookups aren't thread safe, so do them up front...
+	std::vector<const CodeFunc*> cached(n);
+	if (g->cache) {
+		for (int k = 0; k < n; ++k)
+			cached[k] = g->cache->find(decls[k]->file, decls[k]->ident);
+	}
+
+	std::vector<CodeFunc>           code(n);
+	std::vector<std::exception_ptr> errs(n);
+	std::atomic<int>                next(0);
+
+	std::vector<std::thread> threads;
+	for (int t = 0; t < workers.size(); ++t) {
+		Codegen* w = workers[t];
+		threads.push_back(std::thread([&, w]() {
+			for (int k; (k = next++) < n;) {
+				if (cached[k])
+					continue;
+				Node::usedfuncs.clear();
+				try {
+					decls[k]->translateFunc(w);
+					w->record(code[k]);
+					code[k].usedfuncs.assign(Node::usedfuncs.begin(), Node::usedfuncs.end());
+				} catch (...) {
+					errs[k] = std::current_exception();
+				}
+			}
+		}));
+	}
+	for (int t = 0; t < threads.size(); ++t)
+		threads[t].join();
+	for (int t = 0; t < workers.size(); ++t)
+		delete workers[t];
+
+	//...and emit in order. First error wins, as it would have serially.
+	for (int k = 0; k < n; ++k) {
+		FuncDeclNode* d = decls[k];
+		try {
+			if (const CodeFunc* f = cached[k]) {
+				g->replay(*f);
+				Node::usedfuncs.insert(f->usedfuncs.begin(), f->usedfuncs.end());
+				continue;
+			}
+			if (errs[k])
+				std::rethrow_exception(errs[k]);
+			g->replay(code[k]);
+			Node::usedfuncs.insert(code[k].usedfuncs.begin(), code[k].usedfuncs.end());
+			d->store(g, code[k]);
+		} catch (BlitzException& x) {
+			if (x.pos < 0)
+				x.pos = d->pos;
+			if (!x.file.size())
+				x.file = d->file;
+			throw;
+		}
+	}
+}
+
+void ProgNode::translate(Codegen* g, const std::vector<UserFunc>& usrfuncs, int jobs)
 {
 	int k;
 
 	if (g->debug)
 		g->s_data(stmts->file, file_lab);
 
+	//leave out whatever the main program can't reach - the debugger wants it all
+	if (!g->debug)
+		Reach::walk(sem_env.get());
+
 	//enumerate locals
 	int size = enumVars(sem_env);
 
@@ -107,7 +212,10 @@ void ProgNode::translate(Codegen* g, const std::vector<UserFunc>& usrfuncs)
 	structs->translate(g);
 
 	//non-main functions
-	funcs->translate(g);
+	if (jobs > 1)
+		translateFuncs(funcs.get(), g, jobs);
+	else
+		funcs->translate(g);
 
 	//data
 	datas->translate(g);
@@ -126,7 +234,7 @@ void ProgNode::translate(Codegen* g, const std::vector<UserFunc>& usrfuncs)
 
 		libFuncs[fn.lib].push_back(k);
 
-		g->i_data(0, "_f" + fn.ident);
+		g->w_data(0, "_f" + fn.ident);
 	}
 
 	//LIBS chunk
@@ -31,5 +31,6 @@ class ProgNode : public Node {
 
 	std::shared_ptr<Environ> semant(Environ* e);
 
-	void translate(Codegen* g, const std::vector<UserFunc>& userfuncs);
+	//user functions are translated on 'jobs' threads, if the codegen can fork
+	void translate(Codegen* g, const std::vector<UserFunc>& userfuncs, int jobs = 1);
 };
@@ -0,0 +1,162 @@
+#include "ranges.hpp"
+#include "exprnode.hpp"
+
+//per thread, as functions can be translated in parallel
+static thread_local std::vector<Effects> collecting;
+static thread_local Ranges::State        known;
+
+void Effects::merge(const Effects& e)
+{
+	writes.insert(e.writes.begin(), e.writes.end());
+	dims.insert(e.dims.begin(), e.dims.end());
+	any     = any || e.any;
+	deletes = deletes || e.deletes;
+	leaves  = leaves || e.leaves;
+}
+
+////////////
+// Semant //
+////////////
+void Ranges::begin()
+{
+	collecting.push_back(Effects());
+}
+
+Effects Ranges::end()
+{
+	Effects e = collecting.back();
+	collecting.pop_back();
+	if (collecting.size())
+		collecting.back().merge(e);
+	return e;
+}
+
+void Ranges::write(Decl* d)
+{
+	if (d && collecting.size())
+		collecting.back().writes.insert(d);
+}
+
+void Ranges::dim(const std::string& ident)
+{
+	if (collecting.size())
+		collecting.back().dims.insert(ident);
+}
+
+void Ranges::any()
+{
+	if (collecting.size())
+		collecting.back().any = true;
+}
+
+void Ranges::deletes()
+{
+	if (collecting.size())
+		collecting.back().deletes = true;
+}
+
+void Ranges::leaves()
+{
+	if (collecting.size())
+		collecting.back().leaves = true;
+}
+
+///////////////
+// Translate //
+///////////////
+Ranges::State Ranges::save()
+{
+	return known;
+}
+
+void Ranges::restore(const State& s)
+{
+	known = s;
+}
+
+static bool mentions(const Bound& b, const Effects& e)
+{
+	return b.var && e.writes.count(b.var);
+}
+
+void Ranges::kill(const Effects& e)
+{
+	if (e.any) {
+		known.vars.clear();
+		known.arrays.clear();
+		return;
+	}
+	if (e.writes.empty() && e.dims.empty())
+		return;
+
+	std::map<Decl*, std::pair<Bound, Bound>>::iterator v;
+	for (v = known.vars.begin(); v != known.vars.end();) {
+		if (e.writes.count(v->first) || mentions(v->second.first, e) || mentions(v->second.second, e))
+			known.vars.erase(v++);
+		else
+			++v;
+	}
+	std::map<std::string, std::vector<Bound>>::iterator a;
+	for (a = known.arrays.begin(); a != known.arrays.end();) {
+		bool dead = e.dims.count(a->first) > 0;
+		for (int k = 0; k < a->second.size() && !dead; ++k)
+			dead = mentions(a->second[k], e);
+		if (dead)
+			known.arrays.erase(a++);
+		else
+			++a;
+	}
+}
+
+void Ranges::setVar(Decl* d, const Bound& lo, const Bound& hi)
+{
+	known.vars[d] = std::make_pair(lo, hi);
+}
+
+void Ranges::setArray(const std::string& ident, const std::vector<Bound>& dims)
+{
+	if (dims.size())
+		known.arrays[ident] = dims;
+	else
+		known.arrays.erase(ident);
+}
+
+//swap a var for what's known of it - eg: if i<=n-1, then i+1<=n
+static bool widen(Bound& b, bool upper)
+{
+	std::map<Decl*, std::pair<Bound, Bound>>::iterator it = known.vars.find(b.var);
+	if (it == known.vars.end())
+		return false;
+	const Bound& t = upper ? it->second.second : it->second.first;
+	long long    n = (long long)t.n + b.n;
+	if (n != (int)n)
+		return false;
+	b = Bound(t.var, (int)n);
+	return true;
+}
+
+bool Ranges::inRange(ExprNode* e, const Bound& max)
+{
+	Bound lo, hi;
+	if (!e->range(lo, hi))
+		return false;
+
+	//a few steps at most - a var's bounds never mention the var itself
+	for (int k = 0; lo.var && k < 4; ++k) {
+		if (!widen(lo, false))
+			return false;
+	}
+	for (int k = 0; hi.var != max.var && k < 4; ++k) {
+		if (!hi.var || !widen(hi, true))
+			return false;
+	}
+	return !lo.var && lo.n >= 0 && hi.var == max.var && hi.n <= max.n;
+}
+
+bool Ranges::inArray(ExprNode* e, const std::string& ident, int k)
+{
+	std::map<std::string, std::vector<Bound>>::iterator it = known.arrays.find(ident);
+	if (it == known.arrays.end() || k >= it->second.size())
+		return false;
+	return inRange(e, it->second[k]);
+}
@@ -0,0 +1,67 @@
+/*
+
+  Range analysis for debug builds, so array bounds checks that can't fail are left out.
+  The statement effects it's built on are also used to inline For Each loops.
+
+  Semant collects what each statement can change. Translate then keeps track of what's
+  known about int values - a For loop's var lies between its from and to values, and a
+  Dim'd array has the sizes it was Dim'd with - up to the first statement that could
+  change them.
+
+*/
+
+#pragma once
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+struct Decl;
+class ExprNode;
+
+//what a statement can change
+struct Effects {
+	std::set<Decl*>       writes;  //plain vars assigned
+	std::set<std::string> dims;    //arrays Dim'd
+	bool                  any;     //calls user code, or can be jumped into
+	bool                  deletes; //Deletes objects
+	bool                  leaves;  //Goto or Return
+
+	Effects() : any(false), deletes(false), leaves(false) {}
+	void merge(const Effects& e);
+};
+
+//var+n, or just n if var is 0
+struct Bound {
+	Decl* var;
+	int   n;
+	Bound(Decl* v = 0, int n = 0) : var(v), n(n) {}
+};
+
+class Ranges {
+	public:
+	//semant - collect the effects of everything semanted until the matching end()
+	static void    begin();
+	static Effects end();
+	static void    write(Decl* d);
+	static void    dim(const std::string& ident);
+	static void    any();
+	static void    deletes();
+	static void    leaves();
+
+	//translate - what's known at this point
+	struct State {
+		std::map<Decl*, std::pair<Bound, Bound>>  vars;
+		std::map<std::string, std::vector<Bound>> arrays; //highest index of each dim
+	};
+	static State save();
+	static void  restore(const State& s);
+	static void  kill(const Effects& e);
+
+	static void setVar(Decl* d, const Bound& lo, const Bound& hi);
+	static void setArray(const std::string& ident, const std::vector<Bound>& dims);
+
+	//is 0<=e<=max, or is e a valid index of dim k of an array?
+	static bool inRange(ExprNode* e, const Bound& max);
+	static bool inArray(ExprNode* e, const std::string& ident, int k);
+};
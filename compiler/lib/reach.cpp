@@ -0,0 +1,143 @@
+#include "reach.hpp"
+#include <map>
+#include "decl.hpp"
+#include "environ.hpp"
+#include "type.hpp"
+
+//what a function, or the main program, refers to
+struct Refs {
+	std::set<Decl*> funcs, globals;
+	std::set<Type*> types;
+};
+
+static std::map<Decl*, Refs> refs; //by function decl, 0 is the main program
+static Refs*                 current;
+
+static std::set<Decl*>          deadDecls;
+static std::set<Type*>          deadTypes;
+static std::vector<std::string> removed;
+static int                      deadFuncs, deadGlobals;
+
+////////////
+// Semant //
+////////////
+void Reach::clear()
+{
+	refs.clear();
+	current = 0;
+	deadDecls.clear();
+	deadTypes.clear();
+	removed.clear();
+	deadFuncs = deadGlobals = 0;
+}
+
+void Reach::begin(Decl* func)
+{
+	current = &refs[func];
+}
+
+void Reach::end()
+{
+	current = 0;
+}
+
+void Reach::func(Decl* d)
+{
+	if (current)
+		current->funcs.insert(d);
+}
+
+void Reach::global(Decl* d)
+{
+	if (current && (d->kind & DECL_GLOBAL))
+		current->globals.insert(d);
+}
+
+void Reach::type(Type* t)
+{
+	//a Blitz array of a type needs the type too
+	while (VectorType* v = t->vectorType())
+		t = v->elementType;
+	if (current && t->structType())
+		current->types.insert(t);
+}
+
+///////////////
+// Translate //
+///////////////
+void Reach::walk(Environ* prog)
+{
+	std::set<Decl*>           funcs, globals;
+	std::set<Type*>           types;
+	std::vector<Decl*>        todo(1, (Decl*)0);
+	std::set<Decl*>::iterator it;
+	while (todo.size()) {
+		Refs& r = refs[todo.back()];
+		todo.pop_back();
+		for (it = r.funcs.begin(); it != r.funcs.end(); ++it) {
+			if (funcs.insert(*it).second)
+				todo.push_back(*it);
+		}
+		globals.insert(r.globals.begin(), r.globals.end());
+		types.insert(r.types.begin(), r.types.end());
+	}
+
+	//the type of a field is reached through its type
+	std::vector<Type*> more(types.begin(), types.end());
+	while (more.size()) {
+		StructType* s = more.back()->structType();
+		more.pop_back();
+		for (int k = 0; k < s->fields->size(); ++k) {
+			Type* t = s->fields->decls[k]->type;
+			while (VectorType* v = t->vectorType())
+				t = v->elementType;
+			if (t->structType() && types.insert(t).second)
+				more.push_back(t);
+		}
+	}
+
+	for (int k = 0; k < prog->funcDecls->size(); ++k) {
+		Decl* d = prog->funcDecls->decls[k];
+		if (funcs.count(d))
+			continue;
+		deadDecls.insert(d);
+		removed.push_back("Function " + d->name);
+		++deadFuncs;
+	}
+	//consts and Blitz arrays are left alone
+	for (int k = 0; k < prog->decls->size(); ++k) {
+		Decl* d = prog->decls->decls[k];
+		if (d->kind != DECL_GLOBAL || d->type->constType() || d->type->vectorType() || globals.count(d))
+			continue;
+		deadDecls.insert(d);
+		removed.push_back("Global " + d->name);
+		++deadGlobals;
+	}
+	for (int k = 0; k < prog->typeDecls->size(); ++k) {
+		Decl* d = prog->typeDecls->decls[k];
+		if (types.count(d->type))
+			continue;
+		deadTypes.insert(d->type);
+		removed.push_back("Type " + d->name);
+	}
+}
+
+bool Reach::reached(Decl* d)
+{
+	return !deadDecls.count(d);
+}
+
+bool Reach::reached(Type* t)
+{
+	return !deadTypes.count(t);
+}
+
+void Reach::report(std::ostream& out)
+{
+	if (removed.empty())
+		return;
+	out << "Removed " << deadFuncs << " functions, " << deadGlobals << " globals, " << deadTypes.size()
+		<< " types nothing reaches" << std::endl;
+	for (int k = 0; k < removed.size(); ++k)
+		out << "  " << removed[k] << std::endl;
+}
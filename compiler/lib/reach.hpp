@@ -0,0 +1,37 @@
+/*
+
+  Whole program reachability, so functions, globals and types that nothing can reach
+  are left out of the output.
+
+  Semant records what the main program and each function refer to. Before translating,
+  the references are followed from the main program - whatever isn't reached is dead.
+  Until then, everything counts as reached.
+
+*/
+
+#pragma once
+#include <ostream>
+#include <set>
+#include <string>
+#include <vector>
+
+struct Decl;
+class Type;
+class Environ;
+
+class Reach {
+	public:
+	//semant - refs are added to the function being semanted, or the main program if 0
+	static void clear();
+	static void begin(Decl* func);
+	static void end();
+	static void func(Decl* d);
+	static void global(Decl* d);
+	static void type(Type* t);
+
+	//translate - follow the refs from the main program, before anything is translated
+	static void walk(Environ* prog);
+	static bool reached(Decl* d);
+	static bool reached(Type* t);
+	static void report(std::ostream& out);
+};
@@ -1,14 +1,18 @@
 #include "stmtnode.hpp"
+#include <algorithm>
+#include <climits>
 #include <map>
+#include <set>
 #include "codegen.hpp"
 #include "declnode.hpp"
 #include "environ.hpp"
 #include "ex.hpp"
 #include "exprnode.hpp"
 #include "label.hpp"
+#include "reach.hpp"
 #include "varnode.hpp"
 
-static std::string                        fileLabel;
+static thread_local std::string           fileLabel;
 static std::map<std::string, std::string> fileMap;
 
 StmtNode::StmtNode() : pos(-1) {}
@@ -46,16 +50,20 @@ StmtSeqNode::~StmtSeqNode()
 ////////////////////////
 void StmtSeqNode::semant(Environ* e)
 {
+	stmtEffects.resize(stmts.size());
 	for (int k = 0; k < stmts.size(); ++k) {
+		Ranges::begin();
 		try {
 			stmts[k]->semant(e);
 		} catch (BlitzException& x) {
+			Ranges::end();
 			if (x.pos < 0)
 				x.pos = stmts[k]->pos;
 			if (!x.file.size())
 				x.file = file;
 			throw;
 		}
+		stmtEffects[k] = Ranges::end();
 	}
 }
 
@@ -63,9 +71,17 @@ void StmtSeqNode::translate(Codegen* g)
 {
 	std::string t = fileLabel;
 	fileLabel     = file.size() ? fileMap[file] : "";
+
+	//what's known in here doesn't hold once we're out
+	Ranges::State r;
+	if (g->debug)
+		r = Ranges::save();
+
 	for (int k = 0; k < stmts.size(); ++k) {
 		StmtNode* stmt = stmts[k];
 		stmt->debug(stmts[k]->pos, g);
+		if (g->debug)
+			Ranges::kill(stmtEffects[k]);
 		try {
 			stmt->translate(g);
 		} catch (BlitzException& x) {
@@ -76,6 +92,8 @@ void StmtSeqNode::translate(Codegen* g)
 			throw;
 		}
 	}
+	if (g->debug)
+		Ranges::restore(r);
 	fileLabel = t;
 }
 
@@ -89,6 +107,19 @@ int StmtSeqNode::size()
 	return stmts.size();
 }
 
+Effects StmtSeqNode::effects()
+{
+	Effects e;
+	for (int k = 0; k < stmtEffects.size(); ++k)
+		e.merge(stmtEffects[k]);
+	return e;
+}
+
+ExprNode* StmtSeqNode::returns()
+{
+	return stmts.size() == 1 ? stmts[0]->returns() : 0;
+}
+
 // Include
 IncludeNode::IncludeNode(const std::string& t, std::shared_ptr<StmtSeqNode> ss) : file(t), stmts(ss) {}
 
@@ -129,7 +160,8 @@ void DeclStmtNode::semant(Environ* e)
 
 void DeclStmtNode::translate(Codegen* g)
 {
-	decl->translate(g);
+	if (decl->reached())
+		decl->translate(g);
 }
 
 // Dim Array Statement
@@ -161,6 +193,7 @@ void DimNode::semant(Environ* e)
 	}
 	exprs->semant(e);
 	exprs->castTo(Type::int_type, e);
+	Ranges::dim(ident);
 }
 
 void DimNode::translate(Codegen* g)
@@ -168,12 +201,24 @@ void DimNode::translate(Codegen* g)
 	TNode* t;
 	g->code(call("__bbUndimArray", global("_a" + ident)));
 	for (int k = 0; k < exprs->size(); ++k) {
-		t = add(global("_a" + ident), iconst(k * 4 + 12));
+		t = addr(global("_a" + ident), iconst((k + 3) * word));
 		t = move(exprs->exprs[k]->translate(g), mem(t));
 		g->code(t);
 	}
 	g->code(call("__bbDimArray", global("_a" + ident)));
 
+	if (g->debug) {
+		//the highest index of each dim, up to the first that isn't known
+		std::vector<Bound> dims;
+		Bound              lo, hi;
+		for (int k = 0; k < exprs->size(); ++k) {
+			if (!exprs->exprs[k]->range(lo, hi) || lo.var != hi.var || lo.n != hi.n)
+				break;
+			dims.push_back(hi);
+		}
+		Ranges::setArray(ident, dims);
+	}
+
 	if (!sem_decl)
 		return;
 
@@ -189,11 +234,11 @@ void DimNode::translate(Codegen* g)
 		et = 5;
 
 	g->align_data(4);
-	g->i_data(0, "_a" + ident);
-	g->i_data(et);
-	g->i_data(exprs->size());
+	g->w_data(0, "_a" + ident);
+	g->w_data(et);
+	g->w_data(exprs->size());
 	for (k = 0; k < exprs->size(); ++k)
-		g->i_data(0);
+		g->w_data(0);
 }
 
 AssNode::AssNode(VarNode* var, ExprNode* expr) : var(var), expr(expr) {}
@@ -212,6 +257,7 @@ void AssNode::semant(Environ* e)
 	var->semant(e);
 	if (var->sem_type->constType())
 		ex("Constants can not be assigned to");
+	Ranges::write(var->decl());
 	if (var->sem_type->vectorType())
 		ex("Blitz arrays can not be assigned to");
 	expr = expr->semant(e);
@@ -261,6 +307,9 @@ void LabelNode::semant(Environ* e)
 	} else
 		e->insertLabel(ident, pos, -1, data_sz);
 	ident = e->funcLabel + ident;
+
+	//we don't know where we got here from
+	Ranges::any();
 }
 
 void LabelNode::translate(Codegen* g)
@@ -291,7 +340,7 @@ void RestoreNode::translate(Codegen* g)
 {
 	TNode* t = global("__DATA");
 	if (sem_label)
-		t = add(t, iconst(sem_label->data_sz * 8));
+		t = addr(t, iconst(sem_label->data_sz * (4 + word)));
 	g->code(call("__bbRestore", t));
 }
 
@@ -306,6 +355,7 @@ void GotoNode::semant(Environ* e)
 		e->insertLabel(ident, -1, pos, -1);
 	}
 	ident = e->funcLabel + ident;
+	Ranges::leaves();
 }
 
 void GotoNode::translate(Codegen* g)
@@ -325,6 +375,7 @@ void GosubNode::semant(Environ* e)
 	if (!e->findLabel(ident))
 		e->insertLabel(ident, -1, pos, -1);
 	ident = e->funcLabel + ident;
+	Ranges::any();
 }
 
 void GosubNode::translate(Codegen* g)
@@ -465,9 +516,11 @@ void ForNode::semant(Environ* e)
 
 	if (!stepExpr->constNode())
 		ex("Step value must be constant");
+	Ranges::write(var->decl());
 
 	std::string brk = e->setBreak(sem_brk = genLabel());
 	stmts->semant(e);
+	sem_body = stmts->effects();
 	e->setBreak(brk);
 }
 
@@ -483,7 +536,13 @@ void ForNode::translate(Codegen* g)
 	std::string loop = genLabel();
 	g->code(jump(cond));
 	g->label(loop);
-	stmts->translate(g);
+	if (g->debug) {
+		Ranges::State r = Ranges::save();
+		bounds();
+		stmts->translate(g);
+		Ranges::restore(r);
+	} else
+		stmts->translate(g);
 
 	//execute the step part
 	debug(nextPos, g);
@@ -500,6 +559,33 @@ void ForNode::translate(Codegen* g)
 	g->label(sem_brk);
 }
 
+//while the body runs, from<=var<=to - or to<=var<=from for a negative step
+void ForNode::bounds()
+{
+	Decl* d = var->decl();
+	if (!d || var->sem_type != Type::int_type || sem_body.any || sem_body.writes.count(d))
+		return;
+	int step = stepExpr->constNode()->intValue();
+	if (!step)
+		return;
+
+	Bound     lo, hi, t;
+	ExprNode *first = fromExpr, *last = toExpr;
+	if (step < 0)
+		std::swap(first, last);
+	if (!first->range(lo, t) || !last->range(t, hi))
+		return;
+	if (lo.var == d || hi.var == d || sem_body.writes.count(lo.var) || sem_body.writes.count(hi.var))
+		return;
+
+	//the var mustn't wrap round before it passes to
+	if (step > 0 && !hi.var && hi.n > INT_MAX - step)
+		return;
+	if (step < 0 && !lo.var && lo.n < INT_MIN - step)
+		return;
+	Ranges::setVar(d, lo, hi);
+}
+
 ForEachNode::ForEachNode(VarNode* v, const std::string& t, StmtSeqNode* s, int np)
 	: var(v), typeIdent(t), stmts(s), nextPos(np)
 {}
@@ -525,14 +611,24 @@ void ForEachNode::semant(Environ* e)
 		ex("Type name not found");
 	if (t != ty)
 		ex("Type mismatch");
+	Ranges::write(var->decl());
+	Reach::type(t);
 
 	std::string brk = e->setBreak(sem_brk = genLabel());
 	stmts->semant(e);
+	sem_body = stmts->effects();
 	e->setBreak(brk);
 }
 
 void ForEachNode::translate(Codegen* g)
 {
+	//walk the list in place if nothing in the body can take the object out from under us
+	Decl* d = var->decl();
+	if (d && !sem_body.any && !sem_body.deletes && !sem_body.leaves && !sem_body.writes.count(d)) {
+		walk(g);
+		return;
+	}
+
 	TNode *     t, *l, *r;
 	std::string _loop = genLabel();
 
@@ -561,6 +657,48 @@ void ForEachNode::translate(Codegen* g)
 	g->label(sem_brk);
 }
 
+////////////////////////////////////////////////////////////////////
+// Walk the used list of a type without holding a reference to    //
+// the current object - the list is laid out as in basic.hpp, and //
+// the head of it is the BBObj after the type ID.                 //
+////////////////////////////////////////////////////////////////////
+void ForEachNode::walk(Codegen* g)
+{
+	std::string loop = genLabel();
+	std::string done = genLabel();
+	std::string out  = genLabel();
+	bool        refs = !var->isObjParam();
+
+	//let go of what var held, and start at the head
+	if (refs)
+		g->code(var->store(g, iconst(0)));
+	//the int type ID is padded out to a word, as the BBObj after it starts with a pointer
+	g->code(move(addr(global("_t" + typeIdent), iconst(word)), mem(var->translate(g))));
+
+	g->label(loop);
+	g->code(move(mem(addr(var->load(g), iconst(word))), mem(var->translate(g)))); //next
+	g->code(jumpnull(mem(addr(var->load(g), iconst(word * 3))), done));          //back at the head
+	g->code(jumpnull(mem(var->load(g)), loop));                                   //deleted
+	stmts->translate(g);
+
+	debug(nextPos, g);
+	g->code(jump(loop));
+
+	//ran off the end - var is Null
+	g->label(done);
+	g->code(move(iconst(0), mem(var->translate(g))));
+	if (refs)
+		g->code(jump(out));
+
+	//Exit - var keeps the object, so now it needs its reference
+	g->label(sem_brk);
+	if (refs) {
+		TNode* t = add(mem(addr(var->load(g), iconst(word * 4))), iconst(1));
+		g->code(move(t, mem(addr(var->load(g), iconst(word * 4)))));
+		g->label(out);
+	}
+}
+
 ReturnNode::ReturnNode(ExprNode* e) : expr(e) {}
 
 ReturnNode::~ReturnNode()
@@ -592,6 +730,7 @@ void ReturnNode::semant(Environ* e)
 		expr        = expr->castTo(e->returnType, e);
 		returnLabel = e->funcLabel + "_leave";
 	}
+	Ranges::leaves();
 }
 
 void ReturnNode::translate(Codegen* g)
@@ -610,6 +749,11 @@ void ReturnNode::translate(Codegen* g)
 	}
 }
 
+ExprNode* ReturnNode::returns()
+{
+	return expr;
+}
+
 DeleteNode::DeleteNode(ExprNode* e) : expr(e) {}
 
 DeleteNode::~DeleteNode()
@@ -625,6 +769,7 @@ void DeleteNode::semant(Environ* e)
 	expr = expr->semant(e);
 	if (expr->sem_type->structType() == 0)
 		ex("Can't delete non-Newtype");
+	Ranges::deletes();
 }
 
 void DeleteNode::translate(Codegen* g)
@@ -643,6 +788,8 @@ void DeleteEachNode::semant(Environ* e)
 	Type* t = e->findType(typeIdent);
 	if (!t || t->structType() == 0)
 		ex("Specified name is not a NewType name");
+	Ranges::deletes();
+	Reach::type(t);
 }
 
 void DeleteEachNode::translate(Codegen* g)
@@ -677,10 +824,10 @@ void InsertNode::translate(Codegen* g)
 {
 	TNode* t1 = expr1->translate(g);
 	if (g->debug)
-		t1 = jumpf(t1, "__bbNullObjEx");
+		t1 = jumpnull(t1, "__bbNullObjEx");
 	TNode* t2 = expr2->translate(g);
 	if (g->debug)
-		t2 = jumpf(t2, "__bbNullObjEx");
+		t2 = jumpnull(t2, "__bbNullObjEx");
 	std::string s = before ? "__bbObjInsBefore" : "__bbObjInsAfter";
 	g->code(call(s, t1, t2));
 }
@@ -735,13 +882,20 @@ void SelectNode::translate(Codegen* g)
 	std::vector<std::string> labs;
 	std::string              brk = genLabel();
 
-	for (k = 0; k < cases.size(); ++k) {
-		CaseNode* c = cases[k];
+	for (k = 0; k < cases.size(); ++k)
 		labs.push_back(genLabel());
-		for (int j = 0; j < c->exprs->size(); ++j) {
-			ExprNode* e = c->exprs->exprs[j];
-			TNode*    t = compare('=', sem_temp->load(g), e->translate(g), ty);
-			g->code(jumpt(t, labs.back()));
+
+	std::string def = genLabel();
+	if (dispatch(g, labs, def)) {
+		g->label(def);
+	} else {
+		for (k = 0; k < cases.size(); ++k) {
+			CaseNode* c = cases[k];
+			for (int j = 0; j < c->exprs->size(); ++j) {
+				ExprNode* e = c->exprs->exprs[j];
+				TNode*    t = compare('=', sem_temp->load(g), e->translate(g), ty);
+				g->code(jumpt(t, labs[k]));
+			}
 		}
 	}
 	if (defStmts)
@@ -757,6 +911,149 @@ void SelectNode::translate(Codegen* g)
 	g->label(brk);
 }
 
+//////////////////////////////////////////////////////////
+// Select with constant cases - dense ints go through a //
+// jump table, sparse ones a binary search, and strings //
+// a perfect hash.                                      //
+//////////////////////////////////////////////////////////
+static const int MIN_DISPATCH = 4;  //fewer cases than this are just compared in order
+static const int MAX_SPARSE   = 3;  //a jump table may be this many times bigger than the cases
+static const int MAX_SEEDS    = 256; //hash seeds tried for each table size
+
+//must match _bbStrHash in the runtime
+static unsigned strHash(const std::string& s, int seed)
+{
+	unsigned h = 2166136261u ^ seed;
+	for (int k = 0; k < s.size(); ++k)
+		h = (h ^ (unsigned char)s[k]) * 16777619u;
+	return h;
+}
+
+bool SelectNode::dispatch(Codegen* g, const std::vector<std::string>& labs, const std::string& def)
+{
+	Type* ty = expr->sem_type;
+	if (ty != Type::int_type && ty != Type::string_type)
+		return false;
+
+	//the first of any duplicate cases wins
+	std::vector<Const>    cs;
+	std::set<int>         ints;
+	std::set<std::string> strs;
+	for (int k = 0; k < cases.size(); ++k) {
+		CaseNode* c = cases[k];
+		for (int j = 0; j < c->exprs->size(); ++j) {
+			ExprNode*  e = c->exprs->exprs[j];
+			ConstNode* n = e->constNode();
+			if (!n)
+				return false;
+			Const t;
+			t.value = ty == Type::int_type ? n->intValue() : 0;
+			t.expr  = e;
+			t.label = labs[k];
+			if (ty == Type::int_type ? ints.insert(t.value).second : strs.insert(n->stringValue()).second)
+				cs.push_back(t);
+		}
+	}
+	if (cs.size() < MIN_DISPATCH)
+		return false;
+
+	if (ty == Type::string_type) {
+		hashed(g, cs, def);
+		return true;
+	}
+
+	std::sort(cs.begin(), cs.end());
+	int    lo = cs.front().value;
+	double sz = (double)cs.back().value - lo + 1;
+	if (sz > cs.size() * MAX_SPARSE) {
+		search(g, cs, 0, cs.size(), def);
+		return true;
+	}
+
+	//a bounds check does for both ends, as the index is unsigned
+	std::vector<std::string> table((int)sz, def);
+	for (int k = 0; k < cs.size(); ++k)
+		table[cs[k].value - lo] = cs[k].label;
+	if (lo)
+		g->code(sem_temp->store(g, new TNode(IR_SUB, sem_temp->load(g), iconst(lo))));
+	g->code(jumpge(sem_temp->load(g), iconst(table.size()), def));
+	jumpTable(g, sem_temp->load(g), table);
+	return true;
+}
+
+void SelectNode::jumpTable(Codegen* g, TNode* index, const std::vector<std::string>& table)
+{
+	std::string lab = genLabel();
+	g->align_data(4);
+	for (int k = 0; k < table.size(); ++k)
+		g->p_data(table[k], k ? "" : lab);
+	g->code(jumptable(index, lab));
+}
+
+void SelectNode::search(Codegen* g, const std::vector<Const>& cs, int lo, int hi, const std::string& def)
+{
+	if (hi - lo < MIN_DISPATCH) {
+		for (int k = lo; k < hi; ++k) {
+			TNode* t = compare('=', sem_temp->load(g), iconst(cs[k].value), Type::int_type);
+			g->code(jumpt(t, cs[k].label));
+		}
+		g->code(jump(def));
+		return;
+	}
+	int         mid   = (lo + hi) / 2;
+	std::string lower = genLabel();
+	g->code(jumpt(compare('<', sem_temp->load(g), iconst(cs[mid].value), Type::int_type), lower));
+	search(g, cs, mid, hi, def);
+	g->label(lower);
+	search(g, cs, lo, mid, def);
+}
+
+void SelectNode::hashed(Codegen* g, const std::vector<Const>& cs, const std::string& def)
+{
+	//find a seed that gives every case its own slot
+	std::vector<std::string> strs;
+	for (int k = 0; k < cs.size(); ++k)
+		strs.push_back(cs[k].expr->constNode()->stringValue());
+
+	int size = 1, seed = 0;
+	while (size < cs.size())
+		size += size;
+	std::vector<int> slots;
+	for (;; size += size) {
+		for (seed = 0; seed < MAX_SEEDS; ++seed) {
+			slots.assign(size, -1);
+			int k;
+			for (k = 0; k < strs.size(); ++k) {
+				int& n = slots[strHash(strs[k], seed) & (size - 1)];
+				if (n >= 0)
+					break;
+				n = k;
+			}
+			if (k == strs.size())
+				break;
+		}
+		if (seed < MAX_SEEDS)
+			break;
+	}
+
+	//then one compare confirms it
+	std::vector<std::string> table(size, def);
+	for (int k = 0; k < size; ++k) {
+		if (slots[k] >= 0)
+			table[k] = genLabel();
+	}
+	TNode* t = call("__bbStrHash", sem_temp->load(g), iconst(seed));
+	jumpTable(g, new TNode(IR_AND, t, iconst(size - 1)), table);
+	for (int k = 0; k < size; ++k) {
+		if (slots[k] < 0)
+			continue;
+		const Const& c = cs[slots[k]];
+		g->label(table[k]);
+		g->code(jumpt(compare('=', sem_temp->load(g), c.expr->translate(g), Type::string_type), c.label));
+		g->code(jump(def));
+	}
+}
+
 RepeatNode::RepeatNode(StmtSeqNode* s, ExprNode* e, int up) : stmts(s), expr(e), untilPos(up) {}
 
 RepeatNode::~RepeatNode()
@@ -816,6 +1113,7 @@ void ReadNode::semant(Environ* e)
 		ex("Constants can not be modified");
 	if (var->sem_type->structType())
 		ex("Data can not be read into an object");
+	Ranges::write(var->decl());
 }
 
 void ReadNode::translate(Codegen* g)
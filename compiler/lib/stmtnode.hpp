@@ -2,6 +2,7 @@
 #include <string>
 #include <vector>
 #include "node.hpp"
+#include "ranges.hpp"
 #include "type.hpp"
 
 class Codegen;
@@ -19,11 +20,18 @@ struct StmtNode : public Node {
 
 	virtual void semant(Environ* e);
 	virtual void translate(Codegen* g);
+
+	//the value of a 'Return expr' statement
+	virtual ExprNode* returns()
+	{
+		return 0;
+	}
 };
 
 class StmtSeqNode : public Node {
 	std::string            file;
 	std::vector<StmtNode*> stmts;
+	std::vector<Effects>   stmtEffects;
 
 	public:
 	StmtSeqNode(const std::string& f);
@@ -35,6 +43,12 @@ class StmtSeqNode : public Node {
 
 	void push_back(StmtNode* s);
 
+	//what the statements can change, once semanted
+	Effects effects();
+
+	//if it's just a 'Return expr', expr
+	ExprNode* returns();
+
 	int  size();
 
 	public:
@@ -145,10 +159,14 @@ struct ForNode : public StmtNode {
 	ExprNode *   fromExpr, *toExpr, *stepExpr;
 	StmtSeqNode* stmts;
 	std::string  sem_brk;
+	Effects      sem_body;
 	ForNode(VarNode* v, ExprNode* f, ExprNode* t, ExprNode* s, StmtSeqNode* ss, int np);
 	~ForNode();
 	void semant(Environ* e);
 	void translate(Codegen* g);
+
+	private:
+	void bounds();
 };
 
 struct ForEachNode : public StmtNode {
@@ -157,10 +175,14 @@ struct ForEachNode : public StmtNode {
 	std::string  typeIdent;
 	StmtSeqNode* stmts;
 	std::string  sem_brk;
+	Effects      sem_body;
 	ForEachNode(VarNode* v, const std::string& t, StmtSeqNode* s, int np);
 	~ForEachNode();
 	void semant(Environ* e);
 	void translate(Codegen* g);
+
+	private:
+	void walk(Codegen* g);
 };
 
 struct ReturnNode : public StmtNode {
@@ -168,8 +190,9 @@ struct ReturnNode : public StmtNode {
 	std::string returnLabel;
 	ReturnNode(ExprNode* e);
 	~ReturnNode();
-	void semant(Environ* e);
-	void translate(Codegen* g);
+	void      semant(Environ* e);
+	void      translate(Codegen* g);
+	ExprNode* returns();
 };
 
 struct DeleteNode : public StmtNode {
@@ -213,6 +236,19 @@ struct SelectNode : public StmtNode {
 	void push_back(CaseNode* c);
 	void semant(Environ* e);
 	void translate(Codegen* g);
+
+	private:
+	//a constant case
+	struct Const {
+		int         value;
+		ExprNode*   expr;
+		std::string label;
+		bool        operator<(const Const& c) const { return value < c.value; }
+	};
+	bool dispatch(Codegen* g, const std::vector<std::string>& labs, const std::string& def);
+	void jumpTable(Codegen* g, TNode* index, const std::vector<std::string>& table);
+	void search(Codegen* g, const std::vector<Const>& cs, int lo, int hi, const std::string& def);
+	void hashed(Codegen* g, const std::vector<Const>& cs, const std::string& def);
 };
 
 struct RepeatNode : public StmtNode {
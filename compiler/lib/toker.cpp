@@ -1,102 +1,49 @@
 #include "toker.hpp"
 #include <cctype>
+#include <cstring>
 #include "ex.hpp"
+#include "keywords.hpp"
 
 #include <stdutil.hpp>
 
-int Toker::chars_toked;
+int Toker::chars_toked, Toker::lines_toked;
 
-static std::map<std::string, int> alphaTokes, lowerTokes;
-
-static void makeKeywords()
+Toker::Toker(std::istream& in) : curr_row(-1)
 {
-	static bool made;
-	if (made)
-		return;
+	char buf[65536];
+	while (in.read(buf, sizeof(buf)) || in.gcount())
+		own.append(buf, in.gcount());
+	init(own);
+}
 
-	alphaTokes["Dim"]          = DIM;
-	alphaTokes["Goto"]         = GOTO;
-	alphaTokes["Gosub"]        = GOSUB;
-	alphaTokes["Return"]       = RETURN;
-	alphaTokes["Exit"]         = EXIT;
-	alphaTokes["If"]           = IF;
-	alphaTokes["Then"]         = THEN;
-	alphaTokes["Else"]         = ELSE;
-	alphaTokes["EndIf"]        = ENDIF;
-	alphaTokes["End If"]       = ENDIF;
-	alphaTokes["ElseIf"]       = ELSEIF;
-	alphaTokes["Else If"]      = ELSEIF;
-	alphaTokes["While"]        = WHILE;
-	alphaTokes["Wend"]         = WEND;
-	alphaTokes["For"]          = FOR;
-	alphaTokes["To"]           = TO;
-	alphaTokes["Step"]         = STEP;
-	alphaTokes["Next"]         = NEXT;
-	alphaTokes["Function"]     = FUNCTION;
-	alphaTokes["End Function"] = ENDFUNCTION;
-	alphaTokes["Type"]         = TYPE;
-	alphaTokes["End Type"]     = ENDTYPE;
-	alphaTokes["Each"]         = EACH;
-	alphaTokes["Local"]        = LOCAL;
-	alphaTokes["Global"]       = GLOBAL;
-	alphaTokes["Field"]        = FIELD;
-	alphaTokes["Const"]        = BBCONST;
-	alphaTokes["Select"]       = SELECT;
-	alphaTokes["Case"]         = CASE;
-	alphaTokes["Default"]      = DEFAULT;
-	alphaTokes["End Select"]   = ENDSELECT;
-	alphaTokes["Repeat"]       = REPEAT;
-	alphaTokes["Until"]        = UNTIL;
-	alphaTokes["Forever"]      = FOREVER;
-	alphaTokes["Data"]         = DATA;
-	alphaTokes["Read"]         = READ;
-	alphaTokes["Restore"]      = RESTORE;
-	alphaTokes["Abs"]          = ABS;
-	alphaTokes["Sgn"]          = SGN;
-	alphaTokes["Mod"]          = MOD;
-	alphaTokes["Pi"]           = PI;
-	alphaTokes["True"]         = BBTRUE;
-	alphaTokes["False"]        = BBFALSE;
-	alphaTokes["Int"]          = BBINT;
-	alphaTokes["Float"]        = BBFLOAT;
-	alphaTokes["Str"]          = BBSTR;
-	alphaTokes["Include"]      = INCLUDE;
-
-	alphaTokes["New"]    = BBNEW;
-	alphaTokes["Delete"] = BBDELETE;
-	alphaTokes["First"]  = FIRST;
-	alphaTokes["Last"]   = LAST;
-	alphaTokes["Insert"] = INSERT;
-	alphaTokes["Before"] = BEFORE;
-	alphaTokes["After"]  = AFTER;
-	alphaTokes["Null"]   = BBNULL;
-	alphaTokes["Object"] = OBJECT;
-	alphaTokes["Handle"] = BBHANDLE;
-
-	alphaTokes["And"] = AND;
-	alphaTokes["Or"]  = OR;
-	alphaTokes["Xor"] = XOR;
-	alphaTokes["Not"] = NOT;
-	alphaTokes["Shl"] = SHL;
-	alphaTokes["Shr"] = SHR;
-	alphaTokes["Sar"] = SAR;
-
-	std::map<std::string, int>::const_iterator it;
-	for (it = alphaTokes.begin(); it != alphaTokes.end(); ++it) {
-		lowerTokes[tolower(it->first)] = it->second;
-	}
-	made = true;
+Toker::Toker(const std::string& src) : curr_row(-1)
+{
+	init(src);
 }
 
-Toker::Toker(std::istream& in) : in(in), curr_row(-1)
+//every line, the last one too, has to end in a '\n' for the scanner
+void Toker::init(const std::string& s)
 {
-	makeKeywords();
+	const std::string* t = &s;
+	if (s.size() && s[s.size() - 1] != '\n') {
+		if (&s != &own)
+			own = s;
+		own += '\n';
+		t = &own;
+	}
+	src      = t->data();
+	size     = t->size();
+	line_end = 0;
 	nextline();
 }
 
 std::map<std::string, int>& Toker::getKeywords()
 {
-	makeKeywords();
+	static std::map<std::string, int> alphaTokes;
+	if (!alphaTokes.size()) {
+		for (int k = 0; k < keywordCount; ++k)
+			alphaTokes[keywords[k].name] = keywords[k].toke;
+	}
 	return alphaTokes;
 }
 
@@ -112,8 +59,13 @@ int Toker::curr()
 
 std::string Toker::text()
 {
-	int from = tokes[curr_toke].from, to = tokes[curr_toke].to;
-	return line.substr(from, to - from);
+	const Toke& t = tokes[curr_toke];
+	std::string s(src + line_start + t.from, t.to - t.from);
+	if (t.n == IDENT) {
+		for (int k = 0; k < s.size(); ++k)
+			s[k] = tolower(s[k]);
+	}
+	return s;
 }
 
 int Toker::lookAhead(int n)
@@ -126,18 +78,20 @@ void Toker::nextline()
 	++curr_row;
 	curr_toke = 0;
 	tokes.clear();
-	if (in.eof()) {
-		line.resize(1);
-		line[0] = EOF;
-		tokes.push_back(Toke(EOF, 0, 1));
+	line_start = line_end;
+	if (line_start == size) {
+		tokes.push_back(Toke(EOF, 0, 0));
 		return;
 	}
 
-	getline(in, line);
-	line += '\n';
-	chars_toked += line.size();
+	const char* line = src + line_start;
+	const char* end  = (const char*)memchr(line, '\n', size - line_start);
+	int         len  = end - line + 1;
+	line_end         = line_start + len;
+	chars_toked += len;
+	++lines_toked;
 
-	for (int k = 0; k < line.size();) {
+	for (int k = 0; k < len;) {
 		int c = line[k], from = k;
 		if (c == '\n') {
 			tokes.push_back(Toke(c, from, ++k));
@@ -186,29 +140,18 @@ void Toker::nextline()
 			for (++k; isalnum(line[k]) || line[k] == '_'; ++k) {
 			}
 
-			std::string ident = tolower(line.substr(from, k - from));
-
+			int n = -1;
 			if (line[k] == ' ' && isalpha(line[k + 1])) {
 				int t = k;
 				for (t += 2; isalnum(line[t]) || line[t] == '_'; ++t) {
 				}
-				std::string s = tolower(line.substr(from, t - from));
-				if (lowerTokes.find(s) != lowerTokes.end()) {
-					k     = t;
-					ident = s;
-				}
-			}
-
-			std::map<std::string, int>::iterator it = lowerTokes.find(ident);
-
-			if (it == lowerTokes.end()) {
-				for (int n = from; n < k; ++n)
-					line[n] = tolower(line[n]);
-				tokes.push_back(Toke(IDENT, from, k));
-				continue;
+				if ((n = findKeyword(line + from, t - from)) >= 0)
+					k = t;
 			}
+			if (n < 0 && (n = findKeyword(line + from, k - from)) < 0)
+				n = IDENT;
 
-			tokes.push_back(Toke(it->second, from, k));
+			tokes.push_back(Toke(n, from, k));
 			continue;
 		}
 		if (c == '\"') {
@@ -234,8 +177,6 @@ void Toker::nextline()
 		}
 		tokes.push_back(Toke(c, from, ++k));
 	}
-	if (!tokes.size())
-		exit(0);
 }
 
 int Toker::next()
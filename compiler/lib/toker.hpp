@@ -2,6 +2,9 @@
 
   The Toker converts an inout stream into tokens for use by the parser.
 
+  The whole source is held in memory, and tokens are just offsets into it - nothing is
+  allocated per token, and keywords are found with the perfect hash in keywords.hpp.
+
   */
 #pragma once
 #include <istream>
@@ -88,6 +91,8 @@ enum {
 class Toker {
 	public:
 	Toker(std::istream& in);
+	//tokes src in place - it has to outlive the Toker
+	Toker(const std::string& src);
 
 	int         pos();
 	int         curr();
@@ -95,7 +100,7 @@ class Toker {
 	std::string text();
 	int         lookAhead(int n);
 
-	static int chars_toked;
+	static int chars_toked, lines_toked;
 
 	static std::map<std::string, int>& getKeywords();
 
@@ -104,9 +109,11 @@ class Toker {
 		int n, from, to;
 		Toke(int n, int f, int t) : n(n), from(f), to(t) {}
 	};
-	std::istream&     in;
-	std::string       line;
+	std::string       own;
+	const char*       src;
+	int               size, line_start, line_end;
 	std::vector<Toke> tokes;
+	void              init(const std::string& s);
 	void              nextline();
 	int               curr_row, curr_toke;
 };
@@ -2,6 +2,8 @@
 #include "codegen.hpp"
 #include "environ.hpp"
 #include "exprnode.hpp"
+#include "ranges.hpp"
+#include "reach.hpp"
 #include "type.hpp"
 
 //////////////////////////////////
@@ -30,6 +32,16 @@ bool VarNode::isObjParam()
 	return false;
 }
 
+Decl* VarNode::decl()
+{
+	return 0;
+}
+
+bool VarNode::weigh(Weight& w)
+{
+	return false;
+}
+
 DeclVarNode::DeclVarNode(Decl* d) : sem_decl(d)
 {
 	if (d)
@@ -62,6 +74,18 @@ bool DeclVarNode::isObjParam()
 	return sem_type->structType() && sem_decl->kind == DECL_PARAM;
 }
 
+Decl* DeclVarNode::decl()
+{
+	return sem_decl;
+}
+
+bool DeclVarNode::weigh(Weight& w)
+{
+	w.size += 1;
+	w.reads.push_back(sem_decl);
+	return true;
+}
+
 IdentVarNode::IdentVarNode(const std::string& i, const std::string& t) : ident(i), tag(t) {}
 
 ///////////////
@@ -83,6 +107,7 @@ void IdentVarNode::semant(Environ* e)
 			ty = ty->constType()->valueType;
 		if (tag.size() && t != ty)
 			ex("Variable type mismatch");
+		Reach::global(sem_decl);
 	} else {
 		//ugly auto decl!
 		sem_decl = e->decls->insertDecl(ident, t, DECL_LOCAL);
@@ -111,20 +136,22 @@ void ArrayVarNode::semant(Environ* e)
 
 TNode* ArrayVarNode::translate(Codegen* g)
 {
-	TNode* t = 0;
+	TNode* t    = 0;
+	bool   safe = g->debug; //every subscript so far is known to be in range
 	for (int k = 0; k < exprs->size(); ++k) {
 		TNode* e = exprs->exprs[k]->translate(g);
 		if (k) {
-			TNode* s = mem(add(global("_a" + ident), iconst(k * 4 + 8)));
+			TNode* s = mem(addr(global("_a" + ident), iconst((k + 2) * word)));
 			e        = add(t, mul(e, s));
 		}
-		if (g->debug) {
-			TNode* s = mem(add(global("_a" + ident), iconst(k * 4 + 12)));
+		safe = safe && Ranges::inArray(exprs->exprs[k], ident, k);
+		if (g->debug && !safe) {
+			TNode* s = mem(addr(global("_a" + ident), iconst((k + 3) * word)));
 			t        = jumpge(e, s, "__bbArrayBoundsEx");
 		} else
 			t = e;
 	}
-	t = add(mem(global("_a" + ident)), mul(t, iconst(4)));
+	t = addr(mem(global("_a" + ident)), mul(t, iconst(word)));
 	return t;
 }
 
@@ -147,11 +174,19 @@ TNode* FieldVarNode::translate(Codegen* g)
 {
 	TNode* t = expr->translate(g);
 	if (g->debug)
-		t = jumpf(t, "__bbNullObjEx");
+		t = jumpnull(t, "__bbNullObjEx");
 	t = mem(t);
 	if (g->debug)
-		t = jumpf(t, "__bbNullObjEx");
-	return add(t, iconst(sem_field->offset));
+		t = jumpnull(t, "__bbNullObjEx");
+	return addr(t, iconst(sem_field->offset));
+}
+
+bool FieldVarNode::weigh(Weight& w)
+{
+	//Null object check
+	w.size += 2;
+	w.traps = true;
+	return expr->weigh(w);
 }
 
 VectorVarNode::VectorVarNode(ExprNode* e, ExprSeqNode* es) : expr(e), exprs(es) {}
@@ -187,7 +222,7 @@ void VectorVarNode::semant(Environ* e)
 
 TNode* VectorVarNode::translate(Codegen* g)
 {
-	int    sz = 4;
+	int    sz = word;
 	TNode* t  = 0;
 	for (int k = 0; k < exprs->size(); ++k) {
 		TNode*    p;
@@ -196,7 +231,7 @@ TNode* VectorVarNode::translate(Codegen* g)
 			p = iconst(t->intValue() * sz);
 		} else {
 			p = e->translate(g);
-			if (g->debug) {
+			if (g->debug && !Ranges::inRange(e, Bound(0, vec_type->sizes[k] - 1))) {
 				p = jumpge(p, iconst(vec_type->sizes[k]), "__bbVecBoundsEx");
 			}
 			p = mul(p, iconst(sz));
@@ -204,7 +239,7 @@ TNode* VectorVarNode::translate(Codegen* g)
 		sz = sz * vec_type->sizes[k];
 		t  = t ? add(t, p) : p;
 	}
-	return add(t, expr->translate(g));
+	return addr(expr->translate(g), t);
 }
 
 ArrayVarNode::ArrayVarNode(const std::string& i, const std::string& t, ExprSeqNode* e) : ident(i), tag(t), exprs(e) {}
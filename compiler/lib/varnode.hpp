@@ -8,6 +8,7 @@ class Codegen;
 struct TNode;
 struct ExprNode;
 struct ExprSeqNode;
+struct Weight;
 
 struct VarNode : public Node {
 	Type* sem_type;
@@ -16,6 +17,8 @@ struct VarNode : public Node {
 	TNode*         load(Codegen* g);
 	virtual TNode* store(Codegen* g, TNode* n);
 	virtual bool   isObjParam();
+	virtual Decl*  decl(); //the decl of a plain var, else 0
+	virtual bool   weigh(Weight& w); //see ExprNode::weigh
 
 	//addr of var
 	virtual void   semant(Environ* e)    = 0;
@@ -29,6 +32,8 @@ struct DeclVarNode : public VarNode {
 	TNode*         translate(Codegen* g);
 	virtual TNode* store(Codegen* g, TNode* n);
 	bool           isObjParam();
+	Decl*          decl();
+	bool           weigh(Weight& w);
 };
 
 struct IdentVarNode : public DeclVarNode {
@@ -55,6 +60,7 @@ struct FieldVarNode : public VarNode {
 	~FieldVarNode();
 	void   semant(Environ* e);
 	TNode* translate(Codegen* g);
+	bool   weigh(Weight& w);
 };
 
 struct VectorVarNode : public VarNode {
@@ -1,7 +1,10 @@
 #include "libs.hpp"
+#include <algorithm>
+#include <cstring>
 #include <istream>
 #include <set>
 #include <fstream>
+#include <sys/stat.h>
 
 #include <environ.hpp>
 #include <linker.hpp>
@@ -27,6 +30,7 @@ std::vector<std::string> keyWords;
 std::vector<UserFunc>    userFuncs;
 
 static HMODULE linkerHMOD, runtimeHMOD;
+static bool    runtimeSymsLinked;
 
 static Type* bbtypeof(int c)
 {
@@ -83,13 +87,9 @@ static const char* linkRuntime()
 	while (const char* sym = runtimeLib->nextSym()) {
 		std::string s(sym);
 
-		int pc = runtimeLib->symValue(sym);
-
 		//internal?
-		if (s[0] == '_') {
-			runtimeModule->addSymbol(("_" + s).c_str(), pc);
+		if (s[0] == '_')
 			continue;
-		}
 
 		bool cfunc = false;
 
@@ -100,55 +100,36 @@ static const char* linkRuntime()
 
 		keyWords.push_back(s);
 
-		//global!
-		size_t start = 0, end, k;
-		Type*  t     = Type::void_type;
-		if (!isalpha(s[0])) {
-			start = 1;
-			t     = bbtypeof(s[0]);
-		}
-		for (k = 1; k < s.size(); ++k, end = k) {
-			if (!isalnum(s[k]) && s[k] != '_')
-				break;
-		}
-		DeclSeq* params = new DeclSeq();
-		std::string n      = s.substr(start, end - start);
-		while (k < s.size()) {
-			Type* t    = bbtypeof(s[k++]);
-			int   from = k;
-			for (; isalnum(s[k]) || s[k] == '_'; ++k) {
-			}
-			std::string str     = s.substr(from, k - from);
-			ConstType* defType = 0;
-			if (s[k] == '=') {
-				int from = ++k;
-				if (s[k] == '\"') {
-					for (++k; s[k] != '\"'; ++k) {
-					}
-					std::string t = s.substr(from + 1, k - from - 1);
-					defType  = new ConstType(t);
-					++k;
-				} else {
-					if (s[k] == '-')
-						++k;
-					for (; isdigit(s[k]); ++k) {
-					}
-					if (t == Type::int_type) {
-						int n   = atoi(s.substr(from, k - from));
-						defType = new ConstType(n);
-					} else {
-						float n = (float)atof(s.substr(from, k - from));
-						defType = new ConstType(n);
-					}
-				}
-			}
-			Decl* d = params->insertDecl(str, t, DECL_PARAM, defType);
+		runtimeEnviron->insertRuntimeFunc(s, cfunc);
+	}
+	return 0;
+}
+
+const char* linkRuntimeSyms()
+{
+	if (runtimeSymsLinked)
+		return 0;
+	runtimeSymsLinked = true;
+
+	while (const char* sym = runtimeLib->nextSym()) {
+		std::string s(sym);
+
+		int pc = runtimeLib->symValue(sym);
+
+		//internal?
+		if (s[0] == '_') {
+			runtimeModule->addSymbol(("_" + s).c_str(), pc);
+			continue;
 		}
 
-		FuncType* f = new FuncType(t, params, false, cfunc);
-		n           = tolower(n);
-		runtimeEnviron->funcDecls->insertDecl(n, f, DECL_FUNC);
-		runtimeModule->addSymbol(("_f" + n).c_str(), pc);
+		//skip the C func mark and return type, as linkRuntime does
+		int start = s[0] == '!' ? 1 : 0;
+		if (!isalpha(s[start]))
+			++start;
+		int end = start + 1;
+		while (end < s.size() && (isalnum(s[end]) || s[end] == '_'))
+			++end;
+		runtimeModule->addSymbol(("_f" + tolower(s.substr(start, end - start))).c_str(), pc);
 	}
 	return 0;
 }
@@ -269,36 +250,266 @@ static const char* loadUserLib(const std::string& userlib)
 	return 0;
 }
 
-static const char* linkUserLibs()
+static std::vector<std::string> userLibFiles()
 {
-	_ulibkws.clear();
+	std::vector<std::string> files;
 
 	WIN32_FIND_DATA fd;
 
 	HANDLE h = FindFirstFile((home + "/userlibs/*.decls").c_str(), &fd);
 
 	if (h == INVALID_HANDLE_VALUE)
-		return 0;
+		return files;
+
+	do {
+		files.push_back(fd.cFileName);
+	} while (FindNextFile(h, &fd));
+
+	FindClose(h);
+
+	return files;
+}
+
+static const char* linkUserLibs()
+{
+	_ulibkws.clear();
+
+	std::vector<std::string> files = userLibFiles();
 
 	const char* err = 0;
 
-	do {
-		if (err = loadUserLib(fd.cFileName)) {
+	for (int k = 0; k < files.size(); ++k) {
+		if (err = loadUserLib(files[k])) {
 			static char buf[64];
-			sprintf(buf, "Error in userlib '%s' - %s", fd.cFileName, err);
+			sprintf(buf, "Error in userlib '%s' - %s", files[k].c_str(), err);
 			err = buf;
 			break;
 		}
-
-	} while (FindNextFile(h, &fd));
-
-	FindClose(h);
+	}
 
 	_ulibkws.clear();
 
 	return err;
 }
 
+/////////////////////////////////////////////////////////////
+// The runtime's and userlibs' decls, already parsed, so   //
+// start-up doesn't grow with the command set. decls.bin   //
+// is written by -gendecls, and again whenever runtime.dll //
+// or a userlib has changed since.                         //
+/////////////////////////////////////////////////////////////
+static const int DECLS_MAGIC = 0x31444242; //'BBD1' - bump when the format changes
+
+static std::string declsFile()
+{
+	return home + "/decls.bin";
+}
+
+//what decls.bin is made from - bcc version, then each file's name, size and time
+static std::string declsStamp()
+{
+	std::vector<std::string> files = userLibFiles();
+	for (int k = 0; k < files.size(); ++k)
+		files[k] = "userlibs/" + files[k];
+	std::sort(files.begin(), files.end());
+	files.insert(files.begin(), "runtime.dll");
+
+	std::string t = itoa(DECLS_MAGIC) + ' ' + itoa(bcc_ver) + ' ' + itoa(run_ver);
+	for (int k = 0; k < files.size(); ++k) {
+		struct stat st;
+		if (stat((home + "/" + files[k]).c_str(), &st))
+			continue;
+		t += '\n' + files[k] + ' ' + itoa(st.st_size) + ' ' + itoa((int)st.st_mtime);
+	}
+	return t;
+}
+
+static char typeTag(Type* t)
+{
+	if (t == Type::int_type)
+		return '%';
+	if (t == Type::float_type)
+		return '#';
+	if (t == Type::string_type)
+		return '$';
+	if (t == Type::null_type)
+		return '*';
+	return ' ';
+}
+
+static Type* tagType(char c)
+{
+	return c == '*' ? Type::null_type : bbtypeof(c);
+}
+
+static void putInt(std::string& b, int n)
+{
+	b.append((char*)&n, 4);
+}
+
+static void putStr(std::string& b, const std::string& s)
+{
+	putInt(b, s.size());
+	b += s;
+}
+
+//reads what putInt and putStr wrote - ok is cleared if it runs off the end
+struct DeclsReader {
+	const char *p, *end;
+	bool        ok;
+
+	DeclsReader(const std::string& b) : p(b.data()), end(b.data() + b.size()), ok(true) {}
+
+	int getInt()
+	{
+		int n = 0;
+		if (end - p < 4) {
+			ok = false;
+			return 0;
+		}
+		memcpy(&n, p, 4);
+		p += 4;
+		return n;
+	}
+
+	char getChar()
+	{
+		if (p == end) {
+			ok = false;
+			return 0;
+		}
+		return *p++;
+	}
+
+	std::string getStr()
+	{
+		int n = getInt();
+		if (n < 0 || end - p < n) {
+			ok = false;
+			return "";
+		}
+		p += n;
+		return std::string(p - n, n);
+	}
+};
+
+static bool saveDecls()
+{
+	std::string b;
+	putStr(b, declsStamp());
+
+	putInt(b, keyWords.size());
+	for (int k = 0; k < keyWords.size(); ++k)
+		putStr(b, keyWords[k]);
+
+	std::vector<Decl*>& fns = runtimeEnviron->funcDecls->decls;
+	putInt(b, fns.size());
+	for (int k = 0; k < fns.size(); ++k) {
+		FuncType* f = fns[k]->type->funcType();
+		putStr(b, fns[k]->name);
+		b += typeTag(f->returnType);
+		b += (char)((f->userlib ? 1 : 0) | (f->cfunc ? 2 : 0));
+
+		std::vector<Decl*>& ps = f->params->decls;
+		putInt(b, ps.size());
+		for (int j = 0; j < ps.size(); ++j) {
+			putStr(b, ps[j]->name);
+			b += typeTag(ps[j]->type);
+			ConstType* d = ps[j]->defType;
+			b += d ? typeTag(d->valueType) : '\0';
+			if (!d)
+				continue;
+			if (d->valueType == Type::int_type)
+				putInt(b, d->intValue);
+			else if (d->valueType == Type::float_type)
+				b.append((char*)&d->floatValue, 4);
+			else
+				putStr(b, d->stringValue);
+		}
+	}
+
+	putInt(b, userFuncs.size());
+	for (int k = 0; k < userFuncs.size(); ++k) {
+		putStr(b, userFuncs[k].ident);
+		putStr(b, userFuncs[k].proc);
+		putStr(b, userFuncs[k].lib);
+	}
+
+	std::ofstream out(declsFile().c_str(), std::ios_base::binary);
+	out.write(b.data(), b.size());
+	return out.good();
+}
+
+static bool loadDecls()
+{
+	std::ifstream in(declsFile().c_str(), std::ios_base::binary);
+	if (!in)
+		return false;
+
+	//in one read
+	in.seekg(0, std::ios_base::end);
+	std::string b(in.tellg(), 0);
+	in.seekg(0);
+	if (!in.read(&b[0], b.size()))
+		return false;
+
+	DeclsReader r(b);
+	if (r.getStr() != declsStamp() || !r.ok)
+		return false;
+
+	std::vector<std::string> kws(std::max(r.getInt(), 0));
+	for (int k = 0; k < kws.size() && r.ok; ++k)
+		kws[k] = r.getStr();
+
+	//check it all before anything goes in runtimeEnviron
+	DeclSeq* fns = new DeclSeq();
+	int      n   = r.getInt();
+	for (int k = 0; k < n && r.ok; ++k) {
+		std::string name  = r.getStr();
+		Type*       ret   = tagType(r.getChar());
+		int         flags = r.getChar();
+
+		DeclSeq* params = new DeclSeq();
+		int      np     = r.getInt();
+		for (int j = 0; j < np && r.ok; ++j) {
+			std::string pname = r.getStr();
+			Type*       ty    = tagType(r.getChar());
+			char        def   = r.getChar();
+			ConstType*  d     = 0;
+			if (def == '%') {
+				d = new ConstType(r.getInt());
+			} else if (def == '#') {
+				int   i = r.getInt();
+				float f;
+				memcpy(&f, &i, 4);
+				d = new ConstType(f);
+			} else if (def == '$') {
+				d = new ConstType(r.getStr());
+			}
+			params->insertDecl(pname, ty, DECL_PARAM, d);
+		}
+		fns->insertDecl(name, new FuncType(ret, params, (flags & 1) != 0, (flags & 2) != 0), DECL_FUNC);
+	}
+
+	std::vector<UserFunc> ufs;
+	n = r.getInt();
+	for (int k = 0; k < n && r.ok; ++k) {
+		std::string ident = r.getStr(), proc = r.getStr(), lib = r.getStr();
+		ufs.push_back(UserFunc(ident, proc, lib));
+	}
+
+	if (!r.ok || r.p != r.end) {
+		delete fns;
+		return false;
+	}
+
+	keyWords.swap(kws);
+	userFuncs.swap(ufs);
+	std::swap(runtimeEnviron->funcDecls, fns);
+	delete fns;
+	return true;
+}
+
 const char* openLibs()
 {
 	/*char *p = getenv("blitzpath");
@@ -351,6 +562,22 @@ const char* openLibs()
 }
 
 const char* linkLibs()
+{
+	if (loadDecls())
+		return 0;
+
+	if (const char* p = linkRuntime())
+		return p;
+
+	if (const char* p = linkUserLibs())
+		return p;
+
+	//no harm if it can't be written - it's only a cache
+	saveDecls();
+	return 0;
+}
+
+const char* genDecls()
 {
 	if (const char* p = linkRuntime())
 		return p;
@@ -358,6 +585,8 @@ const char* linkLibs()
 	if (const char* p = linkUserLibs())
 		return p;
 
+	if (!saveDecls())
+		return "Unable to write decls.bin";
 	return 0;
 }
 
@@ -373,9 +602,10 @@ void closeLibs()
 	if (linkerHMOD)
 		FreeLibrary(linkerHMOD);
 
-	runtimeEnviron = 0;
-	linkerLib      = 0;
-	runtimeLib     = 0;
-	runtimeHMOD    = 0;
-	linkerHMOD     = 0;
+	runtimeEnviron    = 0;
+	runtimeSymsLinked = false;
+	linkerLib         = 0;
+	runtimeLib        = 0;
+	runtimeHMOD       = 0;
+	linkerHMOD        = 0;
 }
@@ -28,4 +28,10 @@ const char* openLibs();
 
 const char* linkLibs();
 
+//reparse the decls, and write them to decls.bin for linkLibs
+const char* genDecls();
+
+//the runtime's symbols, for linking a program to run
+const char* linkRuntimeSyms();
+
 void closeLibs();
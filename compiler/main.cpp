@@ -2,6 +2,8 @@
 #pragma warning(disable : 4786)
 
 #include "libs.hpp"
+#include "server.hpp"
+#include "stats.hpp"
 
 #include <fstream>
 #include <iomanip>
@@ -14,12 +16,17 @@
 
 #include <assem_x86/assem_x86.hpp>
 #include <bbruntime_dll.hpp>
+#include <codecache.hpp>
+#include <codegen_x64/codegen_x64.hpp>
 #include <codegen_x86/codegen_x86.hpp>
+#include <codegen_x86/tile.hpp>
 #include <config.hpp>
 #include <environ.hpp>
 #include <ex.hpp>
 #include <linker.hpp>
+#include <optimizer.hpp>
 #include <parser.hpp>
+#include <reach.hpp>
 #include <stdutil.hpp>
 
 static void showInfo()
@@ -31,13 +38,14 @@ static void showInfo()
 
 static void showUsage()
 {
-	std::cout << "Usage: blitzcc [-h|-q|+q|-c|-d|-k|+k|-v|-o exefile] [sourcefile.bb]" << std::endl;
+	std::cout << "Usage: blitzcc [-h|-a|-q|+q|-c|-d|-k|+k|-v|-O|-sse|-x64|-nocache|-j n|-stats|-stats-json file|-o exefile] [sourcefile.bb]" << std::endl;
 }
 
 static void showHelp()
 {
 	showUsage();
 	std::cout << "-h         : show this help" << std::endl;
+	std::cout << "-a         : dump assembly listing" << std::endl;
 	std::cout << "-q         : quiet mode" << std::endl;
 	std::cout << "+q		  : very quiet mode" << std::endl;
 	std::cout << "-c         : compile only" << std::endl;
@@ -46,6 +54,18 @@ static void showHelp()
 	std::cout << "+k         : dump keywords and syntax" << std::endl;
 	std::cout << "-v		  : version info" << std::endl;
 	std::cout << "-o exefile : generate executable" << std::endl;
+	std::cout << "-O         : optimize (ignored with -d)" << std::endl;
+	std::cout << "-sse       : use SSE for floats instead of the x87 FPU" << std::endl;
+	std::cout << "-x64       : write x86-64 GNU as source to the -o file, or stdout - it isn't assembled or run" << std::endl;
+	std::cout << "-nocache   : don't use the function code cache" << std::endl;
+	std::cout << "-j n       : translate functions on n threads" << std::endl;
+	std::cout << "-stats     : show phase times, peak memory and counts" << std::endl;
+	std::cout << "-stats-json file : write the -stats to file as JSON" << std::endl;
+	std::cout << std::endl;
+	std::cout << "blitzcc -gendecls                : write decls.bin, the parsed runtime and userlib decls" << std::endl;
+	std::cout << "blitzcc --server name            : compile for clients, with the libs kept loaded" << std::endl;
+	std::cout << "blitzcc --connect name [opts]    : compile on a server - programs aren't run there" << std::endl;
+	std::cout << "                                   (name is a pipe name on Windows, else a socket path)" << std::endl;
 }
 
 static void err(const std::string& t)
@@ -146,22 +166,58 @@ static void versInfo()
 	std::cout << "Linker version:" << verstr(lnk_ver) << std::endl;
 }
 
-int main(int argc, char* argv[])
+//nothing translate makes outlives it, so the main thread's TNodes and tiles are given back
+//when it's done, or has failed - the worker threads' pools go when they end. Else a compile
+//server would keep them for good.
+struct TranslatePools {
+	bool done;
+	TranslatePools() : done(false) {}
+	~TranslatePools()
+	{
+		if (done) {
+			bool tnodes = TNode::releasePool(), tiles = Tile::releasePool();
+			if (tnodes && tiles)
+				return;
+			std::cout << "Warning: " << (tnodes ? "tiles" : "TNodes") << " still allocated after translate"
+					  << std::endl;
+		}
+		TNode::resetPool();
+		Tile::resetPool();
+	}
+};
+
+//the program's nodes are given back at the end of each compile, after the program and its
+//environ have gone - it's made before them so it goes after them.
+struct NodePool {
+	~NodePool() { Node::resetPool(); }
+};
+
+//a compile server has the libs open already, and leaves them open
+static int compile(const std::vector<std::string>& argv, bool serving)
 {
+	int argc = argv.size();
+
+	NodePool                  nodes;
 	std::shared_ptr<Module>   module;
 	std::shared_ptr<Environ>  v_environ;
 	std::shared_ptr<ProgNode> prog;
 
 	try {
-		std::string in_file, out_file, args;
+		std::string in_file, out_file, args, stats_file;
 
 		bool debug = false, quiet = false, veryquiet = false, compileonly = false;
 		bool dumpkeys = false, dumphelp = false, showhelp = false, dumpasm = false;
-		bool versinfo = false;
+		bool versinfo = false, nocache = false, optimize = false, sse = false, x64 = false;
+		bool showstats = false;
+		int  jobs     = std::thread::hardware_concurrency();
 
-		for (int k = 1; k < argc; ++k) {
+		for (int k = 0; k < argc; ++k) {
 			std::string t = argv[k];
-			t             = tolower(t);
+			if (t == "-O") {
+				optimize = true;
+				continue;
+			}
+			t = tolower(t);
 
 			if (t == "-h") {
 				showhelp = true;
@@ -181,6 +237,24 @@ int main(int argc, char* argv[])
 				dumpkeys = dumphelp = true;
 			} else if (t == "-v") {
 				versinfo = true;
+			} else if (t == "-sse") {
+				sse = true;
+			} else if (t == "-x64") {
+				x64 = true;
+			} else if (t == "-nocache") {
+				nocache = true;
+			} else if (t == "-stats") {
+				showstats = true;
+			} else if (t == "-stats-json") {
+				if (k == argc - 1)
+					usageErr();
+
+				stats_file = argv[++k];
+			} else if (t == "-j") {
+				if (k == argc - 1)
+					usageErr();
+
+				jobs = atoi(argv[++k]);
 			} else if (t == "-o") {
 				if (out_file.size() || k == argc - 1)
 					usageErr();
@@ -205,11 +279,17 @@ int main(int argc, char* argv[])
 		if (out_file.size() && !in_file.size())
 			usageErr();
 
-		if (const char* er = openLibs())
-			err(er);
+		//programs aren't run inside the server
+		if (serving && !out_file.size())
+			compileonly = true;
+
+		if (!serving) {
+			if (const char* er = openLibs())
+				err(er);
 
-		if (const char* er = linkLibs())
-			err(er);
+			if (const char* er = linkLibs())
+				err(er);
+		}
 
 		if (showhelp)
 			showHelp();
@@ -246,10 +326,46 @@ int main(int argc, char* argv[])
 			SetCurrentDirectory(in_file.substr(0, n).c_str());
 		}
 
+		//vars are pointer sized
+		Node::word = x64 ? 8 : 4;
+
+		//counts are per compile
+		Stats stats;
+		int   insts = 0, rt_lookups = 0;
+		Toker::chars_toked = Toker::lines_toked = 0;
+		Node::created.reset();
+		TNode::created.reset();
+		Tile::created.reset();
+
+		//shown once the code's linked - before it runs, as that may never return
+		auto report = [&]() {
+			stats.phase(0);
+			if (!showstats && !stats_file.size())
+				return;
+			ModuleStats ms = {};
+			module->getStats(&ms);
+			stats.count("lines", Toker::lines_toked);
+			stats.count("chars", Toker::chars_toked);
+			stats.count("nodes", Node::created.get());
+			stats.count("tnodes", TNode::created.get());
+			stats.count("tiles", Tile::created.get());
+			stats.count("insts", insts);
+			stats.count("code_bytes", ms.code);
+			stats.count("data_bytes", ms.data);
+			stats.count("relocs", ms.relocs);
+			stats.count("symbols", ms.symbols);
+			stats.count("sym_lookups", ms.lookups + rt_lookups);
+			if (showstats)
+				stats.report(std::cout);
+			if (stats_file.size() && !stats.writeJson(stats_file, in_file))
+				err("Unable to write stats file");
+		};
+
 		try {
 			//parse
 			if (!veryquiet)
 				std::cout << "Parsing..." << std::endl;
+			stats.phase("parse");
 			Toker  toker(in);
 			Parser parser(toker);
 			prog = parser.parse(in_file);
@@ -257,27 +373,100 @@ int main(int argc, char* argv[])
 			//semant
 			if (!veryquiet)
 				std::cout << "Generating..." << std::endl;
+			stats.phase("semant");
 			v_environ = prog->semant(runtimeEnviron);
 
 			//translate
 			if (!veryquiet)
 				std::cout << "Translating..." << std::endl;
-			qstreambuf    qbuf;
-			std::iostream asmcode(&qbuf);
-			Codegen_x86   codegen(asmcode, debug);
+			stats.phase("translate");
+			TranslatePools pools;
+			qstreambuf     qbuf;
+			std::iostream  asmcode(&qbuf);
+			module = linkerLib->createModule();
+
+			//debug code refers to locals by address, so can't be optimized
+			Optimizer* optimizer = optimize && !debug ? new Optimizer() : 0;
+			PeepholeStats peep;
+
+			if (x64) {
+				//just the assembly source - there's no x64 encoder, and the runtime only builds for
+				//32 bit Windows, so nothing here assembles, links or runs it
+				std::ofstream asmfile;
+				if (out_file.size()) {
+					asmfile.open(out_file.c_str());
+					if (!asmfile)
+						err("Unable to open output file");
+				}
+				Codegen_x64 codegen(out_file.size() ? (std::ostream&)asmfile : std::cout, debug);
+				prog->translate(&codegen, userFuncs);
+			} else if (dumpasm) {
+				//go through the text assembler so we get a listing
+				Codegen_x86 codegen(asmcode, debug);
+				OptCodegen  optgen(&codegen, optimizer);
+				codegen.sse  = sse;
+				codegen.peep = &peep;
 
-			prog->translate(&codegen, userFuncs);
+				prog->translate(optimizer ? (Codegen*)&optgen : &codegen, userFuncs);
 
-			if (dumpasm) {
 				std::cout << std::endl << std::string(qbuf.data(), qbuf.size()) << std::endl;
+
+				//assemble
+				if (!veryquiet)
+					std::cout << "Assembling..." << std::endl;
+				stats.phase("assemble");
+				Assem_x86 assem(asmcode, module);
+				assem.assemble();
+				insts = assem.encoded;
+			} else {
+				//translate and assemble in one pass
+				Assem_x86   assem(module);
+				Codegen_x86 codegen(asmcode, debug, &assem);
+				OptCodegen  optgen(&codegen, optimizer);
+				Codegen*    g = optimizer ? (Codegen*)&optgen : &codegen;
+				codegen.sse   = sse;
+				codegen.peep  = &peep;
+
+				//debug code refers to environs, so can't be cached
+				CodeCache* cache = 0;
+				if (!debug && !nocache) {
+					std::string options = std::string(optimizer ? "-O" : "") + (sse ? "-sse" : "");
+					codegen.cache = optgen.cache = cache =
+						new CodeCache(home + "/cache", v_environ.get(), runtimeEnviron, options);
+
+					//calls to inlined functions are only as current as the files they're in
+					std::set<std::string> inlined;
+					FuncDeclNode::inlineFiles(inlined);
+					for (std::set<std::string>::iterator it = inlined.begin(); it != inlined.end(); ++it)
+						cache->depend(*it);
+				}
+
+				prog->translate(g, userFuncs, jobs);
+				insts = assem.encoded;
+
+				if (cache) {
+					cache->flush();
+					if (!quiet)
+						std::cout << "Code cache: " << cache->hits << " functions reused, " << cache->misses
+								  << " translated" << std::endl;
+					delete cache;
+				}
 			}
 
-			//assemble
-			if (!veryquiet)
-				std::cout << "Assembling..." << std::endl;
-			module = linkerLib->createModule();
-			Assem_x86 assem(asmcode, module);
-			assem.assemble();
+			if (!quiet) {
+				if (!x64)
+					std::cout << "Peephole: " << peep.insts << " instructions, " << peep.bytes << " bytes removed"
+							  << std::endl;
+				Reach::report(std::cout);
+			}
+
+			if (optimizer) {
+				if (!quiet)
+					optimizer->report(std::cout);
+				delete optimizer;
+			}
+
+			pools.done = true;
 
 		} catch (Ex& x) {
 			std::string file = '\"' + x.file + '\"';
@@ -288,14 +477,29 @@ int main(int argc, char* argv[])
 
 		delete prog;
 
+		if (x64) {
+			report();
+			return 0;
+		}
+
 		if (out_file.size()) {
 			if (!veryquiet)
 				std::cout << "Creating executable \"" << out_file << "\"..." << std::endl;
+			stats.phase("link");
 			if (!module->createExe(out_file.c_str(), (home + "/bin/runtime.dll").c_str())) {
 				err("Error creating executable");
 			}
+			report();
 		} else if (!compileonly) {
+			stats.phase("link");
+			if (const char* er = linkRuntimeSyms())
+				err(er);
+			ModuleStats rs0 = {}, rs1 = {};
+			runtimeModule->getStats(&rs0);
 			void* entry = module->link(runtimeModule);
+			runtimeModule->getStats(&rs1);
+			rt_lookups = rs1.lookups - rs0.lookups;
+			report();
 			if (!entry)
 				return 0;
 
@@ -321,18 +525,65 @@ int main(int argc, char* argv[])
 
 			if (dbgHandle)
 				FreeLibrary(dbgHandle);
+		} else {
+			report();
 		}
 
 		delete module;
 		delete v_environ;
 
-		closeLibs();
+		if (!serving)
+			closeLibs();
 	} catch (std::exception& e) {
 		std::cout << "Unexpected exception: " << e.what() << std::endl;
-
+		return 1;
 	} catch (...) {
 		std::cout << "Unexpected error." << std::endl;
+		return 1;
 	}
-	std::cin.get();
 	return 0;
+}
+
+static int serve(const std::vector<std::string>& args)
+{
+	return compile(args, true);
+}
+
+int main(int argc, char* argv[])
+{
+	std::vector<std::string> args(argv + 1, argv + argc);
+
+	//run at install time
+	if (args.size() == 1 && args[0] == "-gendecls") {
+		const char* er = openLibs();
+		if (!er)
+			er = genDecls();
+		closeLibs();
+		if (er) {
+			std::cout << er << std::endl;
+			return 1;
+		}
+		return 0;
+	}
+
+	//a resident compiler, and its client
+	if (args.size() == 2 && args[0] == "--server") {
+		if (const char* er = openLibs()) {
+			std::cout << er << std::endl;
+			return 1;
+		}
+		if (const char* er = linkLibs()) {
+			std::cout << er << std::endl;
+			return 1;
+		}
+		int n = runServer(args[1], serve);
+		closeLibs();
+		return n;
+	}
+	if (args.size() >= 2 && args[0] == "--connect")
+		return connectServer(args[1], std::vector<std::string>(args.begin() + 2, args.end()));
+
+	int n = compile(args, false);
+	std::cin.get();
+	return n;
 }
\ No newline at end of file
@@ -0,0 +1,356 @@
+/*
+
+  The compile server, and its client.
+
+  A request is the client's working dir and then its args, each '\0' terminated, with
+  an empty string to end them. The reply is whatever the compile wrote to std::cout,
+  then a '\0' and the exit code in decimal.
+
+  On Windows the connection is the named pipe \\.\pipe\name, and elsewhere the Unix
+  socket at path.
+
+*/
+
+#include "server.hpp"
+#include <cstring>
+#include <iostream>
+#include <streambuf>
+
+#include <stdutil.hpp>
+
+#ifdef _WIN32
+
+#include <windows.h>
+
+typedef HANDLE Conn;
+
+static int readSome(Conn c, char* p, int n)
+{
+	DWORD k;
+	return ReadFile(c, p, n, &k, 0) ? (int)k : -1;
+}
+
+static int writeSome(Conn c, const char* p, int n)
+{
+	DWORD k;
+	return WriteFile(c, p, n, &k, 0) ? (int)k : -1;
+}
+
+static bool changeDir(const std::string& dir)
+{
+	return SetCurrentDirectory(dir.c_str()) != 0;
+}
+
+static bool currentDir(std::string& dir)
+{
+	char  buff[MAX_PATH];
+	DWORD n = GetCurrentDirectory(MAX_PATH, buff);
+	if (!n || n >= MAX_PATH)
+		return false;
+	dir = buff;
+	return true;
+}
+
+#else
+
+#include <cerrno>
+#include <csignal>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+typedef int Conn;
+
+static int readSome(Conn c, char* p, int n)
+{
+	int k;
+	while ((k = read(c, p, n)) < 0 && errno == EINTR) {}
+	return k;
+}
+
+static int writeSome(Conn c, const char* p, int n)
+{
+	int k;
+	while ((k = write(c, p, n)) < 0 && errno == EINTR) {}
+	return k;
+}
+
+static bool changeDir(const std::string& dir)
+{
+	return chdir(dir.c_str()) == 0;
+}
+
+static bool currentDir(std::string& dir)
+{
+	char buff[4096];
+	if (!getcwd(buff, sizeof(buff)))
+		return false;
+	dir = buff;
+	return true;
+}
+
+#endif
+
+static bool sendAll(Conn c, const char* p, int n)
+{
+	while (n > 0) {
+		int k = writeSome(c, p, n);
+		if (k <= 0)
+			return false;
+		p += k;
+		n -= k;
+	}
+	return true;
+}
+
+//std::cout, while a request is being compiled
+class connbuf : public std::streambuf {
+	public:
+	connbuf(Conn c) : c(c) { setp(buf, buf + sizeof(buf)); }
+	~connbuf() { sync(); }
+
+	protected:
+	int overflow(int ch)
+	{
+		if (sync())
+			return EOF;
+		if (ch == EOF)
+			return 0;
+		*pptr() = ch;
+		pbump(1);
+		return ch;
+	}
+
+	int sync()
+	{
+		bool ok = sendAll(c, pbase(), pptr() - pbase());
+		setp(buf, buf + sizeof(buf));
+		return ok ? 0 : -1;
+	}
+
+	private:
+	Conn c;
+	char buf[4096];
+};
+
+//the strings of a request, up to the empty one
+static bool readRequest(Conn c, std::vector<std::string>& strs)
+{
+	std::string t;
+	char        buf[1024];
+	for (;;) {
+		int n = readSome(c, buf, sizeof(buf));
+		if (n <= 0)
+			return false;
+		for (int k = 0; k < n; ++k) {
+			if (buf[k]) {
+				t += buf[k];
+				continue;
+			}
+			if (!t.size())
+				return strs.size() > 0;
+			strs.push_back(t);
+			t.clear();
+		}
+	}
+}
+
+static void reply(Conn c, const std::vector<std::string>& req, CompileFunc compile)
+{
+	int code = 1;
+	{
+		connbuf         buf(c);
+		std::streambuf* old = std::cout.rdbuf(&buf);
+		if (!changeDir(req[0]))
+			std::cout << "Unable to change to directory \"" << req[0] << "\"" << std::endl;
+		else
+			code = compile(std::vector<std::string>(req.begin() + 1, req.end()));
+		std::cout.flush();
+		std::cout.rdbuf(old);
+	}
+	std::string end = std::string(1, '\0') + itoa(code);
+	sendAll(c, end.data(), end.size());
+}
+
+//sends the request for args, and copies the reply's output to std::cout - false if
+//the server went away before the exit code
+static bool request(Conn c, const std::vector<std::string>& args, int& code)
+{
+	std::string cwd;
+	if (!currentDir(cwd)) {
+		std::cout << "Unable to get current directory" << std::endl;
+		return false;
+	}
+
+	//an empty string ends the request, so empty args are left out
+	std::string req = cwd + '\0';
+	for (int k = 0; k < args.size(); ++k) {
+		if (args[k].size())
+			req += args[k] + '\0';
+	}
+	req += '\0';
+
+	std::string t;
+	bool        done = false;
+	if (sendAll(c, req.data(), req.size())) {
+		char buf[4096];
+		for (;;) {
+			int n = readSome(c, buf, sizeof(buf));
+			if (n <= 0)
+				break;
+			if (done) {
+				t.append(buf, n);
+				continue;
+			}
+			const char* end = (const char*)memchr(buf, 0, n);
+			if (!end) {
+				std::cout.write(buf, n);
+				continue;
+			}
+			std::cout.write(buf, end - buf);
+			t.append(end + 1, buf + n - end - 1);
+			done = true;
+		}
+	}
+	std::cout.flush();
+
+	if (!done) {
+		std::cout << "Compile server closed the connection" << std::endl;
+		return false;
+	}
+	code = atoi(t);
+	return true;
+}
+
+#ifdef _WIN32
+
+static std::string pipeName(const std::string& name)
+{
+	static const std::string prefix = "\\\\.\\pipe\\";
+	return name.compare(0, prefix.size(), prefix) ? prefix + name : name;
+}
+
+int runServer(const std::string& path, CompileFunc compile)
+{
+	//the one instance is reused, so clients that arrive mid compile wait for it to be
+	//free, rather than finding no pipe at all
+	std::string name = pipeName(path);
+	HANDLE      srv  = CreateNamedPipe(name.c_str(), PIPE_ACCESS_DUPLEX | FILE_FLAG_FIRST_PIPE_INSTANCE,
+									   PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+									   1, 4096, 4096, 0, 0);
+	if (srv == INVALID_HANDLE_VALUE) {
+		std::cout << "Unable to create pipe \"" << name << "\": error " << GetLastError() << std::endl;
+		return 1;
+	}
+
+	std::cout << "Compile server listening on \"" << name << "\"" << std::endl;
+	for (;;) {
+		if (!ConnectNamedPipe(srv, 0) && GetLastError() != ERROR_PIPE_CONNECTED)
+			break;
+		std::vector<std::string> req;
+		if (readRequest(srv, req)) {
+			reply(srv, req, compile);
+			//disconnecting throws away whatever the client hasn't read yet
+			FlushFileBuffers(srv);
+		}
+		DisconnectNamedPipe(srv);
+	}
+
+	std::cout << "Compile server stopped: error " << GetLastError() << std::endl;
+	CloseHandle(srv);
+	return 1;
+}
+
+int connectServer(const std::string& path, const std::vector<std::string>& args)
+{
+	std::string name = pipeName(path);
+	HANDLE      c;
+	for (;;) {
+		c = CreateFile(name.c_str(), GENERIC_READ | GENERIC_WRITE, 0, 0, OPEN_EXISTING, 0, 0);
+		if (c != INVALID_HANDLE_VALUE || GetLastError() != ERROR_PIPE_BUSY)
+			break;
+		//busy with another client
+		if (!WaitNamedPipe(name.c_str(), NMPWAIT_WAIT_FOREVER))
+			break;
+	}
+	if (c == INVALID_HANDLE_VALUE) {
+		std::cout << "Unable to connect to compile server \"" << name << "\"" << std::endl;
+		return 1;
+	}
+
+	int  code = 1;
+	bool ok   = request(c, args, code);
+	CloseHandle(c);
+	return ok ? code : 1;
+}
+
+#else
+
+static bool address(const std::string& path, sockaddr_un& sa)
+{
+	memset(&sa, 0, sizeof(sa));
+	if (path.size() >= sizeof(sa.sun_path))
+		return false;
+	sa.sun_family = AF_UNIX;
+	strcpy(sa.sun_path, path.c_str());
+	return true;
+}
+
+int runServer(const std::string& path, CompileFunc compile)
+{
+	sockaddr_un sa;
+	if (!address(path, sa)) {
+		std::cout << "Socket path too long" << std::endl;
+		return 1;
+	}
+
+	//a server that was killed leaves its socket behind
+	unlink(path.c_str());
+
+	int srv = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (srv < 0 || bind(srv, (sockaddr*)&sa, sizeof(sa)) || listen(srv, 16)) {
+		std::cout << "Unable to listen on \"" << path << "\": " << strerror(errno) << std::endl;
+		return 1;
+	}
+
+	//clients can go away before their reply is sent
+	signal(SIGPIPE, SIG_IGN);
+
+	std::cout << "Compile server listening on \"" << path << "\"" << std::endl;
+	for (;;) {
+		int fd = accept(srv, 0, 0);
+		if (fd < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+		std::vector<std::string> req;
+		if (readRequest(fd, req))
+			reply(fd, req, compile);
+		close(fd);
+	}
+
+	std::cout << "Compile server stopped: " << strerror(errno) << std::endl;
+	close(srv);
+	unlink(path.c_str());
+	return 1;
+}
+
+int connectServer(const std::string& path, const std::vector<std::string>& args)
+{
+	sockaddr_un sa;
+	int         fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0 || !address(path, sa) || connect(fd, (sockaddr*)&sa, sizeof(sa))) {
+		std::cout << "Unable to connect to compile server \"" << path << "\"" << std::endl;
+		if (fd >= 0)
+			close(fd);
+		return 1;
+	}
+
+	int  code = 1;
+	bool ok   = request(fd, args, code);
+	close(fd);
+	return ok ? code : 1;
+}
+
+#endif
@@ -0,0 +1,14 @@
+#pragma once
+#include <string>
+#include <vector>
+
+//compiles the args of a request, with std::cout going back to the client
+typedef int (*CompileFunc)(const std::vector<std::string>& args);
+
+//serve compile requests one at a time, until killed - on the named pipe \\.\pipe\path on
+//Windows, else the Unix socket at path
+int runServer(const std::string& path, CompileFunc compile);
+
+//have the server at path compile args - its output is written to std::cout, and its
+//exit code returned
+int connectServer(const std::string& path, const std::vector<std::string>& args);
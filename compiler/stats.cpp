@@ -0,0 +1,149 @@
+#include "stats.hpp"
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+double wallTime()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#ifdef _WIN32
+
+double cpuTime()
+{
+	FILETIME c, e, k, u;
+	if (!GetProcessTimes(GetCurrentProcess(), &c, &e, &k, &u))
+		return 0;
+	//100ns units
+	unsigned long long kt = ((unsigned long long)k.dwHighDateTime << 32) | k.dwLowDateTime;
+	unsigned long long ut = ((unsigned long long)u.dwHighDateTime << 32) | u.dwLowDateTime;
+	return (kt + ut) / 1e7;
+}
+
+long long peakMemory()
+{
+	PROCESS_MEMORY_COUNTERS pmc;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)))
+		return 0;
+	return pmc.PeakWorkingSetSize;
+}
+
+#else
+
+double cpuTime()
+{
+	rusage ru;
+	if (getrusage(RUSAGE_SELF, &ru))
+		return 0;
+	return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+}
+
+long long peakMemory()
+{
+	rusage ru;
+	if (getrusage(RUSAGE_SELF, &ru))
+		return 0;
+#ifdef __APPLE__
+	return ru.ru_maxrss; //bytes
+#else
+	return ru.ru_maxrss * 1024LL; //kilobytes
+#endif
+}
+
+#endif
+
+Stats::Stats() : curr(0), wall0(0), cpu0(0) {}
+
+void Stats::phase(const char* name)
+{
+	double wall = wallTime(), cpu = cpuTime();
+	if (curr) {
+		Phase p = {curr, wall - wall0, cpu - cpu0};
+		phases.push_back(p);
+	}
+	curr  = name;
+	wall0 = wall;
+	cpu0  = cpu;
+}
+
+void Stats::count(const char* name, long long n)
+{
+	Count c = {name, n};
+	counts.push_back(c);
+}
+
+void Stats::report(std::ostream& out)
+{
+	std::ios::fmtflags flags = out.flags();
+	std::streamsize    prec  = out.precision();
+
+	double wall = 0, cpu = 0;
+	out << "Phase            Wall        CPU" << std::endl;
+	out << std::fixed << std::setprecision(2);
+	for (int k = 0; k < phases.size(); ++k) {
+		const Phase& p = phases[k];
+		out << std::left << std::setw(12) << p.name << std::right << std::setw(9) << p.wall * 1000 << "ms"
+			<< std::setw(9) << p.cpu * 1000 << "ms" << std::endl;
+		wall += p.wall;
+		cpu += p.cpu;
+	}
+	out << std::left << std::setw(12) << "total" << std::right << std::setw(9) << wall * 1000 << "ms" << std::setw(9)
+		<< cpu * 1000 << "ms" << std::endl;
+	out << "Peak memory: " << peakMemory() / 1024 << "K" << std::endl;
+	for (int k = 0; k < counts.size(); ++k)
+		out << std::left << std::setw(16) << counts[k].name << std::right << counts[k].n << std::endl;
+	out.flags(flags);
+	out.precision(prec);
+}
+
+static std::string jsonStr(const std::string& s)
+{
+	std::string t = "\"";
+	for (int k = 0; k < s.size(); ++k) {
+		unsigned char c = s[k];
+		if (c == '\"' || c == '\\') {
+			t += '\\';
+			t += c;
+		} else if (c < 32) {
+			char buff[8];
+			sprintf(buff, "\\u%04x", c);
+			t += buff;
+		} else {
+			t += c;
+		}
+	}
+	return t + '\"';
+}
+
+bool Stats::writeJson(const std::string& file, const std::string& in_file)
+{
+	std::ofstream out(file.c_str());
+	if (!out)
+		return false;
+	out << std::fixed << std::setprecision(3);
+	out << "{\n";
+	out << "\t\"file\": " << jsonStr(in_file) << ",\n";
+	out << "\t\"phases\": {";
+	for (int k = 0; k < phases.size(); ++k) {
+		const Phase& p = phases[k];
+		out << (k ? ",\n" : "\n") << "\t\t" << jsonStr(p.name) << ": {\"wall_ms\": " << p.wall * 1000
+			<< ", \"cpu_ms\": " << p.cpu * 1000 << "}";
+	}
+	out << "\n\t},\n";
+	out << "\t\"peak_memory\": " << peakMemory() << ",\n";
+	out << "\t\"counts\": {";
+	for (int k = 0; k < counts.size(); ++k)
+		out << (k ? ",\n" : "\n") << "\t\t" << jsonStr(counts[k].name) << ": " << counts[k].n;
+	out << "\n\t}\n";
+	out << "}\n";
+	return out.good();
+}
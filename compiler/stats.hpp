@@ -0,0 +1,44 @@
+/*
+
+  Phase timings and counts for blitzcc -stats and -stats-json.
+
+  Phases are timed back to back - starting one ends the last. The counts are whatever
+  the compile wants to report, in the order they were added.
+
+*/
+
+#pragma once
+#include <ostream>
+#include <string>
+#include <vector>
+
+class Stats {
+	public:
+	Stats();
+
+	//ends the current phase and starts timing the next - 0 just ends it
+	void phase(const char* name);
+	void count(const char* name, long long n);
+
+	void report(std::ostream& out);
+	bool writeJson(const std::string& file, const std::string& in_file);
+
+	private:
+	struct Phase {
+		const char* name;
+		double      wall, cpu; //seconds
+	};
+	struct Count {
+		const char* name;
+		long long   n;
+	};
+	std::vector<Phase> phases;
+	std::vector<Count> counts;
+	const char*        curr;
+	double             wall0, cpu0;
+};
+
+//process wide - peak memory is for the life of the process, so a compile server's only grows
+double    wallTime();
+double    cpuTime();
+long long peakMemory();
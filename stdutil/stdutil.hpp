@@ -1,6 +1,8 @@
 #pragma once
+#include <cstddef>
 #include <iostream>
 #include <string>
+#include <vector>
 
 #include <config.hpp>
 
@@ -77,58 +79,139 @@ class qstreambuf : public std::streambuf {
 	int_type overflow(int_type c);
 };
 
+//fixed size slots for T, allocated N at a time. Freed slots go on a free list for the next
+//allocate(), and the chunks themselves are only given back all at once, by clear() or
+//reset(). Not thread safe - use one per thread.
 template<class T>
 class pool {
-	T* free;
+	union Slot {
+		Slot* next;
+		alignas(T) char t[sizeof(T)];
+	};
 	enum { N = 512 };
 
+	Slot*              free;
+	std::vector<Slot*> chunks;
+	int                live;
+
 	public:
-	typedef size_t    size_type;
-	typedef ptrdiff_t difference_type;
-	typedef T*        pointer;
-	typedef const T*  const_pointer;
-	typedef T&        reference;
-	typedef const T&  const_reference;
-	typedef T         value_type;
-	pointer           address(reference q) const
-	{
-		return &q;
-	}
-	const_pointer address(const_reference q) const
-	{
-		return &q;
-	}
-	pool() : free(0) {}
-	pointer allocate(size_type n, const void*)
+	pool() : free(0), live(0) {}
+	~pool() { reset(); }
+
+	void* allocate()
 	{
-		clog << "Allocating " << n << endl;
-		if (n > 1)
-			return new T[n];
 		if (!free) {
-			free = (T*)new char[sizeof(T) * N];
+			Slot* c = new Slot[N];
 			for (int k = 0; k < N - 1; ++k)
-				*(T**)(free + k) = free + k + 1;
-			*(T**)(free + N - 1) = 0;
+				c[k].next = c + k + 1;
+			c[N - 1].next = 0;
+			chunks.push_back(c);
+			free = c;
 		}
-		T* t = free;
-		free = *(T**)t;
+		Slot* t = free;
+		free    = t->next;
+		++live;
 		return t;
 	}
-	void deallocate(pointer q, size_type n)
+	void deallocate(void* q)
+	{
+		Slot* t = (Slot*)q;
+		t->next = free;
+		free    = t;
+		--live;
+	}
+
+	//frees every chunk - unless anything's still allocated, when they're kept as it may
+	//still be in use, and it returns false
+	bool clear()
+	{
+		if (live)
+			return false;
+		reset();
+		return true;
+	}
+
+	//frees every chunk, allocated or not - for when none of it will be used again
+	void reset()
+	{
+		for (int k = 0; k < chunks.size(); ++k)
+			delete[] chunks[k];
+		chunks.clear();
+		free = 0;
+		live = 0;
+	}
+
+	int allocated() const { return live; }
+	int reserved() const { return chunks.size() * N; }
+};
+
+//slots of any size up to MAX, for the objects of a class and its subclasses - sizes are rounded
+//up to a multiple of UNIT, and each has its own free list. Bigger ones aren't pooled. Like pool,
+//the chunks are only given back all at once, and it's not thread safe.
+template<int MAX>
+class sizedpool {
+	struct Slot {
+		Slot* next;
+	};
+	enum { UNIT = alignof(std::max_align_t), SIZES = (MAX + UNIT - 1) / UNIT, CHUNK = 65536 };
+
+	Slot*              free[SIZES];
+	std::vector<char*> chunks;
+	char *             next, *end; //unused part of the last chunk
+	int                live;
+
+	public:
+	sizedpool() : next(0), end(0), live(0)
+	{
+		for (int k = 0; k < SIZES; ++k)
+			free[k] = 0;
+	}
+	~sizedpool() { reset(); }
+
+	void* allocate(size_t sz)
 	{
-		clog << "Deallocating " << n << endl;
-		while (n-- > 0) {
-			*(T**)q    = free;
-			*(T**)free = q;
-			++q;
+		if (sz > MAX)
+			return ::operator new(sz);
+		int k = (sz + UNIT - 1) / UNIT - 1;
+		++live;
+		if (Slot* t = free[k]) {
+			free[k] = t->next;
+			return t;
 		}
+		size_t n = (k + 1) * UNIT;
+		if (end - next < n) {
+			next = new char[CHUNK];
+			end  = next + CHUNK;
+			chunks.push_back(next);
+		}
+		void* t = next;
+		next += n;
+		return t;
 	}
-	void construct(pointer p, const T& q)
+	void deallocate(void* q, size_t sz)
 	{
-		new (p) T(q);
+		if (sz > MAX) {
+			::operator delete(q);
+			return;
+		}
+		Slot* t = (Slot*)q;
+		int   k = (sz + UNIT - 1) / UNIT - 1;
+		t->next = free[k];
+		free[k] = t;
+		--live;
 	}
-	void destroy(pointer p)
+
+	//frees every chunk, allocated or not - for when none of it will be used again
+	void reset()
 	{
-		p->~T();
+		for (int k = 0; k < chunks.size(); ++k)
+			delete[] chunks[k];
+		chunks.clear();
+		for (int k = 0; k < SIZES; ++k)
+			free[k] = 0;
+		next = end = 0;
+		live       = 0;
 	}
+
+	int allocated() const { return live; }
 };